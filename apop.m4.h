@@ -390,6 +390,28 @@ void apop_data_show(const apop_data *data);
 
 
         //statistics
+/** A running tally of the first four moments of a stream of (possibly weighted)
+observations. Build one up with \ref apop_moments_add or \ref apop_vector_moments,
+and combine tallies from disjoint pieces of the data with \ref apop_moments_merge.
+A zeroed struct is an empty tally. See \ref apop_moments_add for details. */
+typedef struct {
+    long double weight; /**< Total weight of the observations so far; equals \c count if unweighted. */
+    long double mean;   /**< The weighted mean. */
+    long double m2;     /**< \f$\sum_i w_i(x_i-\bar x)^2\f$. */
+    long double m3;     /**< \f$\sum_i w_i(x_i-\bar x)^3\f$. */
+    long double m4;     /**< \f$\sum_i w_i(x_i-\bar x)^4\f$. */
+    size_t count;       /**< Number of observations, regardless of weight. */
+    double min, max;    /**< Smallest and largest observations, regardless of weight. */
+} apop_moments;
+
+void apop_moments_add(apop_moments *m, double x, double weight);
+apop_moments apop_moments_merge(apop_moments a, apop_moments b);
+double apop_moments_var(apop_moments const *m);
+double apop_moments_skew_pop(apop_moments const *m);
+double apop_moments_kurtosis_pop(apop_moments const *m);
+Apop_var_declare( apop_moments apop_vector_moments(gsl_vector const *v, gsl_vector const *weights))
+apop_moments *apop_matrix_moments(gsl_matrix const *m, gsl_vector const *weights);
+
 Apop_var_declare( double apop_vector_mean(gsl_vector const *v, gsl_vector const *weights))
 Apop_var_declare( double apop_vector_var(gsl_vector const *v, gsl_vector const *weights))
 Apop_var_declare( double apop_vector_skew_pop(gsl_vector const *v, gsl_vector const *weights))
@@ -398,6 +420,7 @@ Apop_var_declare( double apop_vector_cov(gsl_vector const *v1, gsl_vector const
                                          gsl_vector const *weights))
 
 Apop_var_declare( double apop_vector_distance(const gsl_vector *ina, const gsl_vector *inb, const char metric, const double norm) )
+Apop_var_declare( apop_data *apop_data_distance_matrix(apop_data const *a, apop_data const *b, char metric, double norm, char condensed) )
 
 Apop_var_declare( void apop_vector_normalize(gsl_vector *in, gsl_vector **out, const char normalization_type) )
 
@@ -408,6 +431,26 @@ long double apop_matrix_sum(const gsl_matrix *m);
 double apop_matrix_mean(const gsl_matrix *data);
 void apop_matrix_mean_and_var(const gsl_matrix *data, double *mean, double *var);
 apop_data * apop_data_summarize(apop_data *data);
+/** A mergeable sketch of a data stream, from which approximate quantiles can be read.
+This is a merging t-digest: the data is summarized by a set of weighted centroids,
+which are kept small near the tails, so extreme quantiles are more precise than those
+near the median. See \ref apop_quantile_sketch_alloc for details. The elements are for
+internal use; use the \c apop_quantile_sketch_... functions to work with the sketch. */
+typedef struct {
+    double compression;   /**< Larger means more centroids and more precision. */
+    double total_weight, min, max;
+    double *means, *weights; /**< The centroids, followed by not-yet-merged new data. */
+    size_t centroid_ct, buffer_ct, size;
+} apop_quantile_sketch;
+
+Apop_var_declare( apop_quantile_sketch *apop_quantile_sketch_alloc(double compression) )
+void apop_quantile_sketch_free(apop_quantile_sketch *s);
+void apop_quantile_sketch_add(apop_quantile_sketch *s, double x, double weight);
+void apop_quantile_sketch_merge(apop_quantile_sketch *s, apop_quantile_sketch const *addme);
+double apop_quantile_sketch_query(apop_quantile_sketch *s, double q);
+void *apop_quantile_sketch_serialize(apop_quantile_sketch *s, size_t *byte_ct);
+apop_quantile_sketch *apop_quantile_sketch_deserialize(void const *in, size_t byte_ct);
+Apop_var_declare( double * apop_vector_quantiles(gsl_vector *data, gsl_vector const *quantiles, char rounding, char inplace) )
 Apop_var_declare( double * apop_vector_percentiles(gsl_vector *data, char rounding)  )
 
 apop_data *apop_test_fisher_exact(apop_data *intab); //in apop_fisher.c
@@ -549,6 +592,22 @@ typedef void (*apop_model_print_type)(apop_model *params, FILE *out);
             : 27)
 make_vtab_fns(apop_model_print)
 
+typedef void (*apop_suff_stats_type)(apop_data *d, double *stats);
+#define apop_suff_stats_hash(m1) ((size_t)(m1)->log_likelihood)
+make_vtab_fns(apop_suff_stats)
+
+typedef int (*apop_draw_many_type)(gsl_matrix *out, gsl_rng *r, apop_model *m);
+#define apop_draw_many_hash(m1) ((size_t)(m1)->draw)
+make_vtab_fns(apop_draw_many)
+
+typedef void (*apop_row_lls_type)(gsl_vector const *x, gsl_vector *out, apop_model *m);
+#define apop_row_lls_hash(m1) ((size_t)(m1)->log_likelihood)
+make_vtab_fns(apop_row_lls)
+
+typedef void (*apop_weighted_estimate_type)(gsl_vector const *x, gsl_vector const *weights, apop_model *m);
+#define apop_weighted_estimate_hash(m1) ((size_t)(m1)->log_likelihood)
+make_vtab_fns(apop_weighted_estimate)
+
 /** \endcond */ //End of Doxygen ignore.
 
 
@@ -686,7 +745,7 @@ Apop_var_declare( int         apop_vector_bounded(const gsl_vector *in, long dou
 gsl_matrix * apop_matrix_inverse(const gsl_matrix *in) ;
 double      apop_matrix_determinant(const gsl_matrix *in) ;
 //apop_data*  apop_sv_decomposition(gsl_matrix *data, int dimensions_we_want);
-Apop_var_declare( apop_data *  apop_matrix_pca(gsl_matrix *data, int const dimensions_we_want) )
+Apop_var_declare( apop_data *  apop_matrix_pca(gsl_matrix *data, int const dimensions_we_want, char method, int power_iterations) )
 Apop_var_declare( gsl_vector * apop_vector_stack(gsl_vector *v1, gsl_vector const * v2, char inplace) )
 Apop_var_declare( gsl_matrix * apop_matrix_stack(gsl_matrix *m1, gsl_matrix const * m2, char posn, char inplace) )
 
@@ -1289,6 +1348,33 @@ typedef struct {
 } apop_cdf_settings;
 
 
+/** A cache for the sufficient statistics of a data set under a model that has a
+function registered in the \c apop_suff_stats vtable (Normal, Poisson, Gamma, Beta,
+Exponential, Bernoulli). With this group attached, the first log likelihood or score
+calculation on a data set takes a pass through the data to find the statistics, such
+as \f$n\f$, \f$\sum x\f$, or \f$\sum \ln x\f$, and later calculations on the same
+data set take time independent of the data size. \ref apop_maximum_likelihood attaches
+this group for the duration of its search.
+
+The cache is keyed on the address of the \ref apop_data set and its vector, matrix, and
+weights, and their sizes. If you modify the data in place and then reuse the model, increment
+\c version:
+\code
+apop_suff_stats_settings *ss = Apop_settings_get_group(m, apop_suff_stats);
+ss->version++;
+\endcode
+
+All elements but \c version are private.
+*/
+typedef struct {
+    int version; /**< Increment to mark the data as modified. */
+    int cached_version;
+    void const *key[4];
+    size_t sizes[3];
+    double stats[8];
+    char filled;
+} apop_suff_stats_settings;
+
 /** Settings for getting parameter models (i.e. the distribution of parameter estimates) */
 typedef struct {
     apop_model *base;
@@ -1304,9 +1390,23 @@ typedef struct {
     char draw_index;  /**< If \c 'y', then draws from the PMF return the integer index of the row drawn. 
                            If \c 'n' (the default), then return the data in the vector/matrix elements of the data set. */
     long double total_weight; /**< Keep the total weight, in case the input weights aren't normalized to sum to one. */
-    int *cmf_refct;    /**< For internal use, so I can garbage-collect the CMF when needed. */
+    char draw_method; /**< How to make draws given uneven weights. If \c 'c' (the default), then do a binary search of the cumulative mass function.
+                           If \c 'a', then use an alias table, which takes constant time per draw. See the \ref apop_pmf RNG notes. */
+    gsl_vector *alias_prob; /**< For the alias method: the odds of keeping each row rather than switching to its alias.*/
+    size_t *alias;          /**< For the alias method: the alias of each row. */
+    int *cmf_refct;    /**< For internal use, so I can garbage-collect the CMF and alias table when needed. */
+    struct apop_pmf_index *index; /**< For internal use: a hash index of the data's rows, so the \c p and \c cdf methods can find an observation without searching every row. */
 } apop_pmf_settings;
 
+/** Settings to accompany the \ref apop_multivariate_normal. The model attaches this
+group itself on first use; all elements are for internal use. */
+typedef struct {
+    gsl_matrix *cholesky; /**< The lower-triangular \f$L\f$ such that \f$LL'=\Sigma\f$, or \c NULL if \f$\Sigma\f$ is not positive definite. */
+    gsl_matrix *sigma;    /**< The covariance matrix used to calculate \c cholesky. If the model's covariance no longer matches, I recalculate. */
+    double log_det;       /**< \f$\ln|\Sigma|\f$, as calculated from the diagonal of \c cholesky. */
+    unsigned long long sigma_hash; /**< A hash of \c sigma, so a call can check for a changed covariance without taking a lock. */
+} apop_mvn_settings;
+
 
 /** Settings for the \ref apop_kernel_density model. */
 typedef struct{
@@ -1320,6 +1420,13 @@ typedef struct{
             Default: set the upper-left element of the parameter set to the upper-left scalar in the data:
             <tt>apop_data_set(m->parameters, .val= apop_data_get(in));</tt>.
                                                   */
+    char approximation; /**< How to evaluate the density. <tt>'n'</tt>: no approximation; sum over every point in the base data (the default).
+                            <tt>'b'</tt>: bin the base data onto a grid and convolve with the kernel via FFT. Requires one-dimensional data and an \ref apop_normal kernel.
+                            <tt>'t'</tt>: a kd-tree over the base data, with error bounds. Requires an \ref apop_normal or \ref apop_multivariate_normal kernel.
+                            See the \ref apop_kernel_density documentation for details. */
+    int bin_count;      /**< For the binned approximation, the number of grid points. Default: 4096. */
+    double tolerance;   /**< For the tree approximation, the maximum relative error of each density evaluation. Default: 1e-3. */
+    struct apop_kde_approx *approx; /**< For internal use only. */
     int own_pmf, own_kernel; /**< For internal use only. */
 }apop_kernel_density_settings;
 
@@ -1558,6 +1665,10 @@ typedef struct {
                                 confidence bands for predicted values */
     double  ci_level; /**< If running a prediction, the level at which
                         to calculate the confidence interval. default: 0.95 */
+    char    interpolate_predictions; /**< If \c 'y', predictions from a model fit with
+                        the \c "direct" surface are interpolated from a kd tree built once
+                        for all new points, rather than running a local regression
+                        for each point. default: \c 'n' */
 } apop_loess_settings;
 
 
@@ -1579,6 +1690,7 @@ typedef struct {  /* attributes of the entire rejection envelope */
   double *convex;          /* adjustment for convexity */
   double metro_xprev;      /* previous Markov chain iterate */
   double metro_yprev;      /* current log density at xprev */
+  unsigned long long params_hash; /* hash of the model parameters the envelope was built for */
 } arms_state;
     /** \endcond */
 
@@ -1604,7 +1716,10 @@ typedef struct {
                            if you're not sure if the function is log-concave).*/
    double xprev;    /**< For internal use; please ignore. Previous value from Markov chain. */
    int neval;       /**< On exit, the number of function evaluations performed */
-   arms_state *state;
+   arms_state *state; /**< For internal use. The envelope built from \c xinit for the current parameters. */
+   arms_state **thread_states; /**< For internal use. Per-thread copies of \c state, which
+                                  each thread refines as it draws, so concurrent draws need no locks. */
+   int thread_ct;   /**< For internal use. The length of \c thread_states. */
    apop_model *model; /**< The model from which to draw. Mandatory. Must have either a \c log_likelihood or \c p method.*/
 } apop_arms_settings;
 
@@ -1634,9 +1749,16 @@ typedef struct {
                        If no \c rng is provided, I use a default RNG; see \ref apop_rng_get_thread. */
     double scale; /**< After the scaling has been calculated, store it here. If you change the parameters of your base model,
                        set this to zero to have the scaling recalculated. */
-    gsl_vector *last_params; /**< The parameters used to calculate \c scale. If these change, recalculate. */
+    unsigned long long params_hash; /**< A hash of the parameters used to calculate \c scale. If these change, recalculate. */
     int draw_ct; /**< How many draws to make for calculating the in-constraint model density via random draws. Current default: 1e4. */
-    int refct; /**< For internal use. */
+    char quasi_random; /**< If \c 'y', calculate the in-constraint density using a quasi-random (randomized Halton)
+                            sequence instead of pseudorandom draws. Default: \c 'n'. */
+    char parallel_draws; /**< If \c 'y', split the draws for calculating the in-constraint density across
+                            threads. The base model's \c draw method and your \c constraint are then called
+                            concurrently, so they must be thread-safe. The result is the same either way.
+                            Default: \c 'n'. */
+    gsl_vector *last_params; /**< Deprecated and unused; changes in the parameters are now spotted via \c params_hash. */
+    int refct; /**< Deprecated and unused. */
 } apop_dconstrain_settings;
 
 typedef struct {
@@ -1656,12 +1778,17 @@ typedef struct {
     apop_model **model_list; /**< A \c NULL-terminated list of component models. */
     int model_count;
     int *param_sizes;  /**< The number of parameters for each model. Useful for unpacking the params. */
-    apop_model *cmf;   /**< For internal use by the draw method. */
-    int *cmf_refct;    /**< For internal use, so I can garbage-collect the CMF when needed. */
+    gsl_vector *alias_prob; /**< For internal use by the draw method. */
+    size_t *alias;     /**< For internal use by the draw method. */
+    int *cmf_refct;    /**< For internal use, so I can garbage-collect the model list when needed. */
     char find_weights; /**< By default, weights are fixed. Set this b \c 'y' to allow \ref apop_estimate to
                             use an EM algorithm to find the optimal weights.
                             See the documentation for \ref apop_mixture for details. */
     gsl_vector *next_weights; /**< For internal use.*/
+    double tolerance;  /**< The EM search stops when the log likelihood changes by less than this
+                            fraction of its value between iterations. Default: 1e-8. */
+    int max_iterations; /**< The EM search stops after this many iterations, with a warning. Default: 1000. */
+    char unparameterized; /**< For internal use. */
 } apop_mixture_settings;
 
     //Models built via call to apop_model_copy_set.
@@ -1673,7 +1800,9 @@ typedef struct {
 //Doxygen drops whatever is after these declarations, so I put them last.
 Apop_settings_declarations(apop_lm)
 Apop_settings_declarations(apop_pm)
+Apop_settings_declarations(apop_suff_stats)
 Apop_settings_declarations(apop_pmf)
+Apop_settings_declarations(apop_mvn)
 Apop_settings_declarations(apop_mle)
 Apop_settings_declarations(apop_cdf)
 Apop_settings_declarations(apop_arms)
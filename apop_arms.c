@@ -5,6 +5,14 @@
   Adaptations for Apophenia (c) 2009 by Ben Klemens.  Licensed under the GPLv2; see COPYING.  */
 
 #include "apop_internal.h"
+#ifdef _OPENMP
+    #include <omp.h>
+    #define omp_threadnum omp_get_thread_num()
+    #define omp_threadct omp_get_max_threads()
+#else
+    #define omp_threadnum 0
+    #define omp_threadct 1
+#endif
 
 #define XEPS  0.00001            /* critical relative x-value difference */
 #define YEPS  0.1                /* critical y-value difference */
@@ -23,17 +31,66 @@ double logshift(double y, double y0);
 double perfunc(apop_arms_settings*, double x);
 void display(FILE *f, arms_state *env, apop_arms_settings *);
 int initial (apop_arms_settings* params, arms_state *state);
+static int build_envelope(apop_arms_settings *params, arms_state *state);
+
+static arms_state *state_copy(arms_state const *in, double *convex){
+    arms_state *out = malloc(sizeof(arms_state));
+    Apop_stopif(!out, return NULL, 0, "Malloc failed. Out of memory?");
+    *out = *in;
+    out->convex = convex;
+    out->p = malloc(in->npoint*sizeof(POINT));
+    Apop_stopif(!out->p, free(out); return NULL, 0, "Malloc failed. Out of memory?");
+    memcpy(out->p, in->p, in->cpoint*sizeof(POINT));
+    for (int i=0; i< in->cpoint; i++){ //the envelope is a linked list within p; re-aim the links.
+        if (in->p[i].pl) out->p[i].pl = out->p + (in->p[i].pl - in->p);
+        if (in->p[i].pr) out->p[i].pr = out->p + (in->p[i].pr - in->p);
+    }
+    return out;
+}
+
+static void state_free(arms_state *in){
+    if (!in) return;
+    free(in->p);
+    free(in);
+}
+
+/* Build the envelope from xinit for the model's current parameters. */
+static int build_envelope(apop_arms_settings *params, arms_state *state){
+    free(state->p);
+    *state = (arms_state) { };
+    int err = initial(params, state);
+    if (err) return err;
+    state->params_hash = params->model->parameters ? params_hash(params->model->parameters) : 0;
+
+  /* finish setting up metropolis struct (can only do this after setting up env) */
+    if(params->do_metro=='y'){
+        /* I don't understand why this is needed.
+          if((params->xprev < params->xl) || (params->xprev > params->xr))
+            apop_assert(0, 1007, 0, 's', "previous Markov chain iterate out of range")*/
+        state->metro_xprev = params->xprev;
+        state->metro_yprev = perfunc(params,params->xprev);
+        assert(isfinite(state->metro_xprev));
+        assert(isfinite(state->metro_yprev));
+    }
+    return 0;
+}
 
 Apop_settings_copy(apop_arms,
-    out->state = malloc(sizeof(arms_state));
-    *out->state = *in->state;
+    out->xinit = malloc(in->ninit*sizeof(double));
+    memcpy(out->xinit, in->xinit, in->ninit*sizeof(double));
+    out->state = in->state ? state_copy(in->state, &out->convex) : NULL;
+    out->thread_states = calloc(in->thread_ct, sizeof(arms_state*));
+    for (int i=0; i< in->thread_ct; i++)
+        if (in->thread_states[i])
+            out->thread_states[i] = state_copy(in->thread_states[i], &out->convex);
 )
 
 Apop_settings_free(apop_arms,
-    if (in->state){
-        free(in->state->p);
-        free(in->state);
-	}
+    state_free(in->state);
+    for (int i=0; i< in->thread_ct; i++)
+        state_free(in->thread_states[i]);
+    free(in->thread_states);
+    free(in->xinit);
 )
 
 Apop_settings_init(apop_arms,
@@ -44,6 +101,8 @@ Apop_settings_init(apop_arms,
         Apop_varad_set(xinit, ((double []) {-1, 0, 1}));
     }
     Apop_varad_set(ninit, 3);
+    //keep our own copy of xinit, which may be needed to rebuild the envelope later.
+    out->xinit = memcpy(malloc(out->ninit*sizeof(double)), out->xinit, out->ninit*sizeof(double));
     Apop_varad_set(xl, GSL_MIN(out->xinit[0]/10., out->xinit[0]*10)-.1);
     Apop_varad_set(xr, GSL_MAX(out->xinit[out->ninit-1]/10., out->xinit[out->ninit-1]*10)+.1);
     Apop_varad_set(convex, 0);
@@ -52,24 +111,15 @@ Apop_settings_init(apop_arms,
     Apop_varad_set(xprev, (out->xinit[0]+out->xinit[out->ninit-1])/2.);
     Apop_varad_set(neval, 1000);
     Apop_assert(out->model, "the model input (e.g.: .model = parent_model) is mandatory.");
+    out->thread_ct = omp_threadct;
+    out->thread_states = calloc(out->thread_ct, sizeof(arms_state*));
 
   // allocate the state 
     out->state = malloc(sizeof(arms_state));
     Apop_assert(out->state, "Malloc failed. Out of memory?");
     *out->state = (arms_state) { };
-    int err = initial(out, out->state);
+    int err = build_envelope(out, out->state);
     Apop_assert_c(!err, NULL, 0, "init failed, error %i. Returning NULL", err);
-
-  /* finish setting up metropolis struct (can only do this after setting up env) */
-    if(out->do_metro=='y'){
-        /* I don't understand why this is needed.
-          if((params->xprev < params->xl) || (params->xprev > params->xr))
-            apop_assert(0, 1007, 0, 's', "previous Markov chain iterate out of range")*/
-        out->state->metro_xprev = out->xprev;
-        out->state->metro_yprev = perfunc(out,out->xprev);
-        assert(isfinite(out->state->metro_xprev));
-        assert(isfinite(out->state->metro_yprev));
-    }
 )
 
 void distract_doxygen_arms(){/*Doxygen gets thrown by the settings macros. This decoy function is a workaround. */}
@@ -84,14 +134,47 @@ http://www.amsta.leeds.ac.uk/~wally.gilks/adaptive.rejection/web_page/Welcome.ht
 
 \li It is currently the default for the \ref apop_draw function given a univariate model, so you can just call that if you prefer.
 
-\li There are a great number of parameters, in the \c apop_arms_settings structure.  The structure also holds a history of the points tested to date. That means that the system will be more accurate as more draws are made. It also means that if the parameters change, or you use \ref apop_model_copy, you should call <tt>Apop_settings_rm_group(your_model, apop_arms)</tt> to clear the model of points that are not valid for a different situation.
+\li There are a great number of parameters, in the \c apop_arms_settings structure.  The structure also holds a history of the points tested to date. That means that the system will be more accurate as more draws are made.
+
+\li The envelope is kept in the settings group and reused by subsequent draws. Each
+thread refines its own copy of the envelope, so draws from several threads at once (e.g.,
+via \ref apop_model_draws) do not wait on each other. If the model's parameters change,
+the envelope is rebuilt from \c xinit on the next draw.
   */
+static int arms_sample(double *out, gsl_rng *r, apop_arms_settings *params, arms_state *state);
+
 int apop_arms_draw (double *out, gsl_rng *r, apop_model *m){
     apop_arms_settings *params = Apop_settings_get_group(m, apop_arms);
-    if (!params) params = Apop_model_add_group(m, apop_arms, .model=m);
+    if (!params){
+        OMP_critical(arms_envelope)
+        if (!(params = Apop_settings_get_group(m, apop_arms)))
+            params = Apop_model_add_group(m, apop_arms, .model=m);
+    }
+    Apop_stopif(!params || !params->state, return 1, 0, "Couldn't set up the envelope.");
+
+    //Typical case: this thread's envelope is up to date, and no locks are needed.
+    uint64_t h = params->model->parameters ? params_hash(params->model->parameters) : 0;
+    int t = omp_threadnum;
+    arms_state *state = t < params->thread_ct ? params->thread_states[t] : NULL;
+    if (state && state->params_hash == h) return arms_sample(out, r, params, state);
+
+    int err = 0;
+    OMP_critical(arms_envelope){
+        if (params->state->params_hash != h) err = build_envelope(params, params->state);
+        if (!err && t < params->thread_ct){
+            state_free(params->thread_states[t]);
+            params->thread_states[t] = state = state_copy(params->state, &params->convex);
+        }
+        if (!err && !state) //more threads than slots; draw from the shared envelope.
+            err = arms_sample(out, r, params, params->state);
+    }
+    Apop_stopif(err, return 1, 0, "Error %i in setting up or drawing from the envelope.", err);
+    return state ? arms_sample(out, r, params, state) : 0;
+}
+
+static int arms_sample(double *out, gsl_rng *r, apop_arms_settings *params, arms_state *state){
   POINT pwork;        /* a working point, not yet incorporated in envelope */
   int msamp=0;        /* the number of x-values currently sampled */
-  arms_state *state = params->state; 
   /* now do adaptive rejection */
   do {
     // Sample a new point from piecewise exponential envelope 
@@ -525,10 +608,12 @@ double logshift(double y, double y0){
 
 double perfunc(apop_arms_settings *params, double x){
 // to evaluate log density and increment count of evaluations 
-    Staticdef( apop_data *, d , apop_data_alloc(1,1));
+    static threadlocal apop_data *d = NULL;
+    if (!d) d = apop_data_alloc(1,1);
     d->matrix->data[0] = x;
   double y = apop_log_likelihood(d, params->model);
   Apop_assert(isfinite(y), "Evaluating the log likelihood at %g returned %g.", x, y);
+  OMP_atomic
   (params->neval)++; // increment count of function evaluations
   return y;
 }
@@ -125,10 +125,34 @@ APOP_VAR_ENDHEAD
     return out;
 }
 
-/** Calculate \f$\sum_{n=1}^N {1\over n^s}\f$
+/* Euler-Maclaurin for \sum_{n=M}^N n^{-s}: the integral, the endpoint correction, and
+eight Bernoulli terms. With M at least 16+|s|, the remainder is below long double
+precision; for negative integer s, the series terminates. The integral is written via
+expm1 so it doesn't cancel as s approaches one. */
+static long double harmonic_tail(double M, int N, double s){
+    static const long double bernoulli[] = {1/6.L, -1/30.L, 1/42.L, -1/30.L,
+                                            5/66.L, -691/2730.L, 7/6.L, -3617/510.L};
+    long double log_ratio = logl(N/M);
+    long double out = s == 1 ? log_ratio : powl(M, 1-s)*expm1l((1-s)*log_ratio)/(1-s);
+    out += (powl(M, -s) + powl(N, -s))/2;
+    long double rising = s, factorial = 2; //s(s+1)...(s+2k-2) and (2k)!
+    for (int k=1; k<= 8; k++){
+        int j = 2*k - 1;  //the odd derivative of n^{-s} is -rising n^{-s-j}
+        out -= bernoulli[k-1]/factorial * rising * (powl(N, -s-j) - powl(M, -s-j));
+        rising *= (s+j)*(s+j+1);
+        factorial *= (2*k+1)*(2*k+2);
+    }
+    return out;
+}
 
-\li There are no doubt efficient shortcuts do doing this, but I use brute force. [Though Knuth's Art of Programming v1 doesn't offer anything, which is strong indication of nonexistence.] To speed things along, I save the results so that they can just be looked up should you request the same calculation. 
+/** Calculate \f$\sum_{n=1}^N {1\over n^s}\f$
 
+\li For small \c N, this is a direct sum. For large \c N, the first few terms are
+summed directly and the rest is found via the Euler-Maclaurin expansion, so the time
+taken does not depend on \c N. Either way, the result is accurate to about long double precision.
+\li The function keeps no shared state, so it is safe to call from multiple threads at
+once. Each thread remembers its last result, because likelihoods like the Zipf's call
+this repeatedly with the same inputs.
 \li If \c N is zero or negative, return NaN. Notify the user if <tt>apop_opts.verbosity >=0</tt>
 
 For example: 
@@ -136,44 +160,23 @@ For example:
 \include test_harmonic.c
 */
 long double apop_generalized_harmonic(int N, double s){
-/* 
-Each row in the saved-results structure is an \f$s\f$, and each column is \f$1\dots n\f$, up to the largest \f$n\f$ calculated to date.
-
-When reading the code, remember that the zeroth element holds the value for N=1, and so on.
-*/
     Apop_stopif(N<=0, return GSL_NAN, 0, "N is %i, but must be greater than 0.", N);
-    static double *  eses	= NULL;
-    static int * 	 lengths= NULL;
-    static int		 count	= 0;
-    static long double ** precalced=NULL;
-    int	old_len, i;
-    OMP_critical(generalized_harmonic)
-    { //Due to memoization, this can't parallelize.
-	for (i=0; i< count; i++)
-		if (eses == NULL || eses[i] == s) 	
-            break;
-	if (i == count){	//you need to build the vector from scratch.
-		count			++;
-        i               = count - 1;
-		precalced 		= realloc(precalced, sizeof (long double*) * count);
-		lengths 		= realloc(lengths, sizeof (int*) * count);
-		eses 			= realloc(eses, sizeof (double) * count);
-		precalced[i]	= malloc(sizeof(long double) * N);
-		lengths[i]	    = N;
-		eses[i]		    = s;
-		precalced[i][0]	= 1;
-		old_len			= 1;
-	}
-	else {	//then you found it.
-		old_len = lengths[i];
-	}
-	if (N-1 >= old_len){	//It's there, but you need to extend what you have.
-		precalced[i] = realloc(precalced[i], sizeof(long double) * N);
-		for (int j = old_len; j<N; j++)
-			precalced[i][j] = precalced[i][j-1] + 1/pow((j+1),s);
-	}
+    static threadlocal int last_N = 0;
+    static threadlocal double last_s;
+    static threadlocal long double last_out;
+    if (N == last_N && s == last_s) return last_out;
+
+    double M = 16 + ceil(fabs(s));
+    long double out = 0;
+    if (N <= 4*M)
+        for (int n=N; n>= 1; n--) out += powl(n, -s);
+    else {
+        for (int n=M-1; n>= 1; n--) out += powl(n, -s);
+        out += harmonic_tail(M, N, s);
     }
-	return 	precalced[i][N-1];
+    last_N = N;
+    last_s = s;
+    return last_out = out;
 }
 
 /** Call \c system(), but with <tt>printf</tt>-style arguments. E.g.,
@@ -376,6 +379,36 @@ gsl_rng *apop_rng_get_thread_base(int thread){
     return rngs[thread];
 }
 
+#define Draw_block 1024
+
+/* Fill a matrix with standard Normal draws, via the polar form of Box-Muller. Each
+   accepted pair of uniforms produces two Normals, and the second is carried over to the
+   next element (in the next row if need be), so none are discarded. */
+void std_normal_block(gsl_matrix *out, gsl_rng *r){
+    double spare = 0;
+    int have_spare = 0;
+    for (size_t i=0; i< out->size1; i++){
+        double *row = gsl_matrix_ptr(out, i, 0);
+        for (size_t j=0; j< out->size2; j++){
+            if (have_spare){
+                row[j] = spare;
+                have_spare = 0;
+                continue;
+            }
+            double x, y, rsq;
+            do {
+                x = 2*gsl_rng_uniform(r) - 1;
+                y = 2*gsl_rng_uniform(r) - 1;
+                rsq = x*x + y*y;
+            } while (rsq >= 1 || rsq == 0);
+            double scale = sqrt(-2*log(rsq)/rsq);
+            row[j] = x*scale;
+            spare = y*scale;
+            have_spare = 1;
+        }
+    }
+}
+
 /** Make a set of random draws from a model and write them to an \ref apop_data set.
 
 \param model The model from which draws will be made. Must already be prepared and/or estimated.
@@ -395,6 +428,11 @@ gsl_rng *apop_rng_get_thread_base(int thread){
 \li Prints a warning if you send in a non-<tt>NULL apop_data</tt> set, but its \c matrix element is \c NULL, when <tt>apop_opts.verbose>=1</tt>.
 \li See also \ref apop_draw, which makes a single draw.
 \li Random numbers are generated using RNGs from \ref apop_rng_get_thread, qv.
+\li If the model has a function registered in the \c apop_draw_many vtable, the
+matrix is filled a block of rows at a time via that function; else I call \ref apop_draw once per row.
+The function has the form <tt>int draw_many(gsl_matrix *out, gsl_rng *r, apop_model *m)</tt>,
+fills every row of \c out, which has \c m->dsize columns, and returns nonzero on error, in which
+case the block is set to all \c NAN. The hash is based on the model's \c draw method.
 
 Here is a two-line program to draw a different set of ten Standard Normals on every run (provided runs are more than a second apart):
 
@@ -418,6 +456,24 @@ APOP_VAR_HEAD apop_data *apop_model_draws(apop_model *model, int count, apop_dat
 APOP_VAR_ENDHEAD
     apop_data *out = draws ? draws : apop_data_alloc(count, model->dsize);
 
+    //Attach the ARMS settings here, not in the threads, where they'd all try at once.
+    if (!model->draw && model->dsize == 1 && !Apop_settings_get_group(model, apop_arms))
+        Apop_model_add_group(model, apop_arms, .model=model);
+
+    apop_draw_many_type draw_many = apop_draw_many_vtable_get(model);
+    if (draw_many){
+        int block_ct = (count + Draw_block - 1)/Draw_block;
+        OMP_for (int b=0; b< block_ct; b++){
+            size_t start = b*Draw_block;
+            size_t len = GSL_MIN(Draw_block, count - start);
+            gsl_matrix_view rows = gsl_matrix_submatrix(out->matrix, start, 0, len, model->dsize);
+            Apop_stopif(draw_many(&rows.matrix, apop_rng_get_thread(omp_threadnum), model),
+                    gsl_matrix_set_all(&rows.matrix, GSL_NAN); out->error='d',
+                    0, "Trouble drawing for rows %zu--%zu. "
+                    "I set them to all NANs and set out->error='d'.", start, start+len-1);
+        }
+        return out;
+    }
     OMP_for (int i=0; i< count; i++){
         apop_data *onerow = Apop_r(out, i);
         Apop_stopif(apop_draw(onerow->matrix->data, apop_rng_get_thread(omp_threadnum), model),
@@ -10,123 +10,124 @@ sqlite3	*db=NULL;	                //There's only one SQLite database handle. Her
 
 
 
-/** \cond doxy_ignore */
-typedef struct StdDevCtx StdDevCtx;
-struct StdDevCtx {
-    double avg;     /* avg of terms */
-    double avg2;    /* avg of the squares of terms */
-    double avg3;    /* avg of the cube of terms */
-    double avg4;    /* avg of the fourth-power of terms */
-    int cnt;        /* Number of terms counted */
-};
-/** \endcond */
-
-static void twoStep(sqlite3_context *context, int argc, sqlite3_value **argv){
-    if (argc<1) return;
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && argv[0]){
-        double x = sqlite3_value_double(argv[0]);
-        double ratio = p->cnt/(p->cnt+1.0);
-        p->cnt++;
-        p->avg	*= ratio;
-        p->avg2	*= ratio;
-        p->avg += x/(p->cnt +0.0);
-        p->avg2 += gsl_pow_2(x)/(p->cnt +0.0);
-    }
-}
-
-static void threeStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+/* The moment aggregates all keep an apop_moments tally as their aggregate context.
+SQLite hands us a zeroed context, which is an empty tally. */
+static void momentStep(sqlite3_context *context, int argc, sqlite3_value **argv){
     if (argc<1) return;
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && argv[0]){
-        double x = sqlite3_value_double(argv[0]);
-        double ratio =  p->cnt/(p->cnt+1.0);
-        p->cnt++;
-        p->avg	*= ratio;
-        p->avg2	*= ratio;
-        p->avg3	*= ratio;
-        p->avg += x/p->cnt;
-        p->avg2 += gsl_pow_2(x)/p->cnt;
-        p->avg3 += gsl_pow_3(x)/p->cnt;
-    }
-}
-
-static void fourStep(sqlite3_context *context, int argc, sqlite3_value **argv){
-    if( argc<1 ) return;
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && argv[0]){
-        double x = sqlite3_value_double(argv[0]);
-        p->cnt++;
-        p->avg = (x + p->avg * (p->cnt-1.))/p->cnt;
-        p->avg2 = (gsl_pow_2(x)+ p->avg2 * (p->cnt-1.))/p->cnt;
-        p->avg3 = (gsl_pow_3(x)+ p->avg3 * (p->cnt-1.))/p->cnt;
-        p->avg4 = (gsl_pow_4(x)+ p->avg4 * (p->cnt-1.))/p->cnt;
-    }
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && argv[0])
+        apop_moments_add(p, sqlite3_value_double(argv[0]), 1);
 }
 
 static void stdDevFinalizePop(sqlite3_context *context){
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && p->cnt>1)
-      sqlite3_result_double(context, sqrt((p->avg2 - gsl_pow_2(p->avg))));
-    else if (p->cnt == 1)
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->count>1)
+      sqlite3_result_double(context, sqrt(p->m2/p->count));
+    else if (p && p->count == 1)
       	sqlite3_result_double(context, 0);
 }
 
 static void varFinalizePop(sqlite3_context *context){
-  StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 )
-        sqlite3_result_double(context, (p->avg2 - gsl_pow_2(p->avg)));
-    else if (p->cnt == 1)
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if( p && p->count>1 )
+        sqlite3_result_double(context, p->m2/p->count);
+    else if (p && p->count == 1)
     	sqlite3_result_double(context, 0);
 }
 
 static void stdDevFinalize(sqlite3_context *context){
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double rCnt = p->cnt;
-      sqlite3_result_double(context,
-         sqrt((p->avg2 - gsl_pow_2(p->avg))*rCnt/(rCnt-1.0)));
-    } else if (p->cnt == 1)
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if( p && p->count>1 )
+      sqlite3_result_double(context, sqrt(p->m2/(p->count-1.0)));
+    else if (p && p->count == 1)
       	sqlite3_result_double(context, 0);
 }
 
 static void varFinalize(sqlite3_context *context){
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double rCnt = p->cnt;
-      sqlite3_result_double(context,
-         (p->avg2 - gsl_pow_2(p->avg))*rCnt/(rCnt-1.0));
-    } else if (p->cnt == 1)
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if( p && p->count>1 )
+      sqlite3_result_double(context, p->m2/(p->count-1.0));
+    else if (p && p->count == 1)
       	sqlite3_result_double(context, 0);
 }
 
 static void skewFinalize(sqlite3_context *context){
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double rCnt = p->cnt;
-      sqlite3_result_double(context,
-         (p->avg3*rCnt - 3*p->avg2*p->avg*rCnt 
-                        + 2*rCnt * gsl_pow_3(p->avg)) * rCnt/((rCnt-1.0)*(rCnt-2.0)));
-    } else if (p->cnt == 1)
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if( p && p->count>1 ){
+      double rCnt = p->count;
+      sqlite3_result_double(context, p->m3 * rCnt/((rCnt-1.0)*(rCnt-2.0)));
+    } else if (p && p->count == 1)
       	sqlite3_result_double(context, 0);
 }
 
 static void kurtFinalize(sqlite3_context *context){
-    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double n = p->cnt;
-      double kurtovern = p->avg4 - 4*p->avg3*p->avg
-                        + 6 * p->avg2*gsl_pow_2(p->avg)
-                        - 3* gsl_pow_4(p->avg);
-      double var = p->avg2 - gsl_pow_2(p->avg);
+    apop_moments *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if( p && p->count>1 ){
+      double n = p->count;
+      double kurtovern = p->m4/n;
+      double var = p->m2/n;
       long double coeff0= n*n/(gsl_pow_3(n)*(gsl_pow_2(n)-3*n+3));
       long double coeff1= n*gsl_pow_2(n-1)+ (6*n-9);
       long double coeff2= n*(6*n-9);
       sqlite3_result_double(context, coeff0*(coeff1 * kurtovern + coeff2 * gsl_pow_2(var)));
-    } else if (p->cnt == 1)
+    } else if (p && p->count == 1)
       sqlite3_result_double(context, 0);
 }
 
+/* The quantile aggregates keep a quantile sketch, plus the quantile requested. */
+typedef struct {
+    apop_quantile_sketch *sketch;
+    double q;
+} sketch_ctx;
+
+static void sketchStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    sketch_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    if (!p->sketch){
+        p->sketch = apop_quantile_sketch_alloc();
+        p->q = argc > 1 ? sqlite3_value_double(argv[1]) : .5;
+    }
+    apop_quantile_sketch_add(p->sketch, sqlite3_value_double(argv[0]), 1);
+}
+
+static void sketchMergeStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    sketch_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || sqlite3_value_type(argv[0]) != SQLITE_BLOB) return;
+    apop_quantile_sketch *in = apop_quantile_sketch_deserialize(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]));
+    if (!in) return;
+    if (!p->sketch) p->sketch = in;
+    else {
+        apop_quantile_sketch_merge(p->sketch, in);
+        apop_quantile_sketch_free(in);
+    }
+}
+
+static void sketchQuantileFinalize(sqlite3_context *context){
+    sketch_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->sketch){
+        sqlite3_result_double(context, apop_quantile_sketch_query(p->sketch, p->q));
+        apop_quantile_sketch_free(p->sketch);
+    }
+}
+
+static void sketchBlobFinalize(sqlite3_context *context){
+    sketch_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->sketch){
+        size_t byte_ct;
+        void *blob = apop_quantile_sketch_serialize(p->sketch, &byte_ct);
+        sqlite3_result_blob(context, blob, byte_ct, free);
+        apop_quantile_sketch_free(p->sketch);
+    }
+}
+
+static void sketchQuantileFn(sqlite3_context *context, int argc, sqlite3_value **argv){
+    if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) return;
+    apop_quantile_sketch *s = apop_quantile_sketch_deserialize(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]));
+    if (!s) return;
+    sqlite3_result_double(context, apop_quantile_sketch_query(s, sqlite3_value_double(argv[1])));
+    apop_quantile_sketch_free(s);
+}
+
 static void powFn(sqlite3_context *context, int argc, sqlite3_value **argv){
     double base = sqlite3_value_double(argv[0]);
     double exp  = sqlite3_value_double(argv[1]);
@@ -150,17 +151,22 @@ static int apop_sqlite_db_open(char const *filename){
     int status = sqlite3_open(filename ? filename : ":memory:", &db);
     Apop_stopif(status, db=NULL; return status,
             0, "The database %s didn't open.", filename ? filename : "in memory");
-	sqlite3_create_function(db, "stddev", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalize);
-	sqlite3_create_function(db, "std", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalizePop);
-	sqlite3_create_function(db, "stddev_samp", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalize);
-	sqlite3_create_function(db, "stddev_pop", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalizePop);
-	sqlite3_create_function(db, "var", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalize);
-	sqlite3_create_function(db, "var_samp", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalize);
-	sqlite3_create_function(db, "var_pop", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalizePop);
-	sqlite3_create_function(db, "variance", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalizePop);
-	sqlite3_create_function(db, "skew", 1, SQLITE_ANY, NULL, NULL, &threeStep, &skewFinalize);
-	sqlite3_create_function(db, "kurt", 1, SQLITE_ANY, NULL, NULL, &fourStep, &kurtFinalize);
-	sqlite3_create_function(db, "kurtosis", 1, SQLITE_ANY, NULL, NULL, &fourStep, &kurtFinalize);
+	sqlite3_create_function(db, "stddev", 1, SQLITE_ANY, NULL, NULL, &momentStep, &stdDevFinalize);
+	sqlite3_create_function(db, "std", 1, SQLITE_ANY, NULL, NULL, &momentStep, &stdDevFinalizePop);
+	sqlite3_create_function(db, "stddev_samp", 1, SQLITE_ANY, NULL, NULL, &momentStep, &stdDevFinalize);
+	sqlite3_create_function(db, "stddev_pop", 1, SQLITE_ANY, NULL, NULL, &momentStep, &stdDevFinalizePop);
+	sqlite3_create_function(db, "var", 1, SQLITE_ANY, NULL, NULL, &momentStep, &varFinalize);
+	sqlite3_create_function(db, "var_samp", 1, SQLITE_ANY, NULL, NULL, &momentStep, &varFinalize);
+	sqlite3_create_function(db, "var_pop", 1, SQLITE_ANY, NULL, NULL, &momentStep, &varFinalizePop);
+	sqlite3_create_function(db, "variance", 1, SQLITE_ANY, NULL, NULL, &momentStep, &varFinalizePop);
+	sqlite3_create_function(db, "skew", 1, SQLITE_ANY, NULL, NULL, &momentStep, &skewFinalize);
+	sqlite3_create_function(db, "kurt", 1, SQLITE_ANY, NULL, NULL, &momentStep, &kurtFinalize);
+	sqlite3_create_function(db, "kurtosis", 1, SQLITE_ANY, NULL, NULL, &momentStep, &kurtFinalize);
+	sqlite3_create_function(db, "approx_quantile", 2, SQLITE_ANY, NULL, NULL, &sketchStep, &sketchQuantileFinalize);
+	sqlite3_create_function(db, "approx_median", 1, SQLITE_ANY, NULL, NULL, &sketchStep, &sketchQuantileFinalize);
+	sqlite3_create_function(db, "quantile_sketch", 1, SQLITE_ANY, NULL, NULL, &sketchStep, &sketchBlobFinalize);
+	sqlite3_create_function(db, "quantile_sketch_merge", 1, SQLITE_ANY, NULL, NULL, &sketchMergeStep, &sketchBlobFinalize);
+	sqlite3_create_function(db, "sketch_quantile", 2, SQLITE_ANY, NULL, &sketchQuantileFn, NULL, NULL);
 	sqlite3_create_function(db, "ln", 1, SQLITE_ANY, NULL, &logFn, NULL, NULL);
 	sqlite3_create_function(db, "ran", 0, SQLITE_ANY, NULL, &rngFn, NULL, NULL);
 	sqlite3_create_function(db, "pow", 2, SQLITE_ANY, NULL, &powFn, NULL, NULL);
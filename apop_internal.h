@@ -59,10 +59,12 @@ void apop_gsl_error(char const *reason, char const *file, int line, int gsl_errn
 #define OMP_critical(tag) PRAGMA(omp critical ( tag ))
 #define OMP_for(...) _Pragma("omp parallel for") for(__VA_ARGS__)
 #define OMP_for_reduce(red, ...) PRAGMA(omp parallel for reduction( red )) for(__VA_ARGS__)
+#define OMP_atomic _Pragma("omp atomic")
 #else
 #define OMP_critical(tag)
 #define OMP_for(...) for(__VA_ARGS__)
 #define OMP_for_reduce(red, ...) for(__VA_ARGS__)
+#define OMP_atomic
 #endif
 
 #include "config.h"
@@ -81,6 +83,21 @@ extern int vasprintf (char **res, const char *format, va_list args)
 #endif
 
 #include "apop.h"
+#include <stdint.h>
 void add_info_criteria(apop_data *d, apop_model *m, apop_model *est, double ll, int param_ct); //In apop_mle.c
 
 apop_model *maybe_prep(apop_data *d, apop_model *m, _Bool *is_a_copy); //in apop_mcmc, for apop_update.
+char alias_table(gsl_vector const *w, gsl_vector **prob, size_t **alias); //in apop_pmf.c, for apop_mixture.c
+void suff_stats(apop_data *d, apop_model *m, apop_suff_stats_type fn, double *out); //in apop_model.c
+uint64_t params_hash(apop_data const *p); //in apop_model.c, for apop_dconstrain and apop_arms
+apop_mvn_settings *mvn_factor(apop_model *m); //in apop_multivariate_normal.c, for apop_wishart.c
+void std_normal_block(gsl_matrix *out, gsl_rng *r); //in apop_asst.c, for draw_many functions
+
+//Run the given code for every element x of the vector and matrix of d's first page.
+#define Loop_over_elmts(d, x, ...) {                                                  \
+    if ((d)->vector) for (size_t i_ = 0; i_ < (d)->vector->size; i_++){               \
+        double x = gsl_vector_get((d)->vector, i_); __VA_ARGS__ }                      \
+    if ((d)->matrix) for (size_t i_ = 0; i_ < (d)->matrix->size1; i_++)               \
+        for (size_t j_ = 0; j_ < (d)->matrix->size2; j_++){                            \
+            double x = gsl_matrix_get((d)->matrix, i_, j_); __VA_ARGS__ }              \
+}
@@ -85,6 +85,74 @@ double apop_matrix_determinant(const gsl_matrix *in) {
     return apop_det_and_inv(in, NULL, 1, 0);
 }
 
+//Modified Gram-Schmidt, run twice for numerical orthogonality, on the rows of m.
+//Rows that are (numerically) in the span of prior rows are zeroed.
+static void orthonormalize_rows(gsl_matrix *m){
+    for (size_t i=0; i< m->size1; i++){
+        gsl_vector_view ri = gsl_matrix_row(m, i);
+        double start_len = gsl_blas_dnrm2(&ri.vector);
+        for (int pass=0; pass< 2; pass++)
+            for (size_t j=0; j< i; j++){
+                gsl_vector_view rj = gsl_matrix_row(m, j);
+                double dot;
+                gsl_blas_ddot(&ri.vector, &rj.vector, &dot);
+                gsl_blas_daxpy(-dot, &rj.vector, &ri.vector);
+            }
+        double len = gsl_blas_dnrm2(&ri.vector);
+        if (len > 1e-12*start_len) gsl_vector_scale(&ri.vector, 1/len);
+        else gsl_vector_set_zero(&ri.vector);
+    }
+}
+
+/* Halko, Martinsson, and Tropp's randomized range finder. With X the (centered) n x p
+data, Q is an orthonormal basis for the range of X Omega, for a Gaussian p x l Omega,
+sharpened by power iterations that alternate between X^T and X. The leading right
+singular vectors of Q^T X then approximate those of X. Everything is kept transposed (l x n
+and l x p) so that orthonormalization works on contiguous rows.
+
+The eigenvalues of X^T X are the squared singular values, and their total is the squared
+Frobenius norm of X, so the weights are on the same scale as for the exact method. */
+static int pca_randomized(gsl_matrix const *data, apop_data *pc_space, int dims, int power_iterations){
+    size_t n = data->size1, p = data->size2,
+           l = GSL_MIN(dims + 10, GSL_MIN(n, p)); //oversample by ten
+    int status;
+    gsl_matrix *omega_t = gsl_matrix_alloc(l, p),
+               *q_t     = gsl_matrix_alloc(l, n),
+               *b       = gsl_matrix_alloc(l, p),
+               *bt      = gsl_matrix_alloc(p, l),
+               *v       = gsl_matrix_alloc(l, l);
+    gsl_vector *sv = gsl_vector_alloc(l), *work = gsl_vector_alloc(l);
+    std_normal_block(omega_t, apop_rng_get_thread());
+    gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1, omega_t, data, 0, q_t);  //(X Omega)^T
+    orthonormalize_rows(q_t);
+    for (int i=0; i< power_iterations; i++){
+        gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1, q_t, data, 0, b); //(X^T Q)^T
+        orthonormalize_rows(b);
+        gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1, b, data, 0, q_t);   //(X Q')^T
+        orthonormalize_rows(q_t);
+    }
+    gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1, q_t, data, 0, b);     //B = Q^T X
+    gsl_matrix_transpose_memcpy(bt, b);
+    status = gsl_linalg_SV_decomp(bt, v, sv, work);  //B^T = U S V^T; U's columns are the components.
+    if (!status){
+        double total = 0;
+        for (size_t i=0; i< n; i++){
+            gsl_vector_const_view r = gsl_matrix_const_row(data, i);
+            total += gsl_pow_2(gsl_blas_dnrm2(&r.vector));
+        }
+        for (int i=0; i< dims; i++){
+            gsl_vector_view u = gsl_matrix_column(bt, i);
+            gsl_matrix_set_col(pc_space->matrix, i, &u.vector);
+            gsl_vector_set(pc_space->vector, i, gsl_pow_2(gsl_vector_get(sv, i))/total);
+        }
+    }
+    gsl_matrix_free(omega_t); gsl_matrix_free(q_t);
+    gsl_matrix_free(b);       gsl_matrix_free(bt);
+    gsl_matrix_free(v);
+    gsl_vector_free(sv);      gsl_vector_free(work);
+    return status;
+}
+
 /** Principal component analysis: hand in a matrix and (optionally) a number of desired dimensions, and I'll return a data set where each column of the matrix is an eigenvector. The columns are sorted, so column zero has the greatest weight. The vector element of the data set gives the weights.
 
 You may also specify the number of elements your principal component space should have. If
@@ -99,18 +167,39 @@ mean zero. (No default. If \c NULL, return \c NULL and print a warning iff
 
 \param dimensions_we_want The singular value decomposition will return this many of the eigenvectors with the largest eigenvalues. (default: the size of the covariance matrix, i.e. <tt>data->size2</tt>)
 
+\param method If \c 'e', find all eigenvectors of the \f$X'X\f$ matrix, then keep the
+ones you asked for. If \c 'r', use a randomized truncated SVD (Halko, Martinsson, and
+Tropp, <em>Finding Structure with Randomness</em>), which works directly on the data
+matrix and never forms \f$X'X\f$. Its cost is proportional to the size of the data times
+<tt>dimensions_we_want</tt>, rather than to the cube of the number of columns, so use it
+when you want a few components of a wide data set. The result is an approximation,
+whose quality improves with more power iterations and with a faster drop-off in the
+eigenvalues. (default: \c 'e')
+
+\param power_iterations For the randomized method, the number of passes of multiplying
+by \f$X'\f$ and \f$X\f$ to sharpen the estimate of the leading subspace. Each pass costs
+two more multiplications by the data matrix. (default: 2)
+
 \return  Returns an \ref apop_data set whose matrix is the principal component
 space. Each column of the returned matrix will be another eigenvector; the columns
 will be ordered by the eigenvalues.
 
 The data set's vector will be the largest eigenvalues, scaled by the total of all eigenvalues (including those that were thrown out). The sum of these returned values will give you the percentage of variance explained by the factor analysis.
 
+\li The randomized method uses the RNG from \ref apop_rng_get_thread. If it is asked for
+nearly as many dimensions as the data has columns, there is nothing to save, and it
+falls back to the exact method.
+\li This function uses the \ref designated syntax for inputs.
+
 \exception out->error=='a'  Allocation error.
+\exception out->error=='m'  Error in the singular value decomposition.
 */
-APOP_VAR_HEAD apop_data * apop_matrix_pca(gsl_matrix *data, int const dimensions_we_want) {
+APOP_VAR_HEAD apop_data * apop_matrix_pca(gsl_matrix *data, int const dimensions_we_want, char method, int power_iterations) {
     gsl_matrix * apop_varad_var(data, NULL);
     Apop_stopif(!data, return NULL, 1, "NULL data input");
     int const apop_varad_var(dimensions_we_want, data->size2);
+    char apop_varad_var(method, 'e');
+    int apop_varad_var(power_iterations, 2);
 APOP_VAR_ENDHEAD
     Set_gsl_handler
     apop_data *pc_space	= apop_data_alloc(0, data->size2, dimensions_we_want);
@@ -118,6 +207,14 @@ APOP_VAR_ENDHEAD
 	pc_space->vector = gsl_vector_alloc(dimensions_we_want);
     Apop_stopif(!pc_space->vector, pc_space->error='a'; return pc_space, 
                 0, "Allocation error setting up a %i vector.", dimensions_we_want);
+    for (int i=0; i< data->size2; i++)
+        apop_vector_normalize(Apop_mcv(data, i), NULL, 'm');
+    if (method == 'r' && dimensions_we_want + 10 < GSL_MIN(data->size1, data->size2)){
+        if (pca_randomized(data, pc_space, dimensions_we_want, power_iterations))
+            pc_space->error = 'm';
+        Unset_gsl_handler
+        return pc_space;
+    }
     gsl_matrix *eigenvectors = gsl_matrix_alloc(data->size2, data->size2);
     gsl_vector *dummy_v 	 = gsl_vector_alloc(data->size2);
     gsl_vector *all_evalues  = gsl_vector_alloc(data->size2);
@@ -125,8 +222,6 @@ APOP_VAR_ENDHEAD
     Apop_stopif(!eigenvectors || !dummy_v || !all_evalues || !square, pc_space->error='a'; return pc_space, 
                 0, "Allocation error setting up workspace for %zu dimensions.", data->size2);
     double eigentotals	= 0;
-    for (int i=0; i< data->size2; i++)
-        apop_vector_normalize(Apop_mcv(data, i), NULL, 'm');
 
 	Checkgsl(gsl_blas_dgemm(CblasTrans,CblasNoTrans, 1, data, data, 0, square))
 	Checkgsl(gsl_linalg_SV_decomp(square, eigenvectors, all_evalues, dummy_v))
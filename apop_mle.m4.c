@@ -650,6 +650,11 @@ void apop_maximum_likelihood(apop_data * data, apop_model *dist){
     info.beta = apop_data_pack(dist->parameters);
     if (setup_starting_point(mp, info.beta)) return;
     info.model->data = data;
+
+    //The data is fixed for the search, so models with sufficient statistics can cache them.
+    int cache_stats = apop_suff_stats_vtable_get(dist) && !apop_settings_get_group(dist, apop_suff_stats);
+    if (cache_stats) Apop_model_add_group(dist, apop_suff_stats);
+
     if (mp->dim_cycle_tolerance)            dim_cycle(data, dist, info);
     else if (!strcasecmp(mp->method, "annealing"))   apop_annealing(&info);  //below.
     else if (!strcasecmp(mp->method, "NM simplex"))  apop_maximum_likelihood_no_d(data, &info);
@@ -657,6 +662,7 @@ void apop_maximum_likelihood(apop_data * data, apop_model *dist){
             !strcasecmp(mp->method, "Newton hybrid")||
             !strcasecmp(mp->method, "Newton hybrid no scale")) find_roots (info);
     else   /* Conjugate Gradient*/   apop_maximum_likelihood_w_d(data, &info);
+    if (cache_stats) Apop_settings_rm_group(dist, apop_suff_stats);
 }
 
 /** Maximum likelihod searches are not guaranteed to find a global optimum, and it can be
@@ -300,6 +300,73 @@ void apop_score(apop_data *d, gsl_vector *out, apop_model *m){
     gsl_vector_free(numeric_default);
 }
 
+Apop_settings_init(apop_suff_stats, )
+Apop_settings_copy(apop_suff_stats, out->filled = 0;) //a copy may see other data.
+Apop_settings_free(apop_suff_stats, )
+
+//A 64-bit hash of every number in the parameter set (all pages), for spotting changes.
+uint64_t params_hash(apop_data const *p){
+    uint64_t h = 14695981039346656037ULL;
+    #define Mix(x) {h ^= (x); h *= 1099511628211ULL; h ^= h >> 29;}
+    for ( ; p; p = p->more){
+        if (p->vector){
+            Mix(p->vector->size)
+            for (size_t i=0; i< p->vector->size; i++){
+                double x = gsl_vector_get(p->vector, i);
+                uint64_t bits;
+                memcpy(&bits, &x, sizeof(bits));
+                Mix(bits)
+            }
+        }
+        if (p->matrix){
+            Mix(p->matrix->size1) Mix(p->matrix->size2)
+            for (size_t i=0; i< p->matrix->size1; i++)
+                for (size_t j=0; j< p->matrix->size2; j++){
+                    double x = gsl_matrix_get(p->matrix, i, j);
+                    uint64_t bits;
+                    memcpy(&bits, &x, sizeof(bits));
+                    Mix(bits)
+                }
+        }
+    }
+    #undef Mix
+    return h;
+}
+
+/* Fill \c out (which needs room for eight numbers) with the sufficient statistics of
+\c d, as calculated by \c fn. If the
+model has an apop_suff_stats group and the last statistics it holds are for the same data
+set, copy those; else calculate and store them. The calculation happens outside of the
+lock, so two threads may both calculate, but each gets a consistent set. */
+void suff_stats(apop_data *d, apop_model *m, apop_suff_stats_type fn, double *out){
+    apop_suff_stats_settings *ss = apop_settings_get_group(m, apop_suff_stats);
+    if (!ss){
+        fn(d, out);
+        return;
+    }
+    Get_vmsizes(d); //vsize, msize1, msize2, wsize
+    void const *key[4] = {d, vsize ? d->vector->data : NULL, msize1 ? d->matrix->data : NULL,
+                             wsize ? d->weights->data : NULL};
+    size_t sizes[3] = {vsize, msize1, msize2};
+    int hit;
+    OMP_critical(suff_stats)
+    {
+        hit = ss->filled && ss->cached_version == ss->version
+                 && !memcmp(ss->key, key, sizeof(key)) && !memcmp(ss->sizes, sizes, sizeof(sizes));
+        if (hit) memcpy(out, ss->stats, sizeof(ss->stats));
+    }
+    if (hit) return;
+    fn(d, out);
+    OMP_critical(suff_stats)
+    {
+        memcpy(ss->key, key, sizeof(key));
+        memcpy(ss->sizes, sizes, sizeof(sizes));
+        memcpy(ss->stats, out, sizeof(ss->stats));
+        ss->cached_version = ss->version;
+        ss->filled = 1;
+    }
+}
+
 Apop_settings_init(apop_pm,
     //defaults include base=NULL, index=0, own_rng=0
     Apop_varad_set(rng, NULL);
@@ -57,18 +57,175 @@ double apop_vector_kurtosis(const gsl_vector *in){
     return  coeff0 *(coeff1 * apop_vector_kurtosis_pop(in) - coeff2 * gsl_pow_2(apop_vector_var(in)*(n-1.)/n));
 }
 
-static double wskewkurt(const gsl_vector *v, const gsl_vector *w, const int exponent, const char *fn_name){
-    long double wsum = 0, sumcu = 0, vv, ww, mu;
-    //Using the E(x - \bar x)^3 form, which is lazy.
-    mu  = apop_vector_mean(v, w);
-    for (size_t i=0; i< w->size; i++){
-        vv    = gsl_vector_get(v,i);
-        ww    = gsl_vector_get(w,i);
-        sumcu+= ww * gsl_pow_int(vv - mu, exponent); 
-        wsum += ww; 
+/** Add one observation to a running tally of moments, using the one-pass updates of
+Welford and Terriberry, generalized to weighted data.
+
+\param m      The tally to update. A zeroed \ref apop_moments is an empty tally.
+\param x      The new observation.
+\param weight Its weight. Use 1 for unweighted data. Observations with zero weight
+              are counted in \c m->count and the extremes but otherwise ignored.
+
+\li The tally keeps centered sums rather than sums of raw powers, so it does not suffer
+the catastrophic cancellation of the \f$E(x^2)-E^2(x)\f$ form when the mean is large
+relative to the spread.
+\li Use \ref apop_moments_var, \ref apop_moments_skew_pop, or \ref
+apop_moments_kurtosis_pop to read the statistics off of the tally. The mean is
+<tt>m->mean</tt>.
+
+\code
+apop_moments m = {};
+for (int i=0; i< 10; i++) apop_moments_add(&m, i, 1);
+printf("mean: %Lg; var: %g\n", m.mean, apop_moments_var(&m));
+\endcode
+*/
+void apop_moments_add(apop_moments *m, double x, double weight){
+    if (!m->count++) m->min = m->max = x;
+    else if (x < m->min) m->min = x;
+    else if (x > m->max) m->max = x;
+    if (!weight) return;
+    long double na = m->weight, n = na + weight,
+                d = x - m->mean,
+                dn = d/n,
+                term = d*dn*na*weight;
+    m->mean += dn*weight;
+    m->m4 += term*dn*dn*(na*na - na*weight + weight*weight)
+             + 6*dn*dn*weight*weight*m->m2 - 4*dn*weight*m->m3;
+    m->m3 += term*dn*(na - weight) - 3*dn*weight*m->m2;
+    m->m2 += term;
+    m->weight = n;
+}
+
+/** Combine the tallies of two disjoint sets of observations into the tally for their
+union, following Chan, Golub, and LeVeque's pairwise formulas as extended to higher
+moments by Pébay. Neither input is modified.
+
+This is what makes the tally useful for parallel work: give each thread its own \ref
+apop_moments, and merge them when all the threads are done. 
+
+\code
+apop_moments head = apop_vector_moments(Apop_subvector(v, 0, 100)),
+             tail = apop_vector_moments(Apop_subvector(v, 100, v->size-100));
+apop_moments all = apop_moments_merge(head, tail);
+\endcode
+*/
+apop_moments apop_moments_merge(apop_moments a, apop_moments b){
+    if (!b.count) return a;
+    if (!a.count) return b;
+    double min = GSL_MIN(a.min, b.min), max = GSL_MAX(a.max, b.max);
+    if (!b.weight) {a.count += b.count; a.min = min; a.max = max; return a;}
+    if (!a.weight) {b.count += a.count; b.min = min; b.max = max; return b;}
+    long double na = a.weight, nb = b.weight, n = na + nb,
+                d = b.mean - a.mean,
+                dn = d/n;
+    return (apop_moments){.count = a.count + b.count, .weight = n,
+        .min = min, .max = max,
+        .mean = a.mean + dn*nb,
+        .m2 = a.m2 + b.m2 + d*dn*na*nb,
+        .m3 = a.m3 + b.m3 + d*dn*dn*na*nb*(na - nb)
+                + 3*dn*(na*b.m2 - nb*a.m2),
+        .m4 = a.m4 + b.m4 + d*dn*dn*dn*na*nb*(na*na - na*nb + nb*nb)
+                + 6*dn*dn*(na*na*b.m2 + nb*nb*a.m2)
+                + 4*dn*(na*b.m3 - nb*a.m3)
+    };
+}
+
+//The weighting convention of apop_vector_var and friends: weights that sum to less
+//than about one are proportions, so the count is the effective n.
+static long double moments_len(apop_moments const *m){
+    return m->weight < 1.1 ? m->count : m->weight;
+}
+
+/** The sample variance of the observations in an \ref apop_moments tally, with the
+same conventions as \ref apop_vector_var. */
+double apop_moments_var(apop_moments const *m){
+    Apop_stopif(!m || !m->weight, return GSL_NAN, 0, "empty tally. Returning NaN.");
+    long double len = moments_len(m);
+    return (m->m2 + m->weight*gsl_pow_2(m->mean)*(1 - m->weight/len))/(len - 1);
+}
+
+/** The population skew \f$\sum_i w_i(x_i-\bar x)^3/n\f$ of the observations in an
+\ref apop_moments tally, with the same conventions as \ref apop_vector_skew_pop. */
+double apop_moments_skew_pop(apop_moments const *m){
+    Apop_stopif(!m || !m->weight, return GSL_NAN, 0, "empty tally. Returning NaN.");
+    return m->m3/moments_len(m);
+}
+
+/** The population fourth central moment \f$\sum_i w_i(x_i-\bar x)^4/n\f$ of the
+observations in an \ref apop_moments tally, with the same conventions as \ref
+apop_vector_kurtosis_pop. */
+double apop_moments_kurtosis_pop(apop_moments const *m){
+    Apop_stopif(!m || !m->weight, return GSL_NAN, 0, "empty tally. Returning NaN.");
+    return m->m4/moments_len(m);
+}
+
+#define Moments_block 4096
+
+static apop_moments moments_run(gsl_vector const *v, gsl_vector const *w, size_t start, size_t end){
+    apop_moments out = {};
+    for (size_t i=start; i< end; i++)
+        apop_moments_add(&out, gsl_vector_get(v, i), w ? gsl_vector_get(w, i) : 1);
+    return out;
+}
+
+/** Tally the first four moments of a vector in one pass.
+
+The vector is cut into blocks, which are tallied in parallel if OpenMP is available
+and then merged via \ref apop_moments_merge.
+
+\param v       The data vector (no default; must not be \c NULL)
+\param weights The weight vector. Default: equal weights for all observations.
+\return        An \ref apop_moments tally. On error, the tally is empty and its mean is NaN.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD apop_moments apop_vector_moments(gsl_vector const *v, gsl_vector const *weights){
+    gsl_vector const * apop_varad_var(v, NULL);
+    gsl_vector const * apop_varad_var(weights, NULL);
+    Apop_stopif(!v, return (apop_moments){.mean=GSL_NAN}, 0, "data vector is NULL. Returning an empty tally.");
+    Apop_stopif(weights && weights->size != v->size, return (apop_moments){.mean=GSL_NAN}, 0,
+            "data vector has size %zu; weighting vector has size %zu. Returning an empty tally.", v->size, weights->size);
+APOP_VAR_ENDHEAD
+    int block_ct = (v->size + Moments_block - 1)/Moments_block;
+    if (block_ct < 2) return moments_run(v, weights, 0, v->size);
+    apop_moments *blocks = malloc(sizeof(apop_moments)*block_ct);
+    OMP_for (int b=0; b< block_ct; b++)
+        blocks[b] = moments_run(v, weights, b*(size_t)Moments_block,
+                                GSL_MIN(v->size, (b+1)*(size_t)Moments_block));
+    apop_moments out = blocks[0];
+    for (int b=1; b< block_ct; b++) out = apop_moments_merge(out, blocks[b]);
+    free(blocks);
+    return out;
+}
+
+/** Tally the first four moments of each column of a matrix in one pass over the data.
+
+The matrix is read a block of rows at a time, so memory is traversed in order; blocks
+are tallied in parallel if OpenMP is available and then merged.
+
+\param m       The data matrix (must not be \c NULL)
+\param weights The weight vector, one weight per row. If \c NULL, equal weights for all rows.
+\return        An array of <tt>m->size2</tt> \ref apop_moments tallies, one per column. You are responsible for <tt>free</tt>ing it.
+               Returns \c NULL on error.
+*/
+apop_moments *apop_matrix_moments(gsl_matrix const *m, gsl_vector const *weights){
+    Apop_stopif(!m, return NULL, 0, "data matrix is NULL. Returning NULL.");
+    Apop_stopif(weights && weights->size != m->size1, return NULL, 0,
+            "data matrix has %zu rows; weighting vector has size %zu. Returning NULL.", m->size1, weights->size);
+    size_t cols = m->size2;
+    int block_ct = GSL_MAX(1, (m->size1 + Moments_block - 1)/Moments_block);
+    apop_moments *blocks = calloc(block_ct*cols, sizeof(apop_moments));
+    OMP_for (int b=0; b< block_ct; b++){
+        apop_moments *these = blocks + b*cols;
+        size_t end = GSL_MIN(m->size1, (b+1)*(size_t)Moments_block);
+        for (size_t i=b*(size_t)Moments_block; i< end; i++){
+            double w = weights ? gsl_vector_get(weights, i) : 1;
+            for (size_t j=0; j< cols; j++)
+                apop_moments_add(these+j, gsl_matrix_get(m, i, j), w);
+        }
     }
-    double len = wsum < 1.1 ? w->size : wsum;
-    return sumcu/len;
+    for (int b=1; b< block_ct; b++)
+        for (size_t j=0; j< cols; j++)
+            blocks[j] = apop_moments_merge(blocks[j], blocks[b*cols+j]);
+    return realloc(blocks, sizeof(apop_moments)*GSL_MAX(cols, 1));
 }
 
 /** Returns the population skew \f$(\sum_i (x_i - \mu)^3/n))\f$ of the data in the given vector. Observations may be weighted.
@@ -90,18 +247,8 @@ APOP_VAR_HEAD double apop_vector_skew_pop(gsl_vector const *v, gsl_vector const
     gsl_vector const * apop_varad_var(weights, NULL);
     Check_vw
 APOP_VAR_ENDHEAD
-    if (weights) return wskewkurt(v, weights, 3, "apop_vector_weighted_skew");
-
-    //This code is cut/pasted/modified from the GSL. 
-    //I reimplement the skew calculation here without the division by var^3/2 that the GSL does. 
-    size_t n = v->size;
-    long double avg = 0;
-    long double mean = apop_vector_mean(v);
-    for (size_t i = 0; i < n; i++) {
-        const long double x = gsl_vector_get(v, i) - mean; 
-        avg += (gsl_pow_3(x) - avg)/(i + 1);
-    } 
-    return avg;
+    apop_moments m = apop_vector_moments(v, weights);
+    return apop_moments_skew_pop(&m);
 }
 
 /** Returns the population fourth central moment [\f$\sum_i (x_i - \mu)^4/n)\f$] of the data in
@@ -122,18 +269,8 @@ APOP_VAR_HEAD double apop_vector_kurtosis_pop(gsl_vector const *v, gsl_vector co
     gsl_vector const * apop_varad_var(weights, NULL);
     Check_vw
 APOP_VAR_ENDHEAD
-    if (weights) return wskewkurt(v, weights, 4, "apop_vector_weighted_kurtosis");
-
-    //This code is cut/pasted/modified from the GSL. 
-    //I reimplement the kurtosis calculation here without the division by var^2 that the GSL does. 
-    size_t n = v->size;
-    long double avg  = 0;
-    long double mean = apop_vector_mean(v);
-    for (size_t i = 0; i < n; i++) {
-        const long double x = gsl_vector_get(v, i) - mean; 
-        avg += (gsl_pow_4(x) - avg)/(i + 1);
-    } 
-    return avg;
+    apop_moments m = apop_vector_moments(v, weights);
+    return apop_moments_kurtosis_pop(&m);
 }
 
 /** Returns the variance of the data in the given vector, given that you've already calculated the mean.
@@ -242,6 +379,130 @@ APOP_VAR_ENDHEAD
   Apop_stopif(1, return NAN, 1, "I couldn't find the metric type you gave, %c, in my list of supported types. Returning NaN", metric);
 }
 
+#define Dist_block 128
+
+//Distance between two rows of d contiguous elements, for the non-Euclidean metrics.
+static double row_distance(double const *x, double const *y, size_t d, char metric, double norm){
+    double dist = 0;
+    switch (metric){
+        case 'm': case 'M':
+            for (size_t k=0; k< d; k++) dist += fabs(x[k] - y[k]);
+            return dist;
+        case 'd': case 'D':
+            for (size_t k=0; k< d; k++) if (x[k] != y[k]) return 1;
+            return 0;
+        case 's': case 'S':
+            for (size_t k=0; k< d; k++) dist = GSL_MAX(dist, fabs(x[k] - y[k]));
+            return dist;
+        default: //'l' or 'L'
+            for (size_t k=0; k< d; k++) dist += pow(fabs(x[k] - y[k]), norm);
+            return pow(dist, 1./norm);
+    }
+}
+
+//Write one distance to the full matrix (mirrored if symmetric) or to the condensed vector.
+static void put_distance(apop_data *out, char condensed, char sym, size_t n, size_t i, size_t j, double dist){
+    if (condensed == 'y'){
+        if (i < j) gsl_vector_set(out->vector, i*n - i*(i+1)/2 + (j-i-1), dist);
+        return;
+    }
+    gsl_matrix_set(out->matrix, i, j, dist);
+    if (sym) gsl_matrix_set(out->matrix, j, i, dist);
+}
+
+/** Find the distance between every row of one data set and every row of another (or
+the same) data set, using any of the metrics of \ref apop_vector_distance.
+
+\param a The data, one observation per row of the matrix. (No default, must not be \c NULL)
+\param b A second data set with the same number of columns. If \c NULL, find all pairwise
+distances among the rows of \c a. (Default: \c NULL)
+\param metric The type of metric: \c 'e', \c 'm', \c 'd', \c 's', or \c 'l', as per \ref apop_vector_distance. (Default: \c 'e')
+\param norm  If you are using an \f$L_p\f$ norm, this is \f$p\f$. Must be strictly greater than zero. (Default: 2)
+\param condensed If \c 'y', and there is no \c b, return only the upper triangle: a
+vector of length \f$n(n-1)/2\f$, where the distance between rows \f$i<j\f$ is element
+\f$in - i(i+1)/2 + j-i-1\f$. (Default: \c 'n')
+
+\return An \ref apop_data set whose matrix has element \f$(i, j)\f$ giving the distance
+between row \f$i\f$ of \c a and row \f$j\f$ of \c b (or \c a), with row and column
+names copied from the row names of the inputs. If condensed, the output has only a
+vector. Returns \c NULL on error.
+
+\li The Euclidean distances are calculated via \f$|x-y|^2 = |x|^2 + |y|^2 - 2x\cdot y\f$,
+with the dot products found a block of rows at a time by one \c dgemm call per block.
+This is much faster than pairwise calculation, but subject to roundoff for points that
+are very close together relative to their distance from the origin; if that is a
+problem, center the data first. Distances from a point to itself are exactly zero.
+\li The other metrics are calculated over tiles of rows, in parallel if OpenMP is available.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD apop_data *apop_data_distance_matrix(apop_data const *a, apop_data const *b, char metric, double norm, char condensed){
+    apop_data const * apop_varad_var(a, NULL);
+    Apop_stopif(!a || !a->matrix, return NULL, 0, "The first data set has no matrix. Returning NULL.");
+    apop_data const * apop_varad_var(b, NULL);
+    Apop_stopif(b && !b->matrix, return NULL, 0, "The second data set has no matrix. Returning NULL.");
+    char apop_varad_var(metric, 'e');
+    double apop_varad_var(norm, 2);
+    char apop_varad_var(condensed, 'n');
+APOP_VAR_ENDHEAD
+    gsl_matrix const *A = a->matrix, *B = b ? b->matrix : a->matrix;
+    char sym = (A == B);
+    Apop_stopif(A->size2 != B->size2, return NULL, 0, "The data sets have %zu and %zu columns, "
+            "but I need the same number of columns in each. Returning NULL.", A->size2, B->size2);
+    Apop_stopif(condensed=='y' && !sym, return NULL, 0, "Condensed output is only for the distances "
+            "within one data set. Returning NULL.");
+    Apop_stopif(!strchr("eEmMdDsSlL", metric) || !metric, return NULL, 0, "I couldn't find the metric type "
+            "you gave, %c, in my list of supported types. Returning NULL.", metric);
+    Apop_stopif((metric=='l' || metric=='L') && !(norm > 0), return NULL, 0, "The norm for an L_p metric "
+            "must be greater than zero, but you gave me %g. Returning NULL.", norm);
+    size_t n = A->size1, m = B->size1, d = A->size2;
+    apop_data *out = condensed=='y' ? apop_data_alloc(n*(n-1)/2) : apop_data_alloc(n, m);
+    if (condensed != 'y'){
+        if (a->names) apop_name_stack(out->names, a->names, 'r');
+        if ((b ? b : a)->names) apop_name_stack(out->names, (b ? b : a)->names, 'c', 'r');
+    }
+    if (metric == 'e' || metric == 'E'){
+        double *norm_a = malloc(sizeof(double)*n), *norm_b = sym ? norm_a : malloc(sizeof(double)*m);
+        for (size_t i=0; i< n; i++){
+            gsl_vector_const_view r = gsl_matrix_const_row(A, i);
+            norm_a[i] = gsl_pow_2(gsl_blas_dnrm2(&r.vector));
+        }
+        if (!sym) for (size_t j=0; j< m; j++){
+            gsl_vector_const_view r = gsl_matrix_const_row(B, j);
+            norm_b[j] = gsl_pow_2(gsl_blas_dnrm2(&r.vector));
+        }
+        gsl_matrix *gram = gsl_matrix_alloc(GSL_MIN(Dist_block, n), m);
+        for (size_t start=0; start< n; start+= Dist_block){
+            size_t len = GSL_MIN(Dist_block, n-start),
+                   jstart = sym ? start : 0; //if symmetric, only the upper triangle
+            gsl_matrix_const_view Ablock = gsl_matrix_const_submatrix(A, start, 0, len, d);
+            gsl_matrix_const_view Bblock = gsl_matrix_const_submatrix(B, jstart, 0, m-jstart, d);
+            gsl_matrix_view g = gsl_matrix_submatrix(gram, 0, 0, len, m-jstart);
+            gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1, &Ablock.matrix, &Bblock.matrix, 0, &g.matrix);
+            OMP_for (int r=0; r< len; r++){
+                size_t i = start + r;
+                for (size_t j= sym ? i : 0; j< m; j++){
+                    double sq = norm_a[i] + norm_b[j] - 2*gsl_matrix_get(&g.matrix, r, j-jstart);
+                    put_distance(out, condensed, sym, n, i, j, (sym && i==j) ? 0 : sqrt(GSL_MAX(sq, 0)));
+                }
+            }
+        }
+        gsl_matrix_free(gram);
+        if (!sym) free(norm_b);
+        free(norm_a);
+        return out;
+    }
+    int block_ct = (n + Dist_block - 1)/Dist_block;
+    OMP_for (int bi=0; bi< block_ct; bi++){
+        size_t i0 = bi*(size_t)Dist_block, i1 = GSL_MIN(n, i0 + Dist_block);
+        for (size_t j0 = sym ? i0 : 0; j0< m; j0+= Dist_block)
+            for (size_t i=i0; i< i1; i++)
+                for (size_t j=GSL_MAX(j0, sym ? i : 0); j< GSL_MIN(m, j0 + Dist_block); j++)
+                    put_distance(out, condensed, sym, n, i, j, (sym && i==j) ? 0
+                            : row_distance(gsl_matrix_const_ptr(A, i, 0), gsl_matrix_const_ptr(B, j, 0), d, metric, norm));
+    }
+    return out;
+}
+
 /** This function will normalize a vector, either such that it has mean
 zero and variance one, or ranges between zero and one, or sums to one.
 
@@ -354,22 +615,20 @@ var *= (data->size1*data->size2)/(data->size1*data->size2-1.0);
 */
 void apop_matrix_mean_and_var(const gsl_matrix *data, double *mean, double *var){
     if (!data) {*mean=0; *var=GSL_NAN; return;}
-    long double avg     = 0,
-                avg2    = 0;
-    size_t cnt= 0;
-    long double x, ratio;
-    for(size_t i=0; i < data->size1; i++)
-        for(size_t j=0; j < data->size2; j++){
-            x     = gsl_matrix_get(data, i,j);
-            ratio = cnt/(cnt+1.0);
-            cnt   ++;
-            avg   *= ratio;
-            avg2  *= ratio;
-            avg   += x/(cnt +0.0);
-            avg2  += gsl_pow_2(x)/(cnt +0.0);
-        }
-	*mean = avg;
-    *var  = avg2 - gsl_pow_2(avg); //E[x^2] - E^2[x]
+    int block_ct = GSL_MAX(1, (data->size1 + Moments_block - 1)/Moments_block);
+    apop_moments *blocks = malloc(sizeof(apop_moments)*block_ct);
+    OMP_for (int b=0; b< block_ct; b++){
+        blocks[b] = (apop_moments){ };
+        size_t end = GSL_MIN(data->size1, (b+1)*(size_t)Moments_block);
+        for (size_t i=b*(size_t)Moments_block; i< end; i++)
+            for (size_t j=0; j < data->size2; j++)
+                apop_moments_add(blocks+b, gsl_matrix_get(data, i, j), 1);
+    }
+    apop_moments all = blocks[0];
+    for (int b=1; b< block_ct; b++) all = apop_moments_merge(all, blocks[b]);
+    free(blocks);
+    *mean = all.mean;
+    *var  = all.weight ? all.m2/all.weight : GSL_NAN;
 }
 
 /** Put summary information about the columns of a table (mean, std dev, variance, min, median, max) in a table.
@@ -378,16 +637,20 @@ void apop_matrix_mean_and_var(const gsl_matrix *data, double *mean, double *var)
 \return     An \ref apop_data structure with one row for each column in the original
             table, and a column for each summary statistic.
 \exception out->error='a'  Allocation error.
+\exception out->error='w'  The weights vector isn't the same length as the matrix. The table is all NaNs.
 
 \li This function gives more columns than you probably want; use \ref apop_data_prune_columns to pick the ones you want to see.
 
+\li The moments and extremes of all columns are gathered in one pass over the data via
+\ref apop_matrix_moments, and the medians are found by selection. If there are weights,
+the mean and variance are weighted; the min, median, and max are not.
+
 \li See apop_data_prune_columns for an example.
 */
 apop_data * apop_data_summarize(apop_data *indata){
     Apop_stopif(!indata, return NULL, 0, "You sent me a NULL apop_data set. Returning NULL.");
     Apop_stopif(!indata->matrix, return NULL, 0, "You sent me an apop_data set with a NULL matrix. Returning NULL.");
     apop_data *out = apop_data_alloc(indata->matrix->size2, 6);
-    double mean, var;
     char rowname[10000]; //crashes on more than 10^9995 columns.
 	apop_name_add(out->names, "mean", 'c');
 	apop_name_add(out->names, "std dev", 'c');
@@ -409,27 +672,137 @@ apop_data * apop_data_summarize(apop_data *indata){
 			sprintf(rowname, "col %zu", i);
 			apop_name_add(out->names, rowname, 'r');
 		}
-	for (size_t i=0; i< indata->matrix->size2; i++){
-        gsl_vector *v = Apop_cv(indata, i);
-        if (!indata->weights){
-            mean = apop_vector_mean(v);
-            var  = apop_vector_var_m(v, mean);
-        } else {
-            mean = apop_vector_mean(v, indata->weights);
-            var  = apop_vector_var(v, indata->weights);
-        } 
-        double *pctiles = apop_vector_percentiles(v);
-		gsl_matrix_set(out->matrix, i, 0, mean);
+    apop_moments *moments = apop_matrix_moments(indata->matrix, indata->weights);
+    Apop_stopif(!moments, gsl_matrix_set_all(out->matrix, GSL_NAN); out->error='w'; return out,
+            0, "Couldn't get the moments of the columns; returning a table of NaNs.");
+    OMP_for (int i=0; i< indata->matrix->size2; i++){
+        double var = apop_moments_var(moments+i);
+        double *median = apop_vector_quantiles(Apop_cv(indata, i));
+		gsl_matrix_set(out->matrix, i, 0, moments[i].mean);
 		gsl_matrix_set(out->matrix, i, 1, sqrt(var));
 		gsl_matrix_set(out->matrix, i, 2, var);
-		gsl_matrix_set(out->matrix, i, 3, pctiles[0]);
-		gsl_matrix_set(out->matrix, i, 4, pctiles[50]);
-		gsl_matrix_set(out->matrix, i, 5, pctiles[100]);
-        free(pctiles);
+		gsl_matrix_set(out->matrix, i, 3, moments[i].min);
+		gsl_matrix_set(out->matrix, i, 4, median ? *median : GSL_NAN);
+		gsl_matrix_set(out->matrix, i, 5, moments[i].max);
+        free(median);
 	}
+    free(moments);
 	return out;
 }
 
+static void swap_d(double *x, size_t i, size_t j){
+    double t = x[i]; x[i] = x[j]; x[j] = t;
+}
+
+static double median_of_three(double a, double b, double c){
+    return a < b ? (b < c ? b : (a < c ? c : a))
+                 : (a < c ? a : (b < c ? c : b));
+}
+
+/* Rearrange x[lo, hi) so that each x[ranks[i]] holds the order statistic of that rank,
+with everything before it no larger and everything after it no smaller. The ranks
+are sorted, unique, and all in [lo, hi).
+
+This is quickselect that recurses into both sides of the pivot when both sides
+have ranks to find; partitioning is three-way, so runs of ties are settled at
+once. If the depth budget runs out (a sign of adversarial data), sort the
+subrange outright. */
+static void multiselect(double *x, size_t lo, size_t hi, size_t const *ranks, size_t rank_ct, int depth){
+    while (rank_ct){
+        if (hi - lo < 16 || !depth){
+            gsl_sort(x+lo, 1, hi-lo);
+            return;
+        }
+        depth--;
+        double pivot = median_of_three(x[lo], x[lo+(hi-lo)/2], x[hi-1]);
+        size_t lt = lo, i = lo, gt = hi;  //[lo,lt) < pivot; [lt,i) == pivot; [gt,hi) > pivot
+        while (i < gt){
+            if      (x[i] < pivot) swap_d(x, lt++, i++);
+            else if (x[i] > pivot) swap_d(x, i, --gt);
+            else    i++;
+        }
+        size_t below = 0, above = rank_ct;
+        while (below < rank_ct && ranks[below] < lt) below++;
+        while (above > below && ranks[above-1] >= gt) above--;
+        //The smaller side gets a recursive call; the larger side is handled by the loop.
+        if (below < rank_ct - above){
+            multiselect(x, lo, lt, ranks, below, depth);
+            ranks += above; rank_ct -= above; lo = gt;
+        } else {
+            multiselect(x, gt, hi, ranks+above, rank_ct-above, depth);
+            rank_ct = below; hi = lt;
+        }
+    }
+}
+
+/** Find the requested quantiles of the data in a vector, using selection rather than
+a full sort: the expected time is linear in the size of the data, plus a log factor for
+each additional quantile requested.
+
+  \param data	A \c gsl_vector with the data. (No default, must not be \c NULL.)
+  \param quantiles A vector of the quantiles you want, each between zero and one. For
+example, <tt>apop_vector_quantiles(v, apop_array_to_vector((double[]){.25, .5, .75}, 3))</tt>. (Default: the median, {0.5})
+  \param rounding Either \c 'u', \c 'd', or \c 'a', as per \ref apop_vector_percentiles. (Default = \c 'd'.)
+  \param inplace If \c 'y', rearrange the elements of \c data as scratch space instead
+of working on a copy. The values in the vector are preserved, but not their order. (Default = \c 'n'.)
+  \return An array of the same size as \c quantiles, where <tt>returned_array[i]</tt>
+is the value at quantile <tt>quantiles->data[i]</tt>. You may eventually want to \c free() it.
+Returns \c NULL on error.
+
+\li The quantile \f$q\f$ of a vector of size \f$n\f$ is the element at position
+\f$q(n-1)\f$ of the sorted vector, with the rounding rule deciding among neighbors when
+that position is not an integer.
+\li This function uses the \ref designated syntax for inputs.
+*/ 
+APOP_VAR_HEAD double * apop_vector_quantiles(gsl_vector *data, gsl_vector const *quantiles, char rounding, char inplace){
+    gsl_vector *apop_varad_var(data, NULL);
+    Apop_stopif(!data, return NULL, 0, "You gave me NULL data.");
+    Apop_stopif(!data->size, return NULL, 0, "You gave me a zero-length data vector.");
+    gsl_vector const *apop_varad_var(quantiles, NULL);
+    char apop_varad_var(rounding, 'd');
+    char apop_varad_var(inplace, 'n');
+APOP_VAR_ENDHEAD
+    double median = .5;
+    gsl_vector_view median_v = gsl_vector_view_array(&median, 1);
+    if (!quantiles) quantiles = &median_v.vector;
+    size_t n = data->size, qct = quantiles->size;
+    for (size_t i=0; i< qct; i++)
+        Apop_stopif(!(gsl_vector_get(quantiles, i) >= 0 && gsl_vector_get(quantiles, i) <= 1),
+                return NULL, 0, "Quantile %zu is %g, which is not between zero and one.", i, gsl_vector_get(quantiles, i));
+    double *x = (inplace=='y' && data->stride==1) ? data->data : malloc(sizeof(double)*n);
+    if (x != data->data) for (size_t i=0; i< n; i++) x[i] = gsl_vector_get(data, i);
+
+    //For each quantile, the rank at or below its position, and whether it falls between ranks.
+    size_t *lower = malloc(sizeof(size_t)*qct), *ranks = malloc(sizeof(size_t)*2*qct), rank_ct = 0;
+    char *between = malloc(qct);
+    for (size_t i=0; i< qct; i++){
+        double pos = gsl_vector_get(quantiles, i)*(n-1), near = round(pos);
+        if (fabs(pos - near) <= 4*GSL_DBL_EPSILON*n) pos = near;  //e.g., .29*100 is 28.999...
+        lower[i] = pos;
+        between[i] = (lower[i] != pos);
+        ranks[rank_ct++] = lower[i];
+        if (between[i] && rounding != 'd') ranks[rank_ct++] = lower[i]+1;
+    }
+    for (size_t i=1; i< rank_ct; i++)  //insertion sort; there are few ranks.
+        for (size_t j=i; j> 0 && ranks[j-1] > ranks[j]; j--){
+            size_t t = ranks[j]; ranks[j] = ranks[j-1]; ranks[j-1] = t;
+        }
+    size_t unique_ct = 0;
+    for (size_t i=0; i< rank_ct; i++)
+        if (!unique_ct || ranks[unique_ct-1] != ranks[i]) ranks[unique_ct++] = ranks[i];
+    int depth = 2*(log2(n)+1);
+    multiselect(x, 0, n, ranks, unique_ct, depth);
+
+    double *out = malloc(sizeof(double)*qct);
+    for (size_t i=0; i< qct; i++)
+        out[i] = !between[i] || rounding == 'd' ? x[lower[i]]
+               : rounding == 'u'                ? x[lower[i]+1]
+                                                : (x[lower[i]] + x[lower[i]+1])/2.;
+    if (x != data->data) free(x);
+    free(lower); free(ranks); free(between);
+    return out;
+}
+
 /** Returns an array of size 101, where \c returned_vector[95] gives the value of the
 95th percentile, for example. \c Returned_vector[100] is always the maximum value,
 and \c returned_vector[0] is always the min (regardless of rounding rule).
@@ -444,6 +817,8 @@ up (use the next highest value); if \c 'd', round down to the next lowest value;
 the sample is below returned_vector[5]"; if \c 'd' or \c 'a', then you can say "5%
 or more of the sample is above returned_vector[5]".
 \li You may eventually want to \c free() the array returned by this function.
+\li This is a wrapper for \ref apop_vector_quantiles; if you only need a few of the
+percentiles, call that function directly.
 \li This function uses the \ref designated syntax for inputs.
 */ 
 APOP_VAR_HEAD double * apop_vector_percentiles(gsl_vector *data, char rounding){
@@ -451,20 +826,248 @@ APOP_VAR_HEAD double * apop_vector_percentiles(gsl_vector *data, char rounding){
     Apop_stopif(!data, return NULL, 0, "You gave me NULL data.");
     char apop_varad_var(rounding, 'd');
 APOP_VAR_ENDHEAD
-    gsl_vector *sorted	= gsl_vector_alloc(data->size);
-    double     *pctiles = malloc(sizeof(double) * 101);
-	gsl_vector_memcpy(sorted,data);
-	gsl_sort_vector(sorted);
-	for(int i=0; i<101; i++){
-		int index = i*(data->size-1)/100.0;
-		if (rounding == 'u' && index != i*(data->size-1)/100.0)
-			index ++; //index was rounded down, but should be rounded up.
-		if (rounding == 'a' && index != i*(data->size-1)/100.0)
-            pctiles[i]	= (gsl_vector_get(sorted, index)+gsl_vector_get(sorted, index+1))/2.;
-        else pctiles[i]	= gsl_vector_get(sorted, index);
-	}
-	gsl_vector_free(sorted);
-	return pctiles;
+    double pcts[101];
+    for (int i=0; i< 101; i++) pcts[i] = i/100.;
+    gsl_vector_view pv = gsl_vector_view_array(pcts, 101);
+    return apop_vector_quantiles(data, &pv.vector, rounding);
+}
+
+//The t-digest's k_1 scale function and its inverse: centroids may span at most one unit of k.
+static double sketch_k(double q, double compression){
+    return compression/(2*M_PI) * asin(2*GSL_MAX(0, GSL_MIN(q, 1)) - 1);
+}
+
+static double sketch_k_inverse(double k, double compression){
+    double x = 2*M_PI*k/compression;
+    return x >= M_PI/2 ? 1 : (sin(x) + 1)/2;
+}
+
+/** Allocate a quantile sketch, a mergeable summary of a stream of data from which
+you can read approximate quantiles, using a fixed amount of memory no matter how much
+data streams in.
+
+\param compression Larger values give more centroids, more memory use, and more
+precise quantiles. The sketch holds on the order of \c compression centroids. Must be
+between one and one million. (Default: 100)
+\return An empty sketch. Free it with \ref apop_quantile_sketch_free. Returns \c NULL
+on a bad \c compression or allocation failure.
+
+\li Add data with \ref apop_quantile_sketch_add, read quantiles with \ref
+apop_quantile_sketch_query. To process data in pieces (e.g., one sketch per thread or per
+file), combine the sketches with \ref apop_quantile_sketch_merge.
+\li Use \ref apop_quantile_sketch_serialize to write the sketch to a block of bytes, to
+be stored and read back in with \ref apop_quantile_sketch_deserialize.
+\li The sketch is a merging t-digest, as per Dunning and Ertl, <em>Computing Extremely
+Accurate Quantiles Using t-Digests</em>. Quantiles near zero and one are more precise
+than those near the median. 
+\li The SQLite aggregators <tt>approx_quantile(x, q)</tt>, <tt>approx_median(x)</tt>,
+<tt>quantile_sketch(x)</tt>, and <tt>quantile_sketch_merge(blob)</tt>, plus the
+function <tt>sketch_quantile(blob, q)</tt>, use these sketches; see \ref db_moments.
+\li This function uses the \ref designated syntax for inputs.
+
+\code
+apop_quantile_sketch *s = apop_quantile_sketch_alloc();
+for (int i=0; i< 1e6; i++) apop_quantile_sketch_add(s, gsl_ran_gaussian(r, 1), 1);
+printf("The 99th percentile is about %g.\n", apop_quantile_sketch_query(s, .99));
+apop_quantile_sketch_free(s);
+\endcode
+*/
+APOP_VAR_HEAD apop_quantile_sketch *apop_quantile_sketch_alloc(double compression){
+    double apop_varad_var(compression, 100);
+    Apop_stopif(!(compression >= 1 && compression <= 1e6), return NULL, 0,
+            "compression must be between one and one million; you gave me %g.", compression);
+APOP_VAR_ENDHEAD
+    apop_quantile_sketch *out = malloc(sizeof(apop_quantile_sketch));
+    Apop_stopif(!out, return NULL, 0, "Allocation error; returning NULL.");
+    size_t size = 8*ceil(compression) + 16; //Room for the centroids plus a buffer of new data.
+    *out = (apop_quantile_sketch){.compression=compression, .min=INFINITY, .max=-INFINITY,
+                .size=size, .means=malloc(sizeof(double)*size), .weights=malloc(sizeof(double)*size)};
+    Apop_stopif(!out->means || !out->weights, apop_quantile_sketch_free(out); return NULL,
+            0, "Allocation error for a sketch of %zu centroids; returning NULL.", size);
+    return out;
+}
+
+/** Free a sketch allocated by \ref apop_quantile_sketch_alloc or \ref apop_quantile_sketch_deserialize. */
+void apop_quantile_sketch_free(apop_quantile_sketch *s){
+    if (!s) return;
+    free(s->means);
+    free(s->weights);
+    free(s);
+}
+
+/* Sort the centroids and buffered data together and sweep through them once, merging
+neighbors whenever the merged centroid would span at most one unit of the scale function. */
+static void sketch_compress(apop_quantile_sketch *s){
+    if (!s->buffer_ct) return;
+    size_t n = s->centroid_ct + s->buffer_ct;
+    size_t *order = malloc(sizeof(size_t)*n);
+    double *m = malloc(sizeof(double)*n), *w = malloc(sizeof(double)*n);
+    gsl_sort_index(order, s->means, 1, n);
+    for (size_t i=0; i< n; i++){
+        m[i] = s->means[order[i]];
+        w[i] = s->weights[order[i]];
+    }
+    double total = s->total_weight, so_far = 0, delta = s->compression;
+    double limit = total * sketch_k_inverse(sketch_k(0, delta) + 1, delta);
+    size_t ct = 0;
+    s->means[0] = m[0];
+    s->weights[0] = w[0];
+    for (size_t i=1; i< n; i++){
+        if (so_far + s->weights[ct] + w[i] <= limit){
+            s->weights[ct] += w[i];
+            s->means[ct] += (m[i] - s->means[ct]) * w[i]/s->weights[ct];
+        } else {
+            so_far += s->weights[ct];
+            limit = total * sketch_k_inverse(sketch_k(so_far/total, delta) + 1, delta);
+            ct++;
+            s->means[ct] = m[i];
+            s->weights[ct] = w[i];
+        }
+    }
+    s->centroid_ct = ct+1;
+    s->buffer_ct = 0;
+    free(order); free(m); free(w);
+    if (s->centroid_ct > s->size/2){ //keep the buffer at least half the allocation.
+        s->size *= 2;
+        s->means = realloc(s->means, sizeof(double)*s->size);
+        s->weights = realloc(s->weights, sizeof(double)*s->size);
+    }
+}
+
+/** Add an observation to a quantile sketch.
+
+\param s      A sketch from \ref apop_quantile_sketch_alloc.
+\param x      The observation. NaNs are ignored.
+\param weight The weight of the observation. Use 1 for unweighted data. Observations
+with nonpositive weight are ignored.
+*/
+void apop_quantile_sketch_add(apop_quantile_sketch *s, double x, double weight){
+    if (isnan(x) || !(weight > 0)) return;
+    if (s->centroid_ct + s->buffer_ct == s->size) sketch_compress(s);
+    size_t posn = s->centroid_ct + s->buffer_ct++;
+    s->means[posn] = x;
+    s->weights[posn] = weight;
+    s->total_weight += weight;
+    if (x < s->min) s->min = x;
+    if (x > s->max) s->max = x;
+}
+
+/** Merge the data summarized in \c addme into \c s. The result summarizes the union of
+the two data sets, as if all of the data had been added to one sketch. \c addme is not
+modified, unless it is \c s itself, in which case every observation now counts twice. */
+void apop_quantile_sketch_merge(apop_quantile_sketch *s, apop_quantile_sketch const *addme){
+    Apop_stopif(!s || !addme, return, 0, "NULL sketch; not merging.");
+    if (s == addme){ //Adding s to itself would read s while it grows and compresses.
+        for (size_t i=0; i< s->centroid_ct + s->buffer_ct; i++) s->weights[i] *= 2;
+        s->total_weight *= 2;
+        return;
+    }
+    for (size_t i=0; i< addme->centroid_ct + addme->buffer_ct; i++)
+        apop_quantile_sketch_add(s, addme->means[i], addme->weights[i]);
+    if (addme->total_weight){
+        s->min = GSL_MIN(s->min, addme->min);
+        s->max = GSL_MAX(s->max, addme->max);
+    }
+}
+
+/** Read an approximate quantile from a sketch.
+
+\param s A sketch with data.
+\param q The quantile, between zero and one; e.g., .5 for the median.
+\return The approximate value of the <tt>q</tt>th quantile, interpolated between
+centroids. Zero and one give the exact min and max. Returns NaN if the sketch is empty
+or \c q is out of range.
+
+\li This compresses any buffered data into the centroids, which is why the sketch is not \c const.
+*/
+double apop_quantile_sketch_query(apop_quantile_sketch *s, double q){
+    Apop_stopif(!s || !s->total_weight, return GSL_NAN, 1, "Empty sketch; returning NaN.");
+    Apop_stopif(!(q >= 0 && q <= 1), return GSL_NAN, 0, "Quantile %g is not between zero and one; returning NaN.", q);
+    sketch_compress(s);
+    if (q == 0) return s->min;
+    if (q == 1) return s->max;
+    size_t n = s->centroid_ct;
+    double *m = s->means, *w = s->weights;
+    double target = q * s->total_weight,
+           left = w[0]/2;  //cumulative weight at the center of centroid i.
+    if (target < left) return s->min + (m[0] - s->min) * target/left;
+    for (size_t i=0; i+1 < n; i++){
+        double right = left + (w[i] + w[i+1])/2;
+        if (target < right) return m[i] + (m[i+1] - m[i]) * (target - left)/(right - left);
+        left = right;
+    }
+    return m[n-1] + (s->max - m[n-1]) * (target - left)/(s->total_weight - left);
+}
+
+/** Write a sketch to a block of bytes, which can be saved to a file, stored in a
+database blob, or sent to another process, and read back in with \ref
+apop_quantile_sketch_deserialize.
+
+\param s       The sketch to write. Buffered data is first merged into the centroids.
+\param byte_ct If not \c NULL, the size of the returned block is written here.
+\return A <tt>malloc</tt>ed block of bytes, which you will want to \c free eventually.
+
+\li The block is a list of \c double s in the machine's native format, so it can be read
+back on a machine with the same floating-point layout.
+*/
+void *apop_quantile_sketch_serialize(apop_quantile_sketch *s, size_t *byte_ct){
+    Apop_stopif(!s, return NULL, 0, "NULL sketch; returning NULL.");
+    sketch_compress(s);
+    size_t n = s->centroid_ct, size = sizeof(double)*(5 + 2*n);
+    double *out = malloc(size);
+    memcpy(out, (double[]){s->compression, s->total_weight, s->min, s->max, n}, sizeof(double)*5);
+    memcpy(out+5, s->means, sizeof(double)*n);
+    memcpy(out+5+n, s->weights, sizeof(double)*n);
+    if (byte_ct) *byte_ct = size;
+    return out;
+}
+
+/** Read a sketch from a block of bytes written by \ref apop_quantile_sketch_serialize.
+
+\param in      The block of bytes. It need not be aligned.
+\param byte_ct The size of the block.
+\return A new sketch, to be freed with \ref apop_quantile_sketch_free. Returns \c NULL if
+the block is not a valid sketch.
+*/
+apop_quantile_sketch *apop_quantile_sketch_deserialize(void const *in, size_t byte_ct){
+    Apop_stopif(!in || byte_ct < sizeof(double)*5, return NULL, 0, "Input too short to be a sketch; returning NULL.");
+    double head[5];
+    memcpy(head, in, sizeof(double)*5);
+    size_t n = (byte_ct/sizeof(double) - 5)/2;
+    Apop_stopif(!(head[0] >= 1 && head[0] <= 1e6) || head[4] != n || byte_ct != sizeof(double)*(5 + 2*n),
+            return NULL, 0, "Input is not a valid sketch; returning NULL.");
+    Apop_stopif(!(head[1] >= 0) || !isfinite(head[1]) || (head[1] > 0) != (n > 0), return NULL, 0,
+            "Input is not a valid sketch: total weight %g with %zu centroids; returning NULL.", head[1], n);
+    Apop_stopif(n && (isnan(head[2]) || isnan(head[3]) || head[2] > head[3]), return NULL, 0,
+            "Input is not a valid sketch: min %g, max %g; returning NULL.", head[2], head[3]);
+    apop_quantile_sketch *out = apop_quantile_sketch_alloc(head[0]);
+    Apop_stopif(!out, return NULL, 0, "Couldn't allocate the sketch; returning NULL.");
+    if (out->size < 2*n){
+        out->size = 2*n;
+        double *m = realloc(out->means, sizeof(double)*out->size),
+               *w = realloc(out->weights, sizeof(double)*out->size);
+        if (m) out->means = m;
+        if (w) out->weights = w;
+        Apop_stopif(!m || !w, apop_quantile_sketch_free(out); return NULL, 0,
+                "Allocation error for a sketch of %zu centroids; returning NULL.", n);
+    }
+    out->total_weight = head[1];
+    out->min = head[2];
+    out->max = head[3];
+    out->centroid_ct = n;
+    memcpy(out->means, (char const*)in + sizeof(double)*5, sizeof(double)*n);
+    memcpy(out->weights, (char const*)in + sizeof(double)*(5+n), sizeof(double)*n);
+    long double wsum = 0;
+    int bad_weight = 0;
+    for (size_t i=0; i< n; i++){
+        bad_weight += !(out->weights[i] > 0) || isnan(out->means[i]);
+        wsum += out->weights[i];
+    }
+    Apop_stopif(bad_weight || fabsl(wsum - out->total_weight) > 1e-9*out->total_weight,
+            apop_quantile_sketch_free(out); return NULL, 0,
+            "Input is not a valid sketch: centroid weights sum to %Lg, but the total weight is %g; "
+            "returning NULL.", wsum, out->total_weight);
+    return out;
 }
 
 /** Find the mean, weighted or unweighted. 
@@ -511,17 +1114,8 @@ APOP_VAR_HEAD double apop_vector_var(gsl_vector const *v, gsl_vector const *weig
     Check_vw
 APOP_VAR_END_HEAD
     if (!weights) return gsl_stats_variance(v->data, v->stride, v->size);
-    //Using the E(x^2) - E^2(x) form.
-    long double sum = 0, wsum = 0, sumsq = 0, vv, ww;
-    for (size_t i=0; i< weights->size; i++){
-        vv = gsl_vector_get(v, i);
-        ww = gsl_vector_get(weights, i);
-        sum   += ww * vv;
-        sumsq += ww * gsl_pow_2(vv); 
-        wsum  += ww; 
-    }
-    double len = (wsum < 1.1 ? weights->size : wsum);
-    return (sumsq/len - gsl_pow_2(sum/len)) * len/(len -1.);
+    apop_moments m = apop_vector_moments(v, weights);
+    return apop_moments_var(&m);
 }
 
 /** Find the sample covariance of a pair of vectors, with an optional weighting. This only
@@ -561,6 +1155,16 @@ APOP_VAR_ENDHEAD
     return (sumsq/len  - sum1*sum2/gsl_pow_2(len)) *(len/(len-1));
 }
 
+#define Cov_block 4096
+
+/* Center the columns once, then accumulate X'X a block of rows at a time (X'WX via
+dgemm if there are weights), so the whole matrix takes two passes over the data rather
+than one per pair of columns.
+
+The weighted form matches apop_vector_cov: its numerator is \f$\sum wxy - S_xS_y/len\f$,
+where \f$len\f$ is the weight sum, or \f$n\f$ if the weights sum to less than 1.1. The
+centered sum gives \f$\sum wxy - S_xS_y/W\f$, so add the difference as a rank-one
+update. */
 /** Returns the sample variance/covariance matrix relating each column of the matrix to each other column.
 
 \param in An \ref apop_data set. If the weights vector is set, I'll take it into account.
@@ -578,15 +1182,57 @@ gsl_matrix_scale(popcov->matrix, size/(size-1.));
 apop_data *apop_data_covariance(const apop_data *in){
     Apop_stopif(!in, return NULL, 1, "You sent me a NULL apop_data set. Returning NULL.");
     Apop_stopif(!in->matrix, return NULL, 1, "You sent me an apop_data set with a NULL matrix. Returning NULL.");
-    apop_data *out = apop_data_alloc(in->matrix->size2, in->matrix->size2);
+    gsl_matrix const *m = in->matrix;
+    gsl_vector const *w = in->weights;
+    size_t n = m->size1, k = m->size2;
+    apop_data *out = apop_data_calloc(k, k);
     Apop_stopif(out->error, return out, 0, "allocation error.");
-    for (size_t i=0; i < in->matrix->size2; i++){
-        for (size_t j=i; j < in->matrix->size2; j++){
-            double var = apop_vector_cov(Apop_cv(in, i), Apop_cv(in, j), in->weights);
-            gsl_matrix_set(out->matrix, i,j, var);
-            if (i!=j) gsl_matrix_set(out->matrix, j,i, var);
+    Apop_stopif(!n || (w && w->size != n), gsl_matrix_set_all(out->matrix, GSL_NAN); return out,
+            0, "data has %zu rows; weighting vector has size %zu. Returning a matrix of NaNs.", n, w ? w->size : n);
+
+    long double *sums = calloc(k, sizeof(long double)), wsum = 0;
+    for (size_t i=0; i< n; i++){
+        double wi = w ? gsl_vector_get(w, i) : 1;
+        const double *row = gsl_matrix_const_ptr(m, i, 0);
+        for (size_t j=0; j< k; j++) sums[j] += wi*row[j];
+        wsum += wi;
+    }
+    gsl_vector *mean = gsl_vector_alloc(k);
+    for (size_t j=0; j< k; j++) gsl_vector_set(mean, j, sums[j]/wsum);
+    free(sums);
+
+    size_t block = GSL_MIN(n, Cov_block);
+    gsl_matrix *centered = gsl_matrix_alloc(block, k);
+    gsl_matrix *weighted = w ? gsl_matrix_alloc(block, k) : NULL;
+    for (size_t start=0; start< n; start+= block){
+        size_t len = GSL_MIN(block, n - start);
+        gsl_matrix_view c = gsl_matrix_submatrix(centered, 0, 0, len, k);
+        gsl_matrix_const_view rows = gsl_matrix_const_submatrix(m, start, 0, len, k);
+        gsl_matrix_memcpy(&c.matrix, &rows.matrix);
+        for (size_t i=0; i< len; i++)
+            gsl_vector_sub(Apop_mrv(&c.matrix, i), mean);
+        if (!w){
+            gsl_blas_dsyrk(CblasLower, CblasTrans, 1, &c.matrix, 1, out->matrix);
+            continue;
         }
+        gsl_matrix_view cw = gsl_matrix_submatrix(weighted, 0, 0, len, k);
+        gsl_matrix_memcpy(&cw.matrix, &c.matrix);
+        for (size_t i=0; i< len; i++)
+            gsl_vector_scale(Apop_mrv(&cw.matrix, i), gsl_vector_get(w, start+i));
+        gsl_blas_dgemm(CblasTrans, CblasNoTrans, 1, &c.matrix, &cw.matrix, 1, out->matrix);
     }
+    double len = (!w || wsum < 1.1) ? n : wsum;
+    if (w && len != wsum)
+        gsl_blas_dsyr(CblasLower, wsum*wsum*(1/wsum - 1/len), mean, out->matrix);
+    for (size_t i=0; i< k; i++)
+        for (size_t j=0; j<= i; j++){
+            double cov = gsl_matrix_get(out->matrix, i, j)/(len-1);
+            gsl_matrix_set(out->matrix, i, j, cov);
+            gsl_matrix_set(out->matrix, j, i, cov);
+        }
+    gsl_matrix_free(centered);
+    if (weighted) gsl_matrix_free(weighted);
+    gsl_vector_free(mean);
     apop_name_stack(out->names, in->names, 'c');
     apop_name_stack(out->names, in->names, 'r', 'c');
     return out;
@@ -598,15 +1244,21 @@ apop_data *apop_data_covariance(const apop_data *in){
 
 \return Returns the square variance/covariance matrix with dimensions equal to the number of input columns.
 \exception out->error='a'  Allocation error.
+
+\li The standard deviations are read from the diagonal of \ref apop_data_covariance's output, so this makes no additional passes over the data.
 */
 apop_data *apop_data_correlation(const apop_data *in){
     apop_data *out = apop_data_covariance(in);
-    if (!out) return NULL;
-    for(size_t i=0; i< in->matrix->size2; i++){
-        double std_dev = sqrt(apop_vector_var(Apop_cv(in, i), in->weights));
-        gsl_vector_scale(Apop_cv(out, i), 1.0/std_dev);
-        gsl_vector_scale(Apop_rv(out, i), 1.0/std_dev);
+    if (!out || out->error) return out;
+    size_t k = out->matrix->size1;
+    gsl_vector *std_dev = gsl_vector_alloc(k);
+    for(size_t i=0; i< k; i++)
+        gsl_vector_set(std_dev, i, sqrt(gsl_matrix_get(out->matrix, i, i)));
+    for(size_t i=0; i< k; i++){
+        gsl_vector_scale(Apop_cv(out, i), 1.0/gsl_vector_get(std_dev, i));
+        gsl_vector_scale(Apop_rv(out, i), 1.0/gsl_vector_get(std_dev, i));
     }
+    gsl_vector_free(std_dev);
     return out;
 }
 
@@ -1193,6 +1193,7 @@ you'll find in the SQLite documentation. See \ref apop_rng_get_thread() to use t
 \li\ref apop_vector_log : take the natural log of every element of a vector
 \li\ref apop_vector_log10 : take the log (base 10) of every element of a vector
 \li\ref apop_vector_distance : find the distance between two vectors via various metrics
+\li\ref apop_data_distance_matrix : find the distances between all pairs of rows
 \li\ref apop_vector_normalize : scale/shift a matrix to have mean zero, sum to one, have a range of exactly \f$[0, 1]\f$, et cetera
 \li\ref apop_vector_entropy : calculate the entropy of a vector of frequencies or probabilities
 
@@ -1227,6 +1228,8 @@ See the GSL documentation for myriad further options.
 \li\ref apop_data_summarize
 \li\ref apop_vector_moving_average
 \li\ref apop_vector_percentiles
+\li\ref apop_vector_quantiles
+\li\ref apop_quantile_sketch_alloc
 \li\ref apop_vector_bounded
 
 See also:
@@ -1270,6 +1273,17 @@ For most of these, you can add a weights vector for weighted mean/var/cov/..., s
 \li\ref apop_vector_var
 \li\ref apop_vector_var_m 
 
+For one-pass or parallel work, an \ref apop_moments tally accumulates the mean and the
+second through fourth central moments, and tallies of disjoint subsets can be merged.
+
+\li\ref apop_moments_add
+\li\ref apop_moments_merge
+\li\ref apop_moments_var
+\li\ref apop_moments_skew_pop
+\li\ref apop_moments_kurtosis_pop
+\li\ref apop_vector_moments
+\li\ref apop_matrix_moments
+
 
 \section convsec   Conversion among types
 
@@ -1528,6 +1542,25 @@ multiply the skew by    \f$(n-1)(n-2)/n^2\f$. The equation for the unbiased samp
 as calculated in <a href="http://modelingwithdata.org/pdfs/moments.pdf">Appendix M of
 <em>Modeling with Data</em></a> is not quite as easy to adjust.
 
+\li Approximate quantiles use a mergeable \ref apop_quantile_sketch, so they work on
+tables too large to pull into memory:
+
+\code
+select approx_median(x), approx_quantile(x, 0.99)
+from table
+group by whatever
+\endcode
+
+<tt>quantile_sketch(x)</tt> returns the sketch itself as a blob, which you can store
+in a table; <tt>quantile_sketch_merge(blob)</tt> aggregates stored sketches into one; and
+<tt>sketch_quantile(blob, q)</tt> reads a quantile from a stored sketch. For example,
+daily sketches can be rolled up into a monthly quantile without revisiting the raw data:
+
+\code
+create table daily as select day, month, quantile_sketch(x) as sk from table group by day;
+select month, sketch_quantile(quantile_sketch_merge(sk), 0.5) from daily group by month;
+\endcode
+
 \li Also provided: wrapper functions for standard math library
 functions---<tt>sqrt(x)</tt>, <tt>pow(x,y)</tt>, <tt>exp(x)</tt>, <tt>log(x)</tt>,
 and trig functions. They call the standard math library function of the same name
@@ -3099,8 +3132,8 @@ that a method will not be re-added by following up the <tt>_drop</tt> with, e.g.
 
 The steps for adding a function to an existing vtable:
 
-\li See \ref apop_update, \ref apop_score, \ref apop_predict, \ref apop_model_print, and \ref
-apop_parameter_model for examples and procedure-specific details.
+\li See \ref apop_update, \ref apop_score, \ref apop_predict, \ref apop_model_print,
+\ref apop_model_draws, and \ref apop_parameter_model for examples and procedure-specific details.
 \li Write a function following the given type definition, as listed in the function's documentation.
 \li Use the associated <tt>_vtable_add</tt> function to add the function and associate it
 with the given model. For example, to add a Beta-binomial routine named \c betabinom
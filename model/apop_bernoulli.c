@@ -10,15 +10,19 @@ Copyright (c) 2007--2009 by Ben Klemens.  Licensed under the GPLv2; see COPYING.
 
 #include "apop_internal.h"
 
-static double bernie_ll(double x, void * pin){ 
-    double *p = pin; 
-    return x ? log(*p) : log(1-*p); 
+//Sufficient statistics: n and the count of nonzero values.
+static void bernoulli_stats(apop_data *d, double *s){
+    long double n = 0, hits = 0;
+    Loop_over_elmts(d, x, n++; hits += (x != 0);)
+    s[0] = n; s[1] = hits;
 }
 
 static long double bernoulli_log_likelihood(apop_data *d, apop_model *params){
     Nullcheck_mpd(d, params, GSL_NAN);
     double p = apop_data_get(params->parameters, 0, -1);
-	return apop_map_sum(d, .fn_dp = bernie_ll, .param=&p);
+    double s[8];
+    suff_stats(d, params, bernoulli_stats, s);
+	return (s[1] ? s[1]*log(p) : 0) + (s[0]-s[1] ? (s[0]-s[1])*log(1-p) : 0);
 }
 
 static double nonzero (double in) { return in !=0; }
@@ -71,6 +75,7 @@ static void bernie_print(apop_model *m, FILE *out){
 
 static void bernie_prep(apop_data *data, apop_model *params){
     apop_model_print_vtable_add(bernie_print, apop_bernoulli);
+    apop_suff_stats_vtable_add(bernoulli_stats, apop_bernoulli);
     apop_model_clear(data, params);
 }
 
@@ -43,10 +43,22 @@ typedef struct{
 } ab_type;
 /** \endcond */ //End of Doxygen ignore.
 
-static double betamap(double x, void *abin) {
-    ab_type *ab = abin; 
-    return (x < 0 || x > 1) ? 0
-                : (ab->alpha-1) * log(x) + (ab->beta-1) *log(1-x); 
+/* Sufficient statistics: n, Σ ln x and Σ ln(1-x) over values in [0, 1], and the same
+two sums over all values. Values outside [0, 1] drop out of the log likelihood, but
+not the score. */
+static void beta_stats(apop_data *d, double *s){
+    long double n = 0, ln_in = 0, ln_1m_in = 0, ln_all = 0, ln_1m_all = 0;
+    Loop_over_elmts(d, x,
+        n++;
+        double ln_x = log(x), ln_1m_x = log(1-x);
+        ln_all += ln_x;
+        ln_1m_all += ln_1m_x;
+        if (!(x < 0 || x > 1)){
+            ln_in += ln_x;
+            ln_1m_in += ln_1m_x;
+        }
+    )
+    s[0] = n; s[1] = ln_in; s[2] = ln_1m_in; s[3] = ln_all; s[4] = ln_1m_all;
 }
 
 #define Get_ab(p) \
@@ -55,23 +67,23 @@ static double betamap(double x, void *abin) {
 
 static long double beta_log_likelihood(apop_data *d, apop_model *p){
     Nullcheck_mpd(d, p, GSL_NAN); 
-    Get_vmsizes(d) //tsize
     Get_ab(p) //ab
     Apop_stopif(isnan(ab.alpha+ab.beta), return GSL_NAN, 0, "NaN α or β input.");
-	return apop_map_sum(d, .fn_dp = betamap, .param=&ab) - gsl_sf_lnbeta(ab.alpha, ab.beta) * tsize;
+    double s[8];
+    suff_stats(d, p, beta_stats, s);
+	return (ab.alpha-1)*s[1] + (ab.beta-1)*s[2] - gsl_sf_lnbeta(ab.alpha, ab.beta) * s[0];
 }
 
-static double dbeta_callback(double x){ return log(1-x); }
-
 static void beta_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *m){
     Nullcheck_mpd(d, m, )
-    Get_vmsizes(d) //tsize
     Get_ab(m) //ab
-    double lnsum = apop_map_sum(d, log);
-    double ln_x_minus_1_sum = apop_map_sum(d, dbeta_callback);
+    double s[8];
+    suff_stats(d, m, beta_stats, s);
+    double lnsum = s[3];
+    double ln_x_minus_1_sum = s[4];
 	//Psi is the derivative of the log gamma function.
-	gsl_vector_set(gradient, 0, lnsum  + (gsl_sf_psi(ab.alpha + ab.beta) - gsl_sf_psi(ab.alpha))*tsize);
-	gsl_vector_set(gradient, 1, ln_x_minus_1_sum  + (gsl_sf_psi(ab.alpha + ab.beta) - gsl_sf_psi(ab.beta))*tsize);
+	gsl_vector_set(gradient, 0, lnsum  + (gsl_sf_psi(ab.alpha + ab.beta) - gsl_sf_psi(ab.alpha))*s[0]);
+	gsl_vector_set(gradient, 1, ln_x_minus_1_sum  + (gsl_sf_psi(ab.alpha + ab.beta) - gsl_sf_psi(ab.beta))*s[0]);
 }
 
 static long double beta_constraint(apop_data *data, apop_model *v){
@@ -100,6 +112,7 @@ static int beta_rng(double *out, gsl_rng *r, apop_model* eps){
 
 static void beta_prep(apop_data *data, apop_model *params){
     apop_score_vtable_add(beta_dlog_likelihood, apop_beta);
+    apop_suff_stats_vtable_add(beta_stats, apop_beta);
     apop_model_clear(data, params);
 }
 
@@ -27,22 +27,31 @@ static long double beta_greater_than_x_constraint(apop_data *data, apop_model *v
     return apop_linear_constraint(v->parameters->vector, .margin = 1e-3);
 }
 
+//Sufficient statistics: n and Σx.
+static void exponential_stats(apop_data *d, double *s){
+    Get_vmsizes(d) //tsize
+    s[0] = tsize;
+    s[1] = (d->matrix ? apop_matrix_sum(d->matrix):0) + (d->vector ? apop_sum(d->vector) : 0);
+}
+
 static long double exponential_log_likelihood(apop_data *d, apop_model *p){
     Nullcheck_mpd(d, p, GSL_NAN);
-    Get_vmsizes(d) //tsize
+    double s[8];
+    suff_stats(d, p, exponential_stats, s);
     double mu = gsl_vector_get(p->parameters->vector, 0);
-    double llikelihood = -((d->matrix ? apop_matrix_sum(d->matrix):0) + (d->vector ? apop_sum(d->vector) : 0))/ mu;
-	llikelihood	-= tsize * log(mu);
+    double llikelihood = -s[1]/ mu;
+	llikelihood	-= s[0] * log(mu);
 	return llikelihood;
 }
 
 static void exponential_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *p){
     Nullcheck_mpd(d, p, );
-    Get_vmsizes(d) //tsize
+    double s[8];
+    suff_stats(d, p, exponential_stats, s);
     double mu = gsl_vector_get(p->parameters->vector, 0);
-    double d_likelihood = (d->matrix ? apop_matrix_sum(d->matrix):0) + (d->vector ? apop_sum(d->vector) : 0);
+    double d_likelihood = s[1];
 	d_likelihood /= gsl_pow_2(mu);
-	d_likelihood -= tsize /mu;
+	d_likelihood -= s[0] /mu;
 	gsl_vector_set(gradient,0, d_likelihood);
 }
 
@@ -70,8 +79,27 @@ static int exponential_rng(double *out, gsl_rng* r, apop_model *p){
     return 0;
 }
 
+//For the EM routine in \ref apop_mixture: per-element log likelihoods and the weighted estimate of one column.
+static void exponential_row_lls(gsl_vector const *x, gsl_vector *out, apop_model *m){
+    double mu = m->parameters->vector->data[0], ln_mu = log(mu);
+    OMP_for (size_t i=0; i< x->size; i++)
+        gsl_vector_set(out, i, -gsl_vector_get(x, i)/mu - ln_mu);
+}
+
+static void exponential_weighted_estimate(gsl_vector const *x, gsl_vector const *w, apop_model *m){
+    long double sw = 0, sx = 0;
+    for (size_t i=0; i< x->size; i++){
+        sw += gsl_vector_get(w, i);
+        sx += gsl_vector_get(w, i) * gsl_vector_get(x, i);
+    }
+    if (sw > 0) m->parameters->vector->data[0] = sx/sw;
+}
+
 static void exponential_prep(apop_data *data, apop_model *params){
     apop_score_vtable_add(exponential_dlog_likelihood, apop_exponential);
+    apop_suff_stats_vtable_add(exponential_stats, apop_exponential);
+    apop_row_lls_vtable_add(exponential_row_lls, apop_exponential);
+    apop_weighted_estimate_vtable_add(exponential_weighted_estimate, apop_exponential);
     apop_model_clear(data, params);
 }
 
@@ -29,40 +29,45 @@ static long double gamma_constraint(apop_data *data, apop_model *v){
 typedef struct {double a, b, ln_ga_plus_a_ln_b;} abstruct;
 /** \endcond */ //End of Doxygen ignore.
 
-static double apply_for_gamma(double x, void *abin) { 
-    abstruct *ab = abin;
-    return x ? ((ab->a-1)*log(x) - x/ab->b - ab->ln_ga_plus_a_ln_b) : 0; 
+/* Sufficient statistics: n, the count of nonzero values, Σx, Σ ln x over the nonzero
+values, and Σ ln x over all values. Zeros drop out of the log likelihood, but not
+the score. */
+static void gamma_stats(apop_data *d, double *s){
+    long double n = 0, nonzero = 0, sum = 0, sum_ln_nz = 0, sum_ln = 0;
+    Loop_over_elmts(d, x,
+        n++;
+        sum += x;
+        sum_ln += log(x);
+        if (x){
+            nonzero++;
+            sum_ln_nz += log(x);
+        }
+    )
+    s[0] = n; s[1] = nonzero; s[2] = sum; s[3] = sum_ln_nz; s[4] = sum_ln;
 }
 
 static long double gamma_log_likelihood(apop_data *d, apop_model *p){
     Nullcheck_mpd(d, p, GSL_NAN) 
-    Get_vmsizes(d)
+    double s[8];
+    suff_stats(d, p, gamma_stats, s);
     abstruct ab = {.a = gsl_vector_get(p->parameters->vector, 0),
                    .b = gsl_vector_get(p->parameters->vector, 1) };
-    double llikelihood  = 0,
-        ln_ga  = gsl_sf_lngamma(ab.a),
+    double ln_ga  = gsl_sf_lngamma(ab.a),
         ln_b   = log(ab.b),
         a_ln_b = ab.a * ln_b;
     ab.ln_ga_plus_a_ln_b = ln_ga + a_ln_b;
-    llikelihood = apop_map_sum(d, .fn_dp = apply_for_gamma, .param = &ab);
-    return llikelihood;
-}
-
-static double a_callback(double x, void *ab){ return log(x)- *(double*)ab; }
-
-static double b_callback(double x, void *abv){ 
-    double *ab = abv;
-    return x/gsl_pow_2(ab[0]) - ab[1]; 
+    return (ab.a-1)*s[3] - s[2]/ab.b - s[1]*ab.ln_ga_plus_a_ln_b;
 }
 
 static void gamma_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *p){
     Nullcheck_mp(p, ) 
+    double s[8];
+    suff_stats(d, p, gamma_stats, s);
     double  a = gsl_vector_get(p->parameters->vector, 0),
         	b = gsl_vector_get(p->parameters->vector, 1);
     double psi_a_ln_b  = gsl_sf_psi(a) + log(b);
-    double b_and_ab[2] = {b, a/b};
-    gsl_vector_set(gradient, 0, apop_map_sum(d, .fn_dp = a_callback, .param=&psi_a_ln_b));
-    gsl_vector_set(gradient, 1, apop_map_sum(d, .fn_dp = b_callback, .param=&b_and_ab));
+    gsl_vector_set(gradient, 0, s[4] - s[0]*psi_a_ln_b);
+    gsl_vector_set(gradient, 1, s[2]/gsl_pow_2(b) - s[0]*a/b);
 }
 
 /* \adoc RNG A wrapper for \c gsl_ran_gamma, which returns a scalar.
@@ -82,8 +87,37 @@ static long double gamma_cdf(apop_data *d, apop_model *params){
     return gsl_cdf_gamma_P(val, alpha, beta);
 }
 
+/* For \ref apop_model_draws: Marsaglia and Tsang's (2000) squeeze method, with the
+   shape-dependent constants calculated once for the block. For alpha<1, draw
+   Gamma(alpha+1) and multiply by U^(1/alpha). */
+static int gamma_draw_many(gsl_matrix *out, gsl_rng *r, apop_model *p){
+    double a = gsl_vector_get(p->parameters->vector, 0);
+    double b = gsl_vector_get(p->parameters->vector, 1);
+    Apop_stopif(!(a > 0 && b > 0), return 1, 0, "Parameters (%g, %g) need to both be positive.", a, b);
+    double boost = a < 1 ? 1/a : 0;
+    double d = (a < 1 ? a + 1 : a) - 1./3;
+    double c = 1/sqrt(9*d);
+    for (size_t i=0; i< out->size1; i++){
+        double x, v, u;
+        do {
+            do {
+                x = gsl_ran_ugaussian(r);
+                v = 1 + c*x;
+            } while (v <= 0);
+            v = v*v*v;
+            u = gsl_rng_uniform_pos(r);
+        } while (u >= 1 - 0.0331*gsl_pow_4(x) && log(u) >= x*x/2 + d*(1 - v + log(v)));
+        double draw = b*d*v;
+        if (boost) draw *= pow(gsl_rng_uniform_pos(r), boost);
+        gsl_matrix_set(out, i, 0, draw);
+    }
+    return 0;
+}
+
 static void gamma_prep(apop_data *data, apop_model *params){
     apop_score_vtable_add(gamma_dlog_likelihood, apop_gamma);
+    apop_suff_stats_vtable_add(gamma_stats, apop_gamma);
+    apop_draw_many_vtable_add(gamma_draw_many, apop_gamma);
     apop_model_clear(data, params);
 }
 
@@ -6,6 +6,16 @@ Copyright (c) 2007, 2010, 2013 by Ben Klemens.  Licensed under the GPLv2; see CO
 
 #include "apop_internal.h"
 #include <gsl/gsl_math.h>
+#include <gsl/gsl_fft_real.h>
+#include <gsl/gsl_fft_halfcomplex.h>
+#ifdef _OPENMP
+    #include <omp.h>
+    #define omp_threadnum omp_get_thread_num()
+    #define omp_threadct omp_get_max_threads()
+#else
+    #define omp_threadnum 0
+    #define omp_threadct 1
+#endif
 
 
 /*\amodel apop_kernel_density The kernel density smoothing of a PMF or histogram.
@@ -43,6 +53,36 @@ static void apop_set_first_param(apop_data *in, apop_model *m){
 
 See the sample code for for a Uniform[0,1] recentered around the first element of the PMF matrix.
 
+\li The log likelihood and CDF are calculated in parallel when OpenMP is available. Each
+thread works with its own copy of the kernel, so the \c set_fn should modify only the
+model it is handed.
+
+\li For large data sets, the \c approximation element of the settings group can replace
+the sum over every point in the base data with something faster:
+
+<tt>'b'</tt>: Bin the base data onto an evenly-spaced grid of \c bin_count points, using
+linear binning, then convolve with the kernel via FFT. Each evaluation is then a lookup
+and an interpolation. Off the grid and far in the tails, I fall back to the exact sum.
+This works for one-dimensional data with an \ref apop_normal kernel, and also speeds up
+the CDF.
+
+<tt>'t'</tt>: Build a kd-tree over the base data, and skip over any part of the tree
+where the kernel varies so little that treating all of its points as one changes the
+total by less than \c tolerance times the density. This works for an \ref apop_normal
+kernel or an \ref apop_multivariate_normal kernel over data in the matrix. The CDF is
+always calculated exactly.
+
+Both assume that the \c set_fn centers the kernel on each data point, as the default
+does (for the Multivariate Normal, you will need your own \c set_fn that copies the whole
+row to the mean), and that the kernel's variance is the same everywhere.
+The grid or tree is built on first use and rebuilt when the kernel's variance or the
+base PMF changes, including changes to the values or weights of the base data made in
+place. To catch those, every call to the log likelihood or CDF hashes the base data
+and weights, which is one pass over the base data. That is small next to the exact sum,
+which makes a pass over the base data for every point evaluated, but it may dominate if
+you evaluate the density one point at a time; in that case, send all of your points in
+one data set where you can.
+
 \adoc Examples
 This example sets up and uses KDEs based on Normal and Uniform distributions.
 
@@ -53,23 +93,80 @@ static void apop_set_first_param(apop_data *in, apop_model *m){
     apop_data_set(m->parameters, .val= apop_data_get(in));
 }
 
+/* The binned and tree approximations. Both work in whitened coordinates, z = L^{-1}x,
+   where LL' is the kernel's covariance, so every kernel is exp(-|z-z_k|^2/2) times
+   a constant. */
+
+typedef struct {
+    size_t start, end;  //this node's points are [start, end) in the reordered x and wts
+    int left, right;    //child nodes, or -1 for a leaf
+    double wt;
+} kd_node;
+
+struct apop_kde_approx {
+    char type;
+    apop_data *base;    //The base data and kernel covariance used to build this.
+    uint64_t data_hash; //If either changes (including in-place edits of the data), I rebuild.
+    gsl_matrix *sigma;
+    int refct;          //The settings group holds one reference; each reader holds another.
+    gsl_matrix *cholesky;
+    double log_norm;    //-log((2 pi)^(d/2) |L|)
+    int dims, bin_count;
+    size_t n;
+    double *x, *wts, total_wt;
+
+    //binned: grid point i is at lo + i*delta, where density[i] = Σ w_k exp(-(z_i-z_k)^2/2)
+    //and cmass[i] is the (unnormalized) mass below z_i.
+    double lo, delta, max_density, *density, *cmass;
+
+    //tree: node i's bounding box runs from bounds[2i*dims] to bounds[(2i+1)*dims].
+    kd_node *nodes;
+    double *bounds;
+    int node_ct;
+};
+
+static void approx_free(struct apop_kde_approx *a){
+    if (!a) return;
+    gsl_matrix_free(a->sigma);
+    gsl_matrix_free(a->cholesky);
+    free(a->x); free(a->wts);
+    free(a->density); free(a->cmass);
+    free(a->nodes); free(a->bounds);
+    free(a);
+}
+
+//Drop one reference; the last one out frees the approximation.
+static void approx_release(struct apop_kde_approx *a){
+    if (!a) return;
+    int last;
+    OMP_critical(kernel_approx)
+    last = !--a->refct;
+    if (last) approx_free(a);
+}
+
 Apop_settings_init(apop_kernel_density, 
     //If there's a PMF associated with the model, run with it.
     //else, generate one from the data.
     Apop_varad_set(base_pmf, apop_estimate(in.base_data, apop_pmf));
     Apop_varad_set(kernel, apop_model_set_parameters(apop_normal, 0, 1));
     Apop_varad_set(set_fn, apop_set_first_param);
+    Apop_varad_set(approximation, 'n');
+    Apop_varad_set(bin_count, 4096);
+    Apop_varad_set(tolerance, 1e-3);
+    out->approx = NULL;
     out->own_pmf = !in.base_pmf;
     out->own_kernel = !in.kernel;
     if (!out->kernel->parameters) apop_prep(out->base_data, out->kernel);
 )
 
 Apop_settings_copy(apop_kernel_density,
+    out->approx = NULL;
     out->own_pmf    =
     out->own_kernel = 0;
 )
 
 Apop_settings_free(apop_kernel_density,
+    approx_release(in->approx);
     if (in->own_pmf)    apop_model_free(in->base_pmf);
     if (in->own_kernel) apop_model_free(in->kernel);
 )
@@ -80,22 +177,380 @@ static void apop_kernel_estimate(apop_data *d, apop_model *m){
         Apop_settings_add_group(m, apop_kernel_density, .base_data=d);
 }
 
+/* The set_fn recenters the kernel by writing to its parameters, so threads can't share
+   a kernel. Instead, each thread gets its own copy for the duration of one call. */
+static apop_model **kernel_copies(apop_model *kernel, int ct){
+    apop_model **out = malloc(sizeof(apop_model*)*ct);
+    for (int i=0; i< ct; i++) out[i] = apop_model_copy(kernel);
+    return out;
+}
+
+static void kernel_copies_free(apop_model **kernels, int ct){
+    for (int i=0; i< ct; i++) apop_model_free(kernels[i]);
+    free(kernels);
+}
+
+//The approximations need a Gaussian kernel; return its dimension, or zero if it isn't one.
+static int gaussian_dims(apop_model *k){
+    if (!k->parameters) return 0;
+    if (k->log_likelihood == apop_normal->log_likelihood) return 1;
+    if (k->log_likelihood == apop_multivariate_normal->log_likelihood && k->parameters->matrix)
+        return k->parameters->matrix->size1;
+    return 0;
+}
+
+static gsl_matrix *kernel_sigma(apop_model *k, int dims){
+    gsl_matrix *out = gsl_matrix_alloc(dims, dims);
+    if (k->log_likelihood == apop_normal->log_likelihood)
+        gsl_matrix_set(out, 0, 0, gsl_pow_2(apop_data_get(k->parameters, 1, -1)));
+    else gsl_matrix_memcpy(out, k->parameters->matrix);
+    return out;
+}
+
+static double coord(apop_data *d, size_t row, int j, int dims){
+    return dims==1 ? apop_data_get(Apop_r(d, row)) : gsl_matrix_get(d->matrix, row, j);
+}
+
+//x <- L^{-1}x, by forward substitution
+static void whiten(gsl_matrix const *L, double *x, int dims){
+    for (int i=0; i< dims; i++){
+        for (int j=0; j< i; j++) x[i] -= gsl_matrix_get(L, i, j) * x[j];
+        x[i] /= gsl_matrix_get(L, i, i);
+    }
+}
+
+static double sq_dist(double const *a, double const *b, int dims){
+    double out = 0;
+    for (int j=0; j< dims; j++) out += gsl_pow_2(a[j] - b[j]);
+    return out;
+}
+
+//Takes ownership of sigma. Copies the base data into whitened coordinates.
+static struct apop_kde_approx *approx_alloc(apop_data *pmf_data, gsl_matrix *sigma, int dims){
+    Get_vmsizes(pmf_data); //maxsize
+    gsl_matrix *L = apop_matrix_copy(sigma);
+    gsl_error_handler_t *prior_handler = gsl_set_error_handler_off();
+    int failed = gsl_linalg_cholesky_decomp(L);
+    gsl_set_error_handler(prior_handler);
+    Apop_stopif(failed, gsl_matrix_free(L); gsl_matrix_free(sigma); return NULL,
+            0, "The kernel's covariance isn't positive definite.");
+
+    struct apop_kde_approx *a = malloc(sizeof(struct apop_kde_approx));
+    *a = (struct apop_kde_approx){.base=pmf_data, .sigma=sigma, .refct=1, .cholesky=L, .dims=dims, .n=maxsize,
+                    .x=malloc(sizeof(double)*maxsize*dims), .wts=malloc(sizeof(double)*maxsize),
+                    .log_norm = -dims*log(2*M_PI)/2};
+    for (int j=0; j< dims; j++) a->log_norm -= log(gsl_matrix_get(L, j, j));
+    for (size_t k=0; k< maxsize; k++){
+        double *xk = a->x + k*dims;
+        for (int j=0; j< dims; j++) xk[j] = coord(pmf_data, k, j, dims);
+        whiten(L, xk, dims);
+        a->wts[k] = pmf_data->weights ? gsl_vector_get(pmf_data->weights, k) : 1;
+        a->total_wt += a->wts[k];
+    }
+    return a;
+}
+
+//log Σ w_k K(z-z_k), summing over every point, in the same manner as kernel_ll.
+static double exact_log_density(struct apop_kde_approx *a, double const *z){
+    double max_ll = -INFINITY, total = 0;
+    for (size_t k=0; k< a->n; k++){
+        double llk = -sq_dist(z, a->x + k*a->dims, a->dims)/2;
+        if (llk > max_ll){
+            total = total * exp(max_ll - llk) + a->wts[k];
+            max_ll = llk;
+        } else total += a->wts[k] * exp(llk - max_ll);
+    }
+    return max_ll == -INFINITY ? -INFINITY : max_ll + log(total) + a->log_norm;
+}
+
+/* Linear binning onto an evenly-spaced grid extending six kernel widths beyond the data,
+   then a convolution with the kernel via FFT. The FFT is circular, so the arrays are
+   zero-padded to at least twice the grid size to keep the tails from wrapping around. */
+static struct apop_kde_approx *binned_build(apop_data *pmf_data, gsl_matrix *sigma, int bins){
+    Apop_stopif(bins < 2, gsl_matrix_free(sigma); return NULL, 0, "bin_count is %i; I need at least two bins.", bins);
+    struct apop_kde_approx *a = approx_alloc(pmf_data, sigma, 1);
+    if (!a) return NULL;
+    a->type = 'b';
+    a->bin_count = bins;
+    double min = INFINITY, max = -INFINITY;
+    for (size_t k=0; k< a->n; k++){
+        min = GSL_MIN(min, a->x[k]);
+        max = GSL_MAX(max, a->x[k]);
+    }
+    a->lo = min - 6;
+    a->delta = (max + 6 - a->lo)/(bins-1);
+
+    size_t padded = 2;
+    while (padded < 2*bins) padded *= 2;
+    double *binned = calloc(padded, sizeof(double));
+    double *kern = calloc(padded, sizeof(double));
+    for (size_t k=0; k< a->n; k++){
+        double pos = (a->x[k] - a->lo)/a->delta;
+        int j = GSL_MIN((int)pos, bins-2);
+        binned[j]   += a->wts[k] * (1 - (pos-j));
+        binned[j+1] += a->wts[k] * (pos-j);
+    }
+    for (int l=0; l< bins; l++)
+        kern[l] = kern[(padded-l)%padded] = exp(-gsl_pow_2(l*a->delta)/2);
+    gsl_fft_real_radix2_transform(binned, 1, padded);
+    gsl_fft_real_radix2_transform(kern, 1, padded);
+
+    //Multiply, in half-complex format: element i is (data[i], data[n-i]); 0 and n/2 are real.
+    binned[0] *= kern[0];
+    binned[padded/2] *= kern[padded/2];
+    for (size_t i=1; i< padded/2; i++){
+        double re = binned[i]*kern[i] - binned[padded-i]*kern[padded-i];
+        binned[padded-i] = binned[i]*kern[padded-i] + binned[padded-i]*kern[i];
+        binned[i] = re;
+    }
+    gsl_fft_halfcomplex_radix2_inverse(binned, 1, padded);
+
+    a->density = malloc(sizeof(double)*bins);
+    a->cmass = malloc(sizeof(double)*bins);
+    for (int i=0; i< bins; i++){
+        a->density[i] = GSL_MAX(binned[i], 0); //round-off in the far tails can go negative.
+        a->max_density = GSL_MAX(a->max_density, a->density[i]);
+    }
+    a->cmass[0] = 0;
+    for (size_t k=0; k< a->n; k++) a->cmass[0] += a->wts[k] * gsl_cdf_gaussian_P(a->lo - a->x[k], 1);
+    for (int i=1; i< bins; i++)
+        a->cmass[i] = a->cmass[i-1] + (a->density[i-1] + a->density[i]) * a->delta/2 /sqrt(2*M_PI);
+    free(binned); free(kern);
+    return a;
+}
+
+//Interpolate from the grid; for points off the grid or far in the tails, where the
+//relative error of the grid is large, sum exactly.
+static double binned_log_density(struct apop_kde_approx *a, double z){
+    double pos = (z - a->lo)/a->delta;
+    if (pos >= 0 && pos <= a->bin_count-1){
+        int j = GSL_MIN((int)pos, a->bin_count-2);
+        double g = a->density[j] * (1 - (pos-j)) + a->density[j+1] * (pos-j);
+        if (g > 1e-10 * a->max_density) return log(g) + a->log_norm;
+    }
+    return exact_log_density(a, &z);
+}
+
+static double binned_cdf(struct apop_kde_approx *a, double z){
+    double pos = (z - a->lo)/a->delta;
+    if (pos >= 0 && pos <= a->bin_count-1){
+        int j = GSL_MIN((int)pos, a->bin_count-2);
+        double frac = pos - j;
+        double g = a->density[j] + frac * (a->density[j+1] - a->density[j]);
+        return (a->cmass[j] + frac*a->delta*(a->density[j] + g)/2 /sqrt(2*M_PI)) / a->total_wt;
+    }
+    long double total = 0;
+    for (size_t k=0; k< a->n; k++) total += a->wts[k] * gsl_cdf_gaussian_P(z - a->x[k], 1);
+    return total / a->total_wt;
+}
+
+#define Kde_leaf_size 32
+
+static void swap_points(struct apop_kde_approx *a, size_t i, size_t j){
+    for (int d=0; d< a->dims; d++){
+        double t = a->x[i*a->dims+d];
+        a->x[i*a->dims+d] = a->x[j*a->dims+d];
+        a->x[j*a->dims+d] = t;
+    }
+    double t = a->wts[i];
+    a->wts[i] = a->wts[j];
+    a->wts[j] = t;
+}
+
+/* Reorder points [start, end) so that the nth is in sorted position along dimension dim,
+   with no larger values before it and no smaller values after. The partition is
+   three-way, so heavily tied data doesn't go quadratic. */
+static void select_nth(struct apop_kde_approx *a, size_t start, size_t end, size_t nth, int dim){
+    #define X(i) a->x[(i)*a->dims + dim]
+    while (end - start > 1){
+        double pivot = X((start+end)/2);
+        size_t lt = start, i = start, gt = end;
+        while (i < gt){
+            if (X(i) < pivot)      swap_points(a, lt++, i++);
+            else if (X(i) > pivot) swap_points(a, i, --gt);
+            else                   i++;
+        }
+        if (nth < lt)       end = lt;
+        else if (nth >= gt) start = gt;
+        else return;
+    }
+    #undef X
+}
+
+static int tree_build_node(struct apop_kde_approx *a, size_t start, size_t end){
+    int dims = a->dims, id = a->node_ct++;
+    double *lo = a->bounds + 2*id*dims, *hi = lo + dims;
+    a->nodes[id] = (kd_node){.start=start, .end=end, .left=-1, .right=-1};
+    for (int j=0; j< dims; j++){
+        lo[j] = INFINITY;
+        hi[j] = -INFINITY;
+    }
+    for (size_t k=start; k< end; k++){
+        for (int j=0; j< dims; j++){
+            lo[j] = GSL_MIN(lo[j], a->x[k*dims+j]);
+            hi[j] = GSL_MAX(hi[j], a->x[k*dims+j]);
+        }
+        a->nodes[id].wt += a->wts[k];
+    }
+    if (end - start <= Kde_leaf_size) return id;
+    int split = 0;
+    for (int j=1; j< dims; j++) if (hi[j]-lo[j] > hi[split]-lo[split]) split = j;
+    if (hi[split] == lo[split]) return id; //all points identical.
+    size_t mid = (start+end)/2;
+    select_nth(a, start, end, mid, split);
+    int left = tree_build_node(a, start, mid);
+    a->nodes[id].left = left;
+    int right = tree_build_node(a, mid, end);
+    a->nodes[id].right = right;
+    return id;
+}
+
+static struct apop_kde_approx *tree_build(apop_data *pmf_data, gsl_matrix *sigma, int dims){
+    struct apop_kde_approx *a = approx_alloc(pmf_data, sigma, dims);
+    if (!a) return NULL;
+    a->type = 't';
+    //Median splits put at least Kde_leaf_size/2 points in every leaf but those holding
+    //identical points, which hold more, so this many nodes is enough.
+    size_t max_nodes = 2*(a->n/(Kde_leaf_size/2)) + 1;
+    a->nodes = malloc(sizeof(kd_node)*max_nodes);
+    a->bounds = malloc(sizeof(double)*2*dims*max_nodes);
+    if (a->n) tree_build_node(a, 0, a->n);
+    return a;
+}
+
+typedef struct {
+    int node;
+    double kmin, kmax; //bounds on the kernel over the node's bounding box
+} kd_pending;
+
+static kd_pending node_bounds(struct apop_kde_approx *a, int node, double const *z){
+    double const *lo = a->bounds + 2*node*a->dims, *hi = lo + a->dims;
+    double near = 0, far = 0;
+    for (int j=0; j< a->dims; j++){
+        double dl = z[j] - lo[j], dh = z[j] - hi[j];
+        if (dl < 0)      near += dl*dl;
+        else if (dh > 0) near += dh*dh;
+        far += GSL_MAX(dl*dl, dh*dh);
+    }
+    return (kd_pending){.node=node, .kmin=exp(-far/2), .kmax=exp(-near/2)};
+}
+
+/* Depth-first, nearer child first, keeping a lower bound on the full sum. A node whose
+   kernel values span at most 2 tol (lower bound)/(total weight) is replaced by its
+   weight times the midpoint of its span, so the error across all pruned nodes is at
+   most tol times the true sum. */
+static double tree_log_density(struct apop_kde_approx *a, double const *z, double tol){
+    if (!a->n) return -INFINITY;
+    kd_pending stack[128]; //one entry per level of the tree, plus one; the tree is O(log n) deep.
+    int depth = 0;
+    stack[depth++] = node_bounds(a, 0, z);
+    double est = 0, lower = a->nodes[0].wt * stack[0].kmin;
+    while (depth){
+        kd_pending p = stack[--depth];
+        kd_node *nd = a->nodes + p.node;
+        lower -= nd->wt * p.kmin;
+        if (!nd->wt || p.kmax - p.kmin <= 2*tol*lower/a->total_wt){
+            est   += nd->wt * (p.kmax + p.kmin)/2;
+            lower += nd->wt * p.kmin;
+        } else if (nd->left < 0){
+            double s = 0;
+            for (size_t k=nd->start; k< nd->end; k++)
+                s += a->wts[k] * exp(-sq_dist(z, a->x + k*a->dims, a->dims)/2);
+            est   += s;
+            lower += s;
+        } else {
+            kd_pending l = node_bounds(a, nd->left, z), r = node_bounds(a, nd->right, z);
+            lower += a->nodes[nd->left].wt * l.kmin + a->nodes[nd->right].wt * r.kmin;
+            stack[depth++] = (l.kmax < r.kmax) ? l : r;
+            stack[depth++] = (l.kmax < r.kmax) ? r : l;
+        }
+    }
+    //If everything underflowed, the log-scale exact sum can still give an answer.
+    return est > 0 ? log(est) + a->log_norm : exact_log_density(a, z);
+}
+
+/* Weights count as part of the data: the approximations are built from them. This is a
+   pass over the base data on every call; see the note on cost in the documentation above. */
+static uint64_t base_hash(apop_data const *pmf_data){
+    return params_hash(pmf_data) ^ 31*params_hash(&(apop_data){.vector=pmf_data->weights});
+}
+
+/* Returns the current approximation for the kernel and base data, rebuilding if either
+   has changed, or NULL if the exact calculation should be used. The caller holds a
+   reference to the returned approximation, and must give it back via approx_release;
+   if another thread rebuilds in the mean time, the old one lives until released. */
+static struct apop_kde_approx *get_approx(apop_kernel_density_settings *ks, apop_data *pmf_data){
+    if (ks->approximation != 'b' && ks->approximation != 't') return NULL;
+    int dims = gaussian_dims(ks->kernel);
+    Apop_stopif(!dims || (ks->approximation=='b' && dims != 1), return NULL, 1,
+            "The '%c' approximation needs a %s kernel. Using the exact calculation.",
+            ks->approximation, ks->approximation=='b' ? "one-dimensional Normal" : "Normal or Multivariate Normal");
+    Apop_stopif(dims > 1 && (!pmf_data->matrix || pmf_data->matrix->size2 < dims), return NULL, 1,
+            "The kernel has %i dimensions, but the base data has fewer matrix columns. "
+            "Using the exact calculation.", dims);
+    Get_vmsizes(pmf_data); //maxsize
+    uint64_t hash = base_hash(pmf_data);
+    struct apop_kde_approx *out, *retired = NULL;
+    OMP_critical(kernel_approx)
+    {
+    gsl_matrix *sigma = kernel_sigma(ks->kernel, dims);
+    struct apop_kde_approx *a = ks->approx;
+    if (!a || a->type != ks->approximation || a->base != pmf_data || a->n != maxsize
+           || a->data_hash != hash
+           || a->dims != dims || (a->type=='b' && a->bin_count != ks->bin_count)
+           || memcmp(a->sigma->data, sigma->data, sizeof(double)*dims*dims)){
+        if (a && !--a->refct) retired = a;
+        ks->approx = (ks->approximation=='b') ? binned_build(pmf_data, sigma, ks->bin_count)
+                                              : tree_build(pmf_data, sigma, dims);
+        if (ks->approx) ks->approx->data_hash = hash;
+    } else gsl_matrix_free(sigma);
+    out = ks->approx;
+    if (out) out->refct++;
+    }
+    approx_free(retired);
+    return out;
+}
+
+static long double approx_ll(apop_data *d, struct apop_kde_approx *a, double tol){
+    Get_vmsizes(d); //maxsize
+    int dims = a->dims;
+    Apop_stopif(dims > 1 && (!d->matrix || d->matrix->size2 < dims), return GSL_NAN, 0,
+            "The kernel has %i dimensions, but the data has fewer matrix columns.", dims);
+    long double ll = 0;
+    OMP_for_reduce(+:ll,    int i=0; i< maxsize; i++){
+        double z[dims];
+        for (int j=0; j< dims; j++) z[j] = coord(d, i, j, dims);
+        whiten(a->cholesky, z, dims);
+        ll += (a->type == 'b') ? binned_log_density(a, *z) : tree_log_density(a, z, tol);
+    }
+    return ll - maxsize * log(a->total_wt);
+}
+
 /* \adoc    CDF Sums the CDF to the given point of all the sub-distributions.*/
 static long double kernel_cdf(apop_data *d, apop_model *m){
     Nullcheck_m(m, GSL_NAN);
     long double total = 0;
     apop_kernel_density_settings *ks = apop_settings_get_group(m, apop_kernel_density);
     apop_data *pmf_data = apop_settings_get(m, apop_kernel_density, base_pmf)->data;
+    struct apop_kde_approx *a = ks->approximation=='b' ? get_approx(ks, pmf_data) : NULL;
+    if (a){
+        double z = apop_data_get(d);
+        whiten(a->cholesky, &z, 1);
+        double out = binned_cdf(a, z);
+        approx_release(a);
+        return out;
+    }
     Get_vmsizes(pmf_data); //maxsize
-    for (size_t k = 0; k < maxsize; k++){
+    int thread_ct = omp_threadct;
+    apop_model **kernels = kernel_copies(ks->kernel, thread_ct);
+    OMP_for_reduce(+:total, int k = 0; k < maxsize; k++){
+        apop_model *kernel = kernels[omp_threadnum];
         apop_data *r = Apop_r(pmf_data, k);
         double wt = r->weights ? *r->weights->data : 1;
-        OMP_critical(kernel_p_cdf)
-        {
-        (ks->set_fn)(r, ks->kernel);
-        total += apop_cdf(d, ks->kernel)*wt;
-        }
+        (ks->set_fn)(r, kernel);
+        total += apop_cdf(d, kernel)*wt;
     }
+    kernel_copies_free(kernels, thread_ct);
     long double weight = pmf_data->weights ? apop_sum(pmf_data->weights) : maxsize;
     total /= weight;
     return total;
@@ -107,33 +562,41 @@ static long double kernel_ll(apop_data *d, apop_model *m){
     {Get_vmsizes(d); datasize=maxsize;}
     apop_kernel_density_settings *ks = apop_settings_get_group(m, apop_kernel_density);
     apop_data *pmf_data = apop_settings_get(m, apop_kernel_density, base_pmf)->data;
+    struct apop_kde_approx *a = get_approx(ks, pmf_data);
+    if (a){
+        long double ll = approx_ll(d, a, ks->tolerance);
+        approx_release(a);
+        return ll;
+    }
     Get_vmsizes(pmf_data); //maxsize
+    int thread_ct = omp_threadct;
+    apop_model **kernels = kernel_copies(ks->kernel, thread_ct);
     long double ll = 0;
     OMP_for_reduce(+:ll,    int i=0; i< datasize; i++){
-        long double lls[maxsize];
+        apop_model *kernel = kernels[omp_threadnum];
         apop_data *datapt = Apop_r(d, i);
-        for(int k=0; k< maxsize; k++){
-            apop_data *r = Apop_r(pmf_data, k);
-            OMP_critical(kernel_p_cdf)
-            {
-            (ks->set_fn)(r, ks->kernel);
-            lls[k] = apop_log_likelihood(datapt, ks->kernel);
-            }
-        }
 
         //let p_m w_m be the largest value among the p_i w_is. Then
         //log (Σp_i w_i) = log(p_m w_m) + log(Σ(p_i w_i/p_m w_m).
-        //This gives us a little more numeric accuracy.
+        //This gives us a little more numeric accuracy. The max is found as we go, 
+        //rescaling the running total whenever a new max appears.
         double max_ll = -INFINITY;
         double total = 0;
-        #define getwt(i) (pmf_data->weights ? gsl_vector_get(pmf_data->weights, i) : 1);
-        for (int i=0; i< maxsize; i++) if (lls[i]>max_ll) max_ll = lls[i];
+        for(int k=0; k< maxsize; k++){
+            apop_data *r = Apop_r(pmf_data, k);
+            (ks->set_fn)(r, kernel);
+            double llk = apop_log_likelihood(datapt, kernel);
+            double wt = pmf_data->weights ? gsl_vector_get(pmf_data->weights, k) : 1;
+            if (llk == -INFINITY) continue;
+            if (llk > max_ll){
+                total = total * exp(max_ll - llk) + wt;
+                max_ll = llk;
+            } else total += wt * exp(llk - max_ll); //NaNs land here, and propagate.
+        }
         if (max_ll==-INFINITY) {ll=-INFINITY; continue;}
-        for (int i=0; i< maxsize; i++) lls[i]-=max_ll;
-        for (int i=0; i< maxsize; i++) lls[i]= exp(lls[i]) * getwt(i);
-        for (int i=0; i< maxsize; i++) total += lls[i];
         ll += max_ll + log(total);
     }
+    kernel_copies_free(kernels, thread_ct);
     ll -= datasize * log(pmf_data->weights ? apop_sum(pmf_data->weights) : maxsize);
     return ll;
 }
@@ -146,11 +609,17 @@ static int kernel_draw(double *d, gsl_rng *r, apop_model *m){
     apop_kernel_density_settings *ks = apop_settings_get_group(m, apop_kernel_density);
     apop_model *pmf = apop_settings_get(m, apop_kernel_density, base_pmf);
     apop_data *point = apop_data_alloc(1, pmf->dsize);
-    Apop_stopif(apop_draw(Apop_rv(point, 0)->data, r, pmf), return 1, 0, "Unable to use the PMF over kernels to select a kernel from which to draw.");
+    Apop_stopif(apop_draw(Apop_rv(point, 0)->data, r, pmf), apop_data_free(point); return 1,
+            0, "Unable to use the PMF over kernels to select a kernel from which to draw.");
+    int failed;
+    OMP_critical(kernel_draw) //the set_fn modifies the shared kernel.
+    {
     (ks->set_fn)(point, ks->kernel);
     //Now draw from the distribution around that point.
-    Apop_stopif(apop_draw(d, r, ks->kernel), return 2, 0, "unable to draw from a single selected kernel.");
+    failed = apop_draw(d, r, ks->kernel);
+    }
     apop_data_free(point);
+    Apop_stopif(failed, return 2, 0, "unable to draw from a single selected kernel.");
     return 0;
 }
 
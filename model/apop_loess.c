@@ -13,8 +13,8 @@ Provenance:
             Those BK edits made during time working as a gov't
             employee are public domain.
 
-    By the way, search the code for execnt: many functions will let you
-    query how many times they have been hit, which you might find to be useful.
+    All of the working state is allocated per call (see loess_work), so separate fits
+    and predictions can run in separate threads.
 
 \amodel apop_loess Regression via loess smoothing
 
@@ -49,6 +49,10 @@ In any case, all data is copied into the model's \ref apop_loess_settings. The c
 is primarily FORTRAN code from 1988 converted to C; the data thus has to be converted
 into a relatively obsolete internal format.
 
+The working space for each fit or prediction is allocated for that call, so you can
+estimate or predict with several loess models at once in separate threads (e.g., for a
+bootstrap). Predictions don't modify the estimated model.
+
 
 \adoc    Parameter_format  Unused. 
 \adoc    estimated_parameters None.  
@@ -63,6 +67,14 @@ columns, which is amenable to plotting.  Try:
 Fills in the zeroth column (ignoring and overwriting any data there), and adds an additional page to the input \ref
 apop_data set named "<Confidence>" with a lower and upper CI for each point.
 
+With the default interpolated surface, each new point is evaluated from the kd tree and
+vertex values stored in the settings; with OpenMP, the points are split across threads.
+If the model was fit with <tt>.lo_s.control.surface="direct"</tt>, each point gets its
+own local regression, which is slow for many points. Set
+<tt>.interpolate_predictions='y'</tt> to build the tree and vertex values once and
+interpolate from them instead. As with the interpolated surface, new points
+should lie within the range of the data.
+
 \adoc    settings \ref apop_loess_settings */
 
 #include "apop_internal.h"
@@ -85,7 +97,6 @@ static integer c__1 = 1;
 static integer c__15 = 15;
 static integer c__2 = 2;
 static integer c__21 = 21;
-double doublepluszero = 0;
 
 //I'm using the GSL's blas system. These are pass-through functions that
 //save me the trouble of slogging through the code and making substitutions.
@@ -233,10 +244,10 @@ static void dqrsl_(double *x, integer *ldx, integer *n, integer * k, double *qra
         double *qy, double *qty, double *b, double *rsd, double *xb, integer job, integer *info) {
 
     integer x_dim1, i__1, i__2;
-    static integer i__, j;
-    static double t, temp;
-    static integer jj, ju, kp1;
-    static logical cb, cr, cxb, cqy, cqty;
+    integer i__, j;
+    double t, temp;
+    integer jj, ju, kp1;
+    logical cb, cr, cxb, cqy, cqty;
 
     x_dim1 = *ldx;
     x -= 1 + x_dim1;
@@ -453,11 +464,11 @@ static void dsvdc_(double *x, integer *ldx, integer *n, integer * p, double *s,
         double *v, integer *ldv, double *work, integer *job, integer * info) {
     integer x_dim1, u_dim1, v_dim1, i__2, i__3;
     double d__1;
-    static double b, c__, f, g, t, t1, el, cs, sl, sm, sn, acc, emm1, smm1;
-    static double test, scale, shift, ztest;
-    static integer i__, j, k, l, m, kk, ll, mm, ls, lu, lm1, mm1, lp1, mp1, nct, ncu, lls, nrt;
-    static integer kase, jobu, iter, nctp1, nrtp1, maxit;
-    static logical wantu, wantv;
+    double b, c__, f, g, t, t1, el, cs, sl, sm, sn, acc, emm1, smm1;
+    double test, scale, shift, ztest;
+    integer i__, j, k, l, m, kk, ll, mm, ls, lu, lm1, mm1, lp1, mp1, nct, ncu, lls, nrt;
+    integer kase, jobu, iter, nctp1, nrtp1, maxit;
+    logical wantu, wantv;
 
     x_dim1 = *ldx;
     x -= 1 + x_dim1;
@@ -828,8 +839,13 @@ L610:
 #define	GAUSSIAN	1
 #define SYMMETRIC	0
 
-static long	*iv, liv, lv, tau;
-static double *v;
+/* The FORTRAN routines keep their state in the iv and v arrays. Each fit or prediction
+   allocates its own set, so separate fits can run in separate threads. */
+typedef struct {
+    long *iv, liv, lv, tau;
+    double *v;
+    double zero; //some routines want a pointer to a zero
+} loess_work;
 
 /* begin ehg's FORTRAN-callable C-codes */
 
@@ -910,17 +926,15 @@ static integer ifloor(double x) {
 
 static void ehg126_(integer *d__, integer *n, integer *vc, double *x, double *v, integer *nvmax) {
     integer v_dim1, x_dim1;
-    static integer execnt = 0, i__, j, k;
-    static double t, mu, beta, alpha, machin;
+    integer i__, j, k;
+    double t, mu, beta, alpha, machin;
 
     x_dim1 = *n;
     x -= 1 + x_dim1;
     v_dim1 = *nvmax;
     v -= 1 + v_dim1;
 
-    ++execnt;
-    if (execnt == 1)
-        machin = DBL_MAX;
+    machin = DBL_MAX;
 /*     fill in vertices for bounding box of $x$ */
 /*     lower left, upper right */
     for (k = 1; k <= *d__; ++k) {
@@ -953,8 +967,8 @@ static void ehg125_(integer *p, integer *nv, double *v, integer *vhit, integer n
        integer k, double *t, integer *r__, integer *s, integer *f, integer *l, integer *u) {
 
     integer f_dim1, l_dim1, u_dim1, v_dim1;
-    static integer h__, i__, j, m, i3, mm, execnt = 0;
-    static logical match;
+    integer h__, i__, j, m, i3, mm;
+    logical match;
 
     --vhit;
     v_dim1 = nvmax;
@@ -966,7 +980,6 @@ static void ehg125_(integer *p, integer *nv, double *v, integer *vhit, integer n
     f_dim1 = *r__;
     f -= 1 + (f_dim1 << 1);
 
-    ++execnt;
     h__ = *nv;
     for (i__ = 1; i__ <= *r__; ++i__)
         for (j = 1; j <= *s; ++j) {
@@ -1004,14 +1017,13 @@ static void ehg125_(integer *p, integer *nv, double *v, integer *vhit, integer n
 static void find_kth_smallest(integer il, integer ir, integer k, integer nk, double *p, integer *pi) {
     //Formerly ehg106
     integer p_dim1;
-    static integer execnt = 0, i__, j, l, r, ii;
-    static double t;
+    integer i__, j, l, r, ii;
+    double t;
 
     --pi;
     p_dim1 = nk;
     p -= 1 + p_dim1;
 
-    ++execnt;
     /*     find the $k$-th smallest of $n$ elements */
     /*     Floyd+Rivest, CACM Mar '75, Algorithm 489 */
     l = il;
@@ -1062,8 +1074,8 @@ static integer idamax(integer n, double *dx, integer incx) {
     /*     Finds the index of element having max. absolute value. */
     /*     jack dongarra, linpack, 3/11/78. */
     int ret_val = 1;
-    static integer i__, ix;
-    static double dmax__;
+    integer i__, ix;
+    double dmax__;
     --dx;
 
     if (n < 1)
@@ -1095,9 +1107,9 @@ static void ehg124_(integer *ll, integer *uu, integer d__, integer n, integer *n
         integer *lo, integer *hi, integer *c__, double *v, integer *vhit, integer nvmax, integer *
         fc, double *fd, integer *dd) {
     integer c_dim1, v_dim1, v_offset, x_dim1, x_offset, i__1, i__3;
-    static integer execnt = 0, k, l, m, p, u, i4, check, lower, upper, inorm2, offset;
-    static logical i1, i2, leaf;
-    static double diag[8], diam, sigma[8];
+    integer k, l, m, p, u, i4, check, lower, upper, inorm2, offset;
+    logical i1, i2, leaf;
+    double diag[8], diam, sigma[8];
 
     --pi; --hi; --lo; --xi; --a; --vhit;
     x_dim1 = n;
@@ -1107,7 +1119,6 @@ static void ehg124_(integer *ll, integer *uu, integer d__, integer n, integer *n
     v_dim1 = nvmax;
     v -= v_offset = 1 + v_dim1;
 
-    ++execnt;
     p = 1;
     l = *ll;
     u = *uu;
@@ -1198,8 +1209,8 @@ static void ehg127_(double *q, integer *n, integer *d__, integer *nf, double *f,
 
     integer b_dim1, x_dim1, b_offset;
     double d__1;
-    static integer execnt = 0, i__, j, i3, i9, jj, info, jpvt, inorm2, column;
-    static double g[15], i2, rho, scal, machep, colnor[15];
+    integer i__, j, i3, i9, jj, info, jpvt, inorm2, column;
+    double g[15], i2, rho, scal, machep, colnor[15];
 
     --rw; --y; --psi;
     x_dim1 = *n;
@@ -1214,9 +1225,7 @@ static void ehg127_(double *q, integer *n, integer *d__, integer *nf, double *f,
     e -= 16;
     --dgamma; --qraux; --work; --cdeg;
 
-    ++execnt;
-    if (execnt == 1)
-        machep = DBL_EPSILON;
+    machep = DBL_EPSILON;
     /*     sort by distance */
     for (i3 = 1; i3 <= *n; ++i3)
         dist[i3] = 0.;
@@ -1333,15 +1342,12 @@ static void ehg127_(double *q, integer *n, integer *d__, integer *nf, double *f,
 
 static void ehg129_(integer *l, integer *u, integer *d__, double *x, integer *pi, integer n, double *sigma) {
     integer x_dim1;
-    static integer execnt = 0;
-    static double t, beta, alpha, machin;
+    double t, beta, alpha, machin;
     --sigma;
     --pi;
     x_dim1 = n;
     x -= 1 + x_dim1;
-    ++execnt;
-    if (execnt == 1)
-        machin = DBL_MAX;
+    machin = DBL_MAX;
     for (integer k = 1; k <= *d__; ++k) {
         alpha = machin;
         beta = -machin;
@@ -1366,9 +1372,9 @@ static void ehg131_(double *x, double *y, double *rw, double *trl,
     integer lq_dim1, lq_offset, c_dim1, c_offset, lf_dim1, lf_dim2, lf_offset,
 	     v_dim1, v_offset, vval_dim1, vval_offset, vval2_dim1, vval2_offset, x_dim1, x_offset;
 
-    static integer execnt = 0, j, i1, i2;
-    static double delta[8];
-    static integer identi;
+    integer j, i1, i2;
+    double delta[8];
+    integer identi;
 
     --psi; --pi; 
     x_dim1 = *n;
@@ -1393,7 +1399,6 @@ static void ehg131_(double *x, double *y, double *rw, double *trl,
     lq -= lq_offset = 1 + lq_dim1;
     --w; --eta; --b; --cdeg;
 
-    ++execnt;
     if (! (*d__ <= 8))
         loess_error(101);
 /*     build $k$-d tree */
@@ -1427,8 +1432,6 @@ static void ehg133_(integer *n, integer *d__, integer *vc, integer *nvmax, integ
         double *vval, double *xi, integer m, double *z__, double *s) {
     integer c_dim1, c_offset, v_dim1, v_offset, vval_dim1, vval_offset, z_dim1, z_offset;
 
-    static integer execnt = 0, i__, i1;
-    static double delta[8];
 
     vval_dim1 = *d__ - 0 + 1;
     vval -= vval_offset = 0 + vval_dim1;
@@ -1440,9 +1443,10 @@ static void ehg133_(integer *n, integer *d__, integer *vc, integer *nvmax, integ
     z_dim1 = m;
     z__ -= z_offset = 1 + z_dim1;
 
-    ++execnt;
-    for (i__ = 1; i__ <= m; ++i__) {
-        for (i1 = 1; i1 <= *d__; ++i1)
+    //The tree and vertex values are only read, so each point can go to its own thread.
+    OMP_for (integer i__ = 1; i__ <= m; ++i__) {
+        double delta[8];
+        for (integer i1 = 1; i1 <= *d__; ++i1)
             delta[i1 - 1] = z__[i__ + i1 * z_dim1];
         s[i__] = ehg128_(delta, d__, ncmax, vc, a, xi, lo, hi,
              &c__[c_offset], &v[v_offset], nvmax, &vval[vval_offset]);
@@ -1472,8 +1476,8 @@ static void set_cs(integer d, integer i, double *c1, double *c2, double *c3){
 static void ehg141_(double *trl, integer *n, integer *deg, integer *k, integer *d,
         integer *nsing, integer *dk, double * delta1, double *delta2) {
 
-    static integer i;
-    static double z, c1, c2, c3, c4, corx;
+    integer i;
+    double z, c1, c2, c3, c4, corx;
 
 /*     coef, d, deg, del */
     if (*deg == 0)
@@ -1497,7 +1501,7 @@ static void ehg141_(double *trl, integer *n, integer *deg, integer *k, integer *
 } /* ehg141_ */
 
 static void lowesc_(integer *n, double *l, double *ll, double *trl, double *delta1, double *delta2) {
-    static integer execnt = 0, i__, j;
+    integer i__, j;
     integer l_dim1, ll_dim1;
 
     ll_dim1 = *n;
@@ -1505,7 +1509,6 @@ static void lowesc_(integer *n, double *l, double *ll, double *trl, double *delt
     l_dim1 = *n;
     l -= 1 + l_dim1;
 
-    ++execnt;
 /*     compute $LL~=~(I-L)(I-L)'$ */
     for (i__ = 1; i__ <= *n; ++i__)
         --l[i__ + i__ * l_dim1];
@@ -1533,7 +1536,7 @@ static void lowesc_(integer *n, double *l, double *ll, double *trl, double *delt
 static void ehg169_(integer d__, integer *vc, integer *nc, integer *ncmax, integer *nv, 
         integer nvmax, double *v, integer *a, double *xi, integer *c__, integer *hi, integer *lo) {
     integer c_dim1, v_dim1, v_offset, i__1, i__3;
-    static integer execnt = 0, i__, j, k, p, mc, mv, novhit[1];
+    integer i__, j, k, p, mc, mv, novhit[1];
 
     --lo;
     --hi;
@@ -1544,7 +1547,6 @@ static void ehg169_(integer d__, integer *vc, integer *nc, integer *ncmax, integ
     v_dim1 = nvmax;
     v -= v_offset = 1 + v_dim1;
 
-    ++execnt;
     /*     as in bbox */
     /*     remaining vertices */
     for (i__ = 2; i__ <= *vc - 1; ++i__) {
@@ -1630,10 +1632,9 @@ static double ehg176_(double *z) {
 
 static void lowesa_(double *trl, integer *n, integer *d__,
             integer *tau, integer *nsing, double *delta1, double *delta2) {
-    static integer execnt = 0, dka, dkb;
-    static double d1a, d1b, d2a, d2b, alpha;
+    integer dka, dkb;
+    double d1a, d1b, d2a, d2b, alpha;
 
-    ++execnt;
     ehg141_(trl, n, &c__1, tau, d__, nsing, &dka, &d1a, &d2a);
     ehg141_(trl, n, &c__2, tau, d__, nsing, &dkb, &d1b, &d2b);
     alpha = (double) (*tau - dka) / (double) (dkb - dka);
@@ -1647,8 +1648,8 @@ static void ehg191_(integer *m, double *z__, double *l, integer *d__, integer *n
 
     integer lq_dim1, c_offset, l_dim1, lf_dim1, lf_dim2, v_offset, vval2_dim1, vval2_offset, z_dim1;
 
-    static integer execnt = 0, i__, j, p, i1, i2, lq1;
-    static double zi[8];
+    integer i__, j, p, i1, i2, lq1;
+    double zi[8];
     z_dim1 = *m;
     z__ -= 1 + z_dim1;
     l_dim1 = *m;
@@ -1667,7 +1668,6 @@ static void ehg191_(integer *m, double *z__, double *l, integer *d__, integer *n
     vval2 -= vval2_offset = 0 + vval2_dim1;
     v -= v_offset = 1 + *nvmax;
 
-    ++execnt;
     for (j = 1; j <= *n; ++j) {
         for (i2 = 1; i2 <= *nv; ++i2)
             for (i1 = 0; i1 <= *d__; ++i1)
@@ -1693,10 +1693,9 @@ static void ehg191_(integer *m, double *z__, double *l, integer *d__, integer *n
 } /* ehg191_ */
 
 static void ehg196_(integer tau, integer d__, double f, double *trl) {
-    static integer execnt = 0, dka, dkb;
-    static double trla, trlb, alpha;
+    integer dka, dkb;
+    double trla, trlb, alpha;
 
-    ++execnt;
     ehg197(1, d__, f, &dka, &trla);
     ehg197(2, d__, f, &dkb, &trlb);
     alpha = (double) (tau - dka) / (double) (dkb - dka);
@@ -1742,11 +1741,11 @@ static double ehg128_(double *z__, integer *d__, integer *ncmax, integer *vc,
         integer *a, double *xi, integer *lo, integer *hi, integer *c__,
         double *v, integer *nvmax, double *vval) {
     integer c_dim1, v_dim1, vval_dim1;
-    static double g[2304]	/* was [9][256] */, h__;
-    static logical i2;
-    static integer execnt = 0, t[20], i__, j, m, i1, i11, i12, ig, ii, lg, ll, nt, ur;
-    static double g0[9], g1[9], s, v0, v1, ge, gn, gs, gw;
-    static double gpe, gpn, gps, gpw, sew, sns, phi0, phi1, psi0, psi1, xibar;
+    double g[2304]	/* was [9][256] */, h__;
+    logical i2;
+    integer t[20], i__, j, m, i1, i11, i12, ig, ii, lg, ll, nt, ur;
+    double g0[9], g1[9], s, v0, v1, ge, gn, gs, gw;
+    double gpe, gpn, gps, gpw, sew, sns, phi0, phi1, psi0, psi1, xibar;
 
     --z__; --hi; --lo; --xi; --a;
     c_dim1 = *vc;
@@ -1756,7 +1755,6 @@ static double ehg128_(double *z__, integer *d__, integer *ncmax, integer *vc,
     v_dim1 = *nvmax;
     v -= 1 + v_dim1;
 
-    ++execnt;
     /*     locate enclosing cell */
     nt = 1;
     t[nt - 1] = 1;
@@ -1957,11 +1955,10 @@ static void ehg136_(double *u, integer *lm, integer *m, integer *n, integer *d__
         double *dist, double *eta, double *b, integer *od, double *o, integer *ihat, double *w, 
         double *rcond, integer *sing, integer *dd, integer *tdeg, integer *cdeg, double * s) {
 
-    static integer execnt = 0;
     integer o_dim1, b_dim1, b_offset, s_dim1, u_dim1, x_dim1, x_offset;
-    static integer i__, j, l, i1, info, identi;
-    static double q[8], tol, work[15], scale, sigma[15], qraux[15], dgamma[15];
-    static double e[225]	/* was [15][15] */, g[225]	/* was [15][15] */;
+    integer i__, j, l, i1, info, identi;
+    double q[8], tol, work[15], scale, sigma[15], qraux[15], dgamma[15];
+    double e[225]	/* was [15][15] */, g[225]	/* was [15][15] */;
 
     o_dim1 = *m;
     o -= 1 + o_dim1;
@@ -1980,7 +1977,6 @@ static void ehg136_(double *u, integer *lm, integer *m, integer *n, integer *d__
     s -= 0 + s_dim1;
     --cdeg;
 
-    ++execnt;
     if (! (*k <= *nf - 1))
         loess_error(104);
     if (! (*k <= 15))
@@ -2053,7 +2049,7 @@ static void ehg136_(double *u, integer *lm, integer *m, integer *n, integer *d__
 
 static void ehg137_(double *z__, integer *kappa, integer *leaf, integer *nleaf, integer *d__, 
         integer *nv, integer *nvmax, integer * ncmax, integer *a, double *xi, integer *lo, integer *hi) {
-    static integer execnt = 0, p, pstack[20], stackt;
+    integer p, pstack[20], stackt;
 
     --leaf;
     --z__;
@@ -2062,7 +2058,6 @@ static void ehg137_(double *z__, integer *kappa, integer *leaf, integer *nleaf,
     --xi;
     --a;
     /*     stacktop -> stackt */
-    ++execnt;
     /*     find leaf cells affected by $z$ */
     stackt = 0;
     p = 1;
@@ -2111,11 +2106,10 @@ static void ehg139_(double *v, integer *nvmax, integer *nv, integer *n, integer
     integer lq_dim1, c_dim1, c_offset, lf_dim1, lf_dim2, b_dim1, b_offset, 
             s_dim1, v_dim1, v_offset, vval2_dim1, vval2_offset, x_dim1, x_offset, i__1, i__3;
 
-    static integer execnt = 0;
-    static double e[225]	/* was [15][15] */;
-    static double q[8], u[225]	/* was [15][15] */, z__[8], i4, i7, tol;
-    static integer i__, j, l, i5, i6, ii, leaf[256], info, ileaf, nleaf, identi;
-    static double term, work[15], scale, sigma[15], qraux[15], dgamma[15];
+    double e[225]	/* was [15][15] */;
+    double q[8], u[225]	/* was [15][15] */, z__[8], i4, i7, tol;
+    integer i__, j, l, i5, i6, ii, leaf[256], info, ileaf, nleaf, identi;
+    double term, work[15], scale, sigma[15], qraux[15], dgamma[15];
 
     --vhit; --diagl; --phi; --dist; --rw; --y;
     --psi; --pi; --w; --eta; --hi; --lo; --xi; --cdeg;
@@ -2137,7 +2131,6 @@ static void ehg139_(double *v, integer *nvmax, integer *nv, integer *n, integer
     c_dim1 = *vc;
     c__ -= c_offset = 1 + c_dim1;
 
-    ++execnt;
     /*     l2fit with trace(L) */
     if (! (*k <= *nf - 1))
         loess_error(104);
@@ -2249,9 +2242,9 @@ static void dqrdc_(double *x, integer *ldx, integer *n, integer *p, double *qrau
     integer x_dim1, i__2, i__3;
     double d__2;
 
-    static integer j, l, jj, jp, pl, pu, lp1, lup, maxj;
-    static logical negj, swapj;
-    static double t, tt, nrmxl, maxnrm;
+    integer j, l, jj, jp, pl, pu, lp1, lup, maxj;
+    logical negj, swapj;
+    double t, tt, nrmxl, maxnrm;
 
 /*     dqrdc uses householder transformations to compute the qr 
      factorization of an n by p matrix x.  column pivoting 
@@ -2461,11 +2454,10 @@ L60:
 
 static void lowesb_(double *xx, double *yy, double *ww, double *diagl, double trl,
         integer *iv, integer *liv, integer * lv, double *wv) {
-    static integer execnt = 0, setlf;
+    integer setlf;
     --wv;
     --iv;
 
-    ++execnt;
     if (! (iv[28] != 173))
         loess_error(174);
     if (iv[28] != 172 && !(iv[28] == 171))
@@ -2486,11 +2478,10 @@ static void lowesb_(double *xx, double *yy, double *ww, double *diagl, double tr
 
 static void lowesd_(integer *iv, integer *liv, integer *lv, double *v, 
         integer d__, integer n, double f, integer ideg, integer *nvmax, logical *setlf) {
-    static integer execnt = 0, i__, j, i1, i2, nf, vc, ncmax, bound;
+    integer i__, j, i1 = 0, i2, nf, vc, ncmax, bound;
     --iv;
     --v;
 
-    ++execnt;
     iv[28] = 171;
     iv[2] = d__;
     iv[3] = n;
@@ -2563,8 +2554,6 @@ static void lowesd_(integer *iv, integer *liv, integer *lv, double *v,
 } /* lowesd_ */
 
 static void lowese_(integer *iv, integer *liv, integer *lv, double *wv, integer m, double *z, double *s) {
-    static integer execnt = 0;
-    ++execnt;
     --iv;
     --wv;
 
@@ -2578,9 +2567,8 @@ static void lowese_(integer *iv, integer *liv, integer *lv, double *wv, integer
 
 static void lowesf_(double *xx, double *yy, double *ww, integer *iv, integer *liv, 
         integer *lv, double *wv, integer *m, double *z__, double *l, integer ihat, double *s) {
-    static integer execnt = 0;
     integer l_dim1, l_offset, z_dim1, z_offset;
-    static logical i1;
+    logical i1;
     --xx;
     --yy;
     --ww;
@@ -2591,7 +2579,6 @@ static void lowesf_(double *xx, double *yy, double *ww, integer *iv, integer *li
     z_dim1 = *m;
     z__ -= z_offset = 1 + z_dim1;
 
-    ++execnt;
     i1 = (171 <= iv[28])
           ? iv[28] <= 174
 	      : FALSE_;
@@ -2606,7 +2593,6 @@ static void lowesf_(double *xx, double *yy, double *ww, integer *iv, integer *li
 } /* lowesf_ */
 
 static void lowesl_(integer *iv, integer *liv, integer *lv, double *wv, integer *m, double *z__, double *l) {
-    static integer execnt = 0;
     integer l_dim1, l_offset, z_dim1, z_offset;
 
     --iv;
@@ -2616,7 +2602,6 @@ static void lowesl_(integer *iv, integer *liv, integer *lv, double *wv, integer
     z_dim1 = *m;
     z__ -= z_offset = 1 + z_dim1;
 
-    ++execnt;
     if (! (iv[28] != 172))
         loess_error(172);
     if (! (iv[28] == 173))
@@ -2629,12 +2614,11 @@ static void lowesl_(integer *iv, integer *liv, integer *lv, double *wv, integer
 } /* lowesl_ */
 
 static void lowesw_(double *res, integer *n, double *rw, integer *pi) {
-    static integer i1, nh, execnt = 0, identi;
-    static double cmad, rsmall;
+    integer i1, nh, identi;
+    double cmad, rsmall;
     --pi;
     --rw;
     --res;
-    ++execnt;
 /*     tranliterated from Devlin's ratfor */
 /*     find median of absolute residuals */
     for (i1 = 1; i1 <= *n; ++i1)
@@ -2665,8 +2649,8 @@ static void lowesw_(double *res, integer *n, double *rw, integer *pi) {
 
 static void pseudovals(integer n, double *y, double *yhat, double *pwgts,  //formerly lowesp
                 double *rwgts, integer *pi, double *ytilde) {
-    static integer m, i5, identi, execnt = 0;
-    static double i4, mad;
+    integer m, i5, identi;
+    double i4, mad;
 
     --ytilde;
     --pi;
@@ -2675,7 +2659,6 @@ static void pseudovals(integer n, double *y, double *yhat, double *pwgts,  //for
     --yhat;
     --y;
 
-    ++execnt;
     /*     median absolute deviation */
     for (i5 = 1; i5 <= n; ++i5)
         ytilde[i5] = abs(y[i5] - yhat[i5]) * sqrt(pwgts[i5]);
@@ -2706,55 +2689,57 @@ static void pseudovals(integer n, double *y, double *yhat, double *pwgts,  //for
 }
 
 ////// Back to loessc.c
-static void loess_workspace(long D, long N, double	span, long degree,
+static void loess_workspace(loess_work *w, long D, long N, double	span, long degree,
 			long *nonparametric, long *drop_square, long *sum_drop_sqr, long setLf){
 	long tau0, nvmax, nf, i;
 	nvmax = max(200, N);
         nf = min(N, floor(N * span));
         tau0 = (degree > 1) ? ((D + 2) * (D + 1) * 0.5) : (D + 1);
-        tau = tau0 - (*sum_drop_sqr);
-        lv = 50 + (3 * D + 3) * nvmax + N + (tau0 + 2) * nf;
-	liv = 50 + ((long)pow((double)2, (double)D) + 4) * nvmax + 2 * N;
+        w->tau = tau0 - (*sum_drop_sqr);
+        w->lv = 50 + (3 * D + 3) * nvmax + N + (tau0 + 2) * nf;
+	w->liv = 50 + ((long)pow((double)2, (double)D) + 4) * nvmax + 2 * N;
 	if(setLf) {
-		lv = lv + (D + 1) * nf * nvmax;
-		liv = liv + nf * nvmax;	
+		w->lv = w->lv + (D + 1) * nf * nvmax;
+		w->liv = w->liv + nf * nvmax;	
 	}
-    iv = Calloc(liv, long);
-    v = Calloc(lv, double);
+    w->iv = Calloc(w->liv, long);
+    w->v = Calloc(w->lv, double);
 
-    lowesd_(iv, &liv, &lv, v, D, N, span, degree, &nvmax, &setLf);
-    iv[32] = *nonparametric;
+    lowesd_(w->iv, &w->liv, &w->lv, w->v, D, N, span, degree, &nvmax, &setLf);
+    w->iv[32] = *nonparametric;
     for(i = 0; i < D; i++)
-        iv[i + 40] = drop_square[i];
+        w->iv[i + 40] = drop_square[i];
 }
 
-static void loess_free() {
-    free(v);
-    free(iv);
+static void loess_free(loess_work *w) {
+    free(w->v);
+    free(w->iv);
 }
 
 static void loess_dfit( double	*y, double *x, double *x_evaluate, double *weights,
 			double span, long degree, long *nonparametric, long *drop_square,
 			long *sum_drop_sqr, long d, long n, long *m, double *fit) {
-    loess_workspace(d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 0);
-	lowesf_(x, y, weights, iv, &liv, &lv, v, m, x_evaluate, &doublepluszero, 0, fit);
-	loess_free();
+    loess_work work = {.zero=0}, *w = &work;
+    loess_workspace(w, d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 0);
+	lowesf_(x, y, weights, w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, &w->zero, 0, fit);
+	loess_free(w);
 }
 
 static void loess_dfitse( double	*y, double *x, double *x_evaluate, double *weights, double *robust,
         int	family, double span, long degree, long *nonparametric, long *drop_square,
          long *sum_drop_sqr, long d, long n, long *m, double *fit, double *L) {
-    loess_workspace(d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 0);
+    loess_work work = {.zero=0}, *w = &work;
+    loess_workspace(w, d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 0);
 	if(family == GAUSSIAN)
-		lowesf_(x, y, weights, iv, &liv, &lv, v, m, x_evaluate, L, 2, fit);
+		lowesf_(x, y, weights, w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, L, 2, fit);
 	else if(family == SYMMETRIC) {
-		lowesf_(x, y, weights, iv, &liv, &lv, v, m, x_evaluate, L, 2, fit);
-		lowesf_(x, y, robust, iv, &liv, &lv, v, m, x_evaluate, &doublepluszero, 0, fit);
+		lowesf_(x, y, weights, w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, L, 2, fit);
+		lowesf_(x, y, robust, w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, &w->zero, 0, fit);
 	}	
-	loess_free();
+	loess_free(w);
 }
 
-static void loess_grow(long	const * restrict parameter,long const*restrict a,
+static void loess_grow(loess_work *w, long const * restrict parameter,long const*restrict a,
                        double	const *restrict xi, double const *restrict vert, 
                        const double *restrict vval) {
 	long	d, vc, nc, nv, a1, v1, xi1, vv1, i, k;
@@ -2762,92 +2747,107 @@ static void loess_grow(long	const * restrict parameter,long const*restrict a,
 	vc = parameter[2];
 	nc = parameter[3];
 	nv = parameter[4];
-	liv = parameter[5];
-	lv = parameter[6];
-	iv = Calloc(liv, long);
-	v = Calloc(lv, double);
-
-	iv[1] = d;
-	iv[2] = parameter[1];
-	iv[3] = vc;
-	iv[5] = iv[13] = nv;
-	iv[4] = iv[16] = nc;
-	iv[6] = 50;
-	iv[7] = iv[6] + nc;
-	iv[8] = iv[7] + vc * nc;
-	iv[9] = iv[8] + nc;
-	iv[10] = 50;
-	iv[12] = iv[10] + nv * d;
-	iv[11] = iv[12] + (d + 1) * nv;
-	iv[27] = 173;
-
-	v1 = iv[10] - 1;
-	xi1 = iv[11] - 1;
-	a1 = iv[6] - 1;
-	vv1 = iv[12] - 1;
+	w->liv = parameter[5];
+	w->lv = parameter[6];
+	w->iv = Calloc(w->liv, long);
+	w->v = Calloc(w->lv, double);
+
+	w->iv[1] = d;
+	w->iv[2] = parameter[1];
+	w->iv[3] = vc;
+	w->iv[5] = w->iv[13] = nv;
+	w->iv[4] = w->iv[16] = nc;
+	w->iv[6] = 50;
+	w->iv[7] = w->iv[6] + nc;
+	w->iv[8] = w->iv[7] + vc * nc;
+	w->iv[9] = w->iv[8] + nc;
+	w->iv[10] = 50;
+	w->iv[12] = w->iv[10] + nv * d;
+	w->iv[11] = w->iv[12] + (d + 1) * nv;
+	w->iv[27] = 173;
+
+	v1 = w->iv[10] - 1;
+	xi1 = w->iv[11] - 1;
+	a1 = w->iv[6] - 1;
+	vv1 = w->iv[12] - 1;
 	
     for(i = 0; i < d; i++) {
 		k = nv * i;
-		v[v1 + k] = vert[i];
-		v[v1 + vc - 1 + k] = vert[i + d];
+		w->v[v1 + k] = vert[i];
+		w->v[v1 + vc - 1 + k] = vert[i + d];
 	}
     for(i = 0; i < nc; i++) {
-            v[xi1 + i] = xi[i];
-            iv[a1 + i] = a[i];
+            w->v[xi1 + i] = xi[i];
+            w->iv[a1 + i] = a[i];
     }
 	k = (d + 1) * nv;
 	for(i = 0; i < k; i++)
-		v[vv1 + i] = vval[i];
-	ehg169_(d, &vc, &nc, &nc, &nv, nv, v+v1, iv+a1, v+xi1, iv+iv[7]-1, iv+iv[8]-1, iv+iv[9]-1);
+		w->v[vv1 + i] = vval[i];
+	ehg169_(d, &vc, &nc, &nc, &nv, nv, w->v+v1, w->iv+a1, w->v+xi1, w->iv+w->iv[7]-1, w->iv+w->iv[8]-1, w->iv+w->iv[9]-1);
 }
 
 static void loess_ifit(long const * restrict parameter, long const *restrict a, 
                 double const *restrict xi, double const *restrict vert,
                  const double *restrict vval, long m, double *x_evaluate, double *fit) {
-	loess_grow(parameter, a, xi, vert, vval);
-	lowese_(iv, &liv, &lv, v, m, x_evaluate, fit);
-	loess_free();
+    loess_work work = {.zero=0}, *w = &work;
+	loess_grow(w, parameter, a, xi, vert, vval);
+	lowese_(w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, fit);
+	loess_free(w);
 }
 
 static void loess_ise( double	*y, double *x, double *x_evaluate, double *weights, double span, long degree,
              long int *nonparametric, long int *drop_square, long int *sum_drop_sqr, double *cell, long int d,
              long int n, long int *m, double *fit, double *L) {
-    loess_workspace(d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 1);
-	v[1] = *cell;
-	lowesb_(x, y, weights, &doublepluszero, 0, iv, &liv, &lv, v);
-	lowesl_(iv, &liv, &lv, v, m, x_evaluate, L);
-	loess_free();
+    loess_work work = {.zero=0}, *w = &work;
+    loess_workspace(w, d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 1);
+	w->v[1] = *cell;
+	lowesb_(x, y, weights, &w->zero, 0, w->iv, &w->liv, &w->lv, w->v);
+	lowesl_(w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, L);
+	loess_free(w);
+}
+
+//Build the kd tree and vertex values from the data, then interpolate from them. For
+//interpolated predictions from a model that was fit via the direct surface.
+static void loess_bfit( double	*y, double *x, double *x_evaluate, double *weights, double span, long degree,
+             long int *nonparametric, long int *drop_square, long int *sum_drop_sqr, double *cell, long int d,
+             long int n, long int m, double *fit) {
+    loess_work work = {.zero=0}, *w = &work;
+    loess_workspace(w, d, n, span, degree, nonparametric, drop_square, sum_drop_sqr, 0);
+	w->v[1] = *cell;
+	lowesb_(x, y, weights, &w->zero, 0, w->iv, &w->liv, &w->lv, w->v);
+	lowese_(w->iv, &w->liv, &w->lv, w->v, m, x_evaluate, fit);
+	loess_free(w);
 }
 
-static void loess_prune( long	*parameter, long *a, double	*xi, double *vert, double *vval) {
+static void loess_prune(loess_work *w, long *parameter, long *a, double	*xi, double *vert, double *vval) {
 	long	d, vc, a1, v1, xi1, vv1, nc, nv, nvmax, i, k;
-	d = iv[1];
-	vc = iv[3] - 1;
-	nc = iv[4];
-	nv = iv[5];
-	a1 = iv[6] - 1;
-	v1 = iv[10] - 1;
-	xi1 = iv[11] - 1;
-	vv1 = iv[12] - 1;
-	nvmax = iv[13];
+	d = w->iv[1];
+	vc = w->iv[3] - 1;
+	nc = w->iv[4];
+	nv = w->iv[5];
+	a1 = w->iv[6] - 1;
+	v1 = w->iv[10] - 1;
+	xi1 = w->iv[11] - 1;
+	vv1 = w->iv[12] - 1;
+	nvmax = w->iv[13];
 
 	for(i = 0; i < 5; i++)
-		parameter[i] = iv[i + 1];
-	parameter[5] = iv[21] - 1;
-	parameter[6] = iv[14] - 1;
+		parameter[i] = w->iv[i + 1];
+	parameter[5] = w->iv[21] - 1;
+	parameter[6] = w->iv[14] - 1;
 
 	for(i = 0; i < d; i++){
 		k = nvmax * i;
-		vert[i] = v[v1 + k];
-		vert[i + d] = v[v1 + vc + k];
+		vert[i] = w->v[v1 + k];
+		vert[i + d] = w->v[v1 + vc + k];
 	}
 	for(i = 0; i < nc; i++) {
-		xi[i] = v[xi1 + i];
-		a[i] = iv[a1 + i];
+		xi[i] = w->v[xi1 + i];
+		a[i] = w->iv[a1 + i];
 	}
 	k = (d + 1) * nv;
 	for(i = 0; i < k; i++)
-		vval[i] = v[vv1 + i];
+		vval[i] = w->v[vv1 + i];
 }
 
 ////// predict.c
@@ -2862,13 +2862,16 @@ struct pred_struct {
 };
 /** \endcond */ //End of Doxygen ignore.
 
-void predict(double  *new_x, long M, struct loess_struct *lo, struct pred_struct *pre, int want_cov) {
+/* If \c interpolate_only is set, predictions from a model fit via the direct surface use a
+   kd tree and vertex fits built once, instead of one local regression per new point. */
+void predict(double  *new_x, long M, struct loess_struct *lo, struct pred_struct *pre, int want_cov, int interpolate_only) {
 	
     long D = lo->in.p;//Aliases for the purposes of merging some fn.s
     long N = lo->in.n;
             
 	int     i, j, k, p;
-	double x[N * D], x_tmp[N * D], x_evaluate[M * D];
+	double x[N * D], x_tmp[N * D];
+    double *x_evaluate = malloc(M * D * sizeof(double)); //M may be large; keep it off the stack.
 
 	for(i = 0; i < D; i++) {
 		k = i * M;
@@ -2908,28 +2911,35 @@ void predict(double  *new_x, long M, struct loess_struct *lo, struct pred_struct
         for(j = 0; j < N; j++)
             x[k + j] = x_tmp[p + j];
     }
+    double robust[N]; //a copy, so predictions don't modify the fitted model.
 	for(i = 0; i < N; i++)
-		lo->out.robust[i] *= lo->in.weights[i];
+		robust[i] = lo->out.robust[i] * lo->in.weights[i];
 
     pre->fit = malloc(M * sizeof(double));
 	pre->residual_scale = lo->out.s;
 	pre->df = (lo->out.one_delta * lo->out.one_delta) / lo->out.two_delta;
-    double L[N * M];
-	if(!strcmp(lo->control.surface, "direct")) {
+    double *L = want_cov ? malloc(N * M * sizeof(double)) : NULL;
+    int direct = !strcmp(lo->control.surface, "direct");
+	if(direct && !interpolate_only) {
         if(want_cov)
-            loess_dfitse(lo->in.y, x, x_evaluate, lo->in.weights, lo->out.robust, !strcmp(lo->model.family, "gaussian"), 
+            loess_dfitse(lo->in.y, x, x_evaluate, lo->in.weights, robust, !strcmp(lo->model.family, "gaussian"), 
                 lo->model.span, lo->model.degree, &nonparametric, order_drop_sqr, &sum_drop_sqr, D, N, &M, pre->fit, L);
         else
-            loess_dfit(lo->in.y, x, x_evaluate, lo->out.robust, lo->model.span, lo->model.degree, &nonparametric,
+            loess_dfit(lo->in.y, x, x_evaluate, robust, lo->model.span, lo->model.degree, &nonparametric,
                 order_drop_sqr, &sum_drop_sqr, D, N, &M, pre->fit);
     } else {
-        loess_ifit(lo->kd_tree.parameter, lo->kd_tree.a, lo->kd_tree.xi, lo->kd_tree.vert, 
+        double new_cell = lo->model.span * lo->control.cell;
+        if (direct) //no stored kd tree, so build one.
+            loess_bfit(lo->in.y, x, x_evaluate, robust, lo->model.span, lo->model.degree, &nonparametric, 
+                    order_drop_sqr, &sum_drop_sqr, &new_cell, D, N, M, pre->fit);
+        else
+            loess_ifit(lo->kd_tree.parameter, lo->kd_tree.a, lo->kd_tree.xi, lo->kd_tree.vert, 
                         lo->kd_tree.vval, M, x_evaluate, pre->fit);
         if(want_cov) {
-            double new_cell = lo->model.span * lo->control.cell;
-            double fit_tmp[M];
+            double *fit_tmp = malloc(M * sizeof(double));
             loess_ise(lo->in.y, x, x_evaluate, lo->in.weights, lo->model.span, lo->model.degree, &nonparametric, 
                     order_drop_sqr, &sum_drop_sqr, &new_cell, D, N, &M, fit_tmp, L);
+            free(fit_tmp);
         }
     }
 	if (want_cov) {
@@ -2942,13 +2952,15 @@ void predict(double  *new_x, long M, struct loess_struct *lo, struct pred_struct
                 L[p] *= L[p]; //i.e., square
             }
 		}
-		for(i = 0; i < M; i++) {
+		OMP_for (long ii = 0; ii < M; ii++) {
             double tmp = 0;
-			for(j = 0; j < N; j++)
-                tmp += L[i + j * M];
-			pre->se_fit[i] = lo->out.s * sqrt(tmp);
+			for(long jj = 0; jj < N; jj++)
+                tmp += L[ii + jj * M];
+			pre->se_fit[ii] = lo->out.s * sqrt(tmp);
 		}
 	}
+    free(L);
+    free(x_evaluate);
 }
 
 void pred_free_mem(struct	pred_struct	*pre){
@@ -2957,8 +2969,6 @@ void pred_free_mem(struct	pred_struct	*pre){
 }
 
  ///// loess.c
-static  char    *surf_stat;
-
 int comp(const void *d1_in, const void *d2_in) {
     const double *d1 = d1_in;
     const double *d2 = d1_in;
@@ -2970,7 +2980,8 @@ int comp(const void *d1_in, const void *d2_in) {
                 return(1);
 }
 
-static void condition(char	**surface, char *new_stat, char **trace_hat_in) {
+//Returns the surface/statistics combination, or surf_stat unchanged if there's no match.
+static char *condition(char *surf_stat, char **surface, char *new_stat, char **trace_hat_in) {
 	if(!strcmp(*surface, "interpolate")) {
 		if(!strcmp(new_stat, "none"))
 			surf_stat = "interpolate/none";
@@ -2992,6 +3003,7 @@ static void condition(char	**surface, char *new_stat, char **trace_hat_in) {
 		else if(!strcmp(new_stat, "approximate"))
 			surf_stat = "direct/approximate";
 	}
+	return surf_stat;
 }
 
 static void loess_raw( double	*y, double *x, double *weights, double *robust, long	*d, 
@@ -2999,56 +3011,57 @@ static void loess_raw( double	*y, double *x, double *weights, double *robust, lo
             long *sum_drop_sqr, double *cell, char	**surf_stat, double *surface, long	*parameter, 
             long *a, double *xi, double *vert, double	*vval,double *diagonal, double*trL, 
             double*one_delta, double*two_delta, long *setLf) {
+    loess_work work = {.zero=0}, *w = &work;
 	long nsing, i, k;
 	double	*hat_matrix, *LL;
 	*trL = 0;
-	loess_workspace(*d, *n, *span, *degree, nonparametric, drop_square, sum_drop_sqr, *setLf);
-        v[1] = *cell;
+	loess_workspace(w, *d, *n, *span, *degree, nonparametric, drop_square, sum_drop_sqr, *setLf);
+        w->v[1] = *cell;
 	if(!strcmp(*surf_stat, "interpolate/none")) {
-		lowesb_(x, y, robust, &doublepluszero, 0, iv, &liv, &lv, v);
-		lowese_(iv, &liv, &lv, v, *n, x, surface);
-		loess_prune(parameter, a, xi, vert, vval);
+		lowesb_(x, y, robust, &w->zero, 0, w->iv, &w->liv, &w->lv, w->v);
+		lowese_(w->iv, &w->liv, &w->lv, w->v, *n, x, surface);
+		loess_prune(w, parameter, a, xi, vert, vval);
 	}			
 	else if (!strcmp(*surf_stat, "direct/none"))
-		lowesf_(x, y, robust, iv, &liv, &lv, v, n, x, &doublepluszero, 0, surface);
+		lowesf_(x, y, robust, w->iv, &w->liv, &w->lv, w->v, n, x, &w->zero, 0, surface);
 	else if (!strcmp(*surf_stat, "interpolate/1.approx")) {
-		lowesb_(x, y, weights, diagonal, 1, iv, &liv, &lv, v);
-		lowese_(iv, &liv, &lv, v, *n, x, surface);
-		nsing = iv[29];
+		lowesb_(x, y, weights, diagonal, 1, w->iv, &w->liv, &w->lv, w->v);
+		lowese_(w->iv, &w->liv, &w->lv, w->v, *n, x, surface);
+		nsing = w->iv[29];
 		for(i = 0; i < *n; i++) *trL = *trL + diagonal[i];
-		lowesa_(trL, n, d, &tau, &nsing, one_delta, two_delta);
-		loess_prune(parameter, a, xi, vert, vval);
+		lowesa_(trL, n, d, &w->tau, &nsing, one_delta, two_delta);
+		loess_prune(w, parameter, a, xi, vert, vval);
 	}
     else if (!strcmp(*surf_stat, "interpolate/2.approx")) {
-		lowesb_(x, y, robust, &doublepluszero, 0, iv, &liv, &lv, v);
-		lowese_(iv, &liv, &lv, v, *n, x, surface);
-		nsing = iv[29];
-		ehg196_(tau, *d, *span, trL);
-		lowesa_(trL, n, d, &tau, &nsing, one_delta, two_delta);
-		loess_prune(parameter, a, xi, vert, vval);
+		lowesb_(x, y, robust, &w->zero, 0, w->iv, &w->liv, &w->lv, w->v);
+		lowese_(w->iv, &w->liv, &w->lv, w->v, *n, x, surface);
+		nsing = w->iv[29];
+		ehg196_(w->tau, *d, *span, trL);
+		lowesa_(trL, n, d, &w->tau, &nsing, one_delta, two_delta);
+		loess_prune(w, parameter, a, xi, vert, vval);
 	}
 	else if (!strcmp(*surf_stat, "direct/approximate")) {
-		lowesf_(x, y, weights, iv, &liv, &lv, v, n, x, diagonal, 1, surface);
-		nsing = iv[29];
+		lowesf_(x, y, weights, w->iv, &w->liv, &w->lv, w->v, n, x, diagonal, 1, surface);
+		nsing = w->iv[29];
 		for(i = 0; i < (*n); i++) *trL = *trL + diagonal[i];
-		lowesa_(trL, n, d, &tau, &nsing, one_delta, two_delta);
+		lowesa_(trL, n, d, &w->tau, &nsing, one_delta, two_delta);
 	}
 	else if (!strcmp(*surf_stat, "interpolate/exact")) {
 		hat_matrix = Calloc((*n)*(*n), double);
 		LL = Calloc((*n)*(*n), double);
-		lowesb_(x, y, weights, diagonal, 1, iv, &liv, &lv, v);
-		lowesl_(iv, &liv, &lv, v, n, x, hat_matrix);
+		lowesb_(x, y, weights, diagonal, 1, w->iv, &w->liv, &w->lv, w->v);
+		lowesl_(w->iv, &w->liv, &w->lv, w->v, n, x, hat_matrix);
 		lowesc_(n, hat_matrix, LL, trL, one_delta, two_delta);
-		lowese_(iv, &liv, &lv, v, *n, x, surface);
-		loess_prune(parameter, a, xi, vert, vval);
+		lowese_(w->iv, &w->liv, &w->lv, w->v, *n, x, surface);
+		loess_prune(w, parameter, a, xi, vert, vval);
 		free(hat_matrix);
 		free(LL);
 	}
 	else if (!strcmp(*surf_stat, "direct/exact")) {
 		hat_matrix = Calloc((*n)*(*n), double);
 		LL = Calloc((*n)*(*n), double);
-		//lowesf_(x, y, weights, iv, liv, lv, v, n, x, hat_matrix, &two, surface);//seems wrong.
-		lowesf_(x, y, weights, iv, &liv, &lv, v, n, x, hat_matrix, 2, surface);
+		//lowesf_(x, y, weights, w->iv, w->liv, w->lv, w->v, n, x, hat_matrix, &two, surface);//seems wrong.
+		lowesf_(x, y, weights, w->iv, &w->liv, &w->lv, w->v, n, x, hat_matrix, 2, surface);
 		lowesc_(n, hat_matrix, LL, trL, one_delta, two_delta);
         k = (*n) + 1;
 		for(i = 0; i < (*n); i++)
@@ -3056,7 +3069,7 @@ static void loess_raw( double	*y, double *x, double *weights, double *robust, lo
 		free(hat_matrix);
 		free(LL);
 	}
-	loess_free();
+	loess_free(w);
 }
 
 static void loess_(double *y, double *x_, long *size_info, double *weights,
@@ -3071,7 +3084,7 @@ static void loess_(double *y, double *x_, long *size_info, double *weights,
                 trL_tmp = 0, d1_tmp = 0, d2_tmp = 0, sum, mean;
 	long	i, j, k, p, N, D, sum_drop_sqr = 0, sum_parametric = 0, setLf,	
                 nonparametric = 0, zero = 0, max_kd;
-	char   *new_stat;
+	char   *new_stat, *surf_stat = NULL;
 
 	D = size_info[0];
 	N = size_info[1];
@@ -3141,7 +3154,7 @@ static void loess_(double *y, double *x_, long *size_info, double *weights,
 		new_stat = j ? "none" : *statistics;
 		for(i = 0; i < N; i++)
 			robust[i] = weights[i] * robust[i];
-		condition(surface, new_stat, trace_hat_in);
+		surf_stat = condition(surf_stat, surface, new_stat, trace_hat_in);
 		setLf = !strcmp(surf_stat, "interpolate/exact");
 		loess_raw(y, x, weights, robust, &D, &N, span, degree, &nonparametric, order_drop_sqr, 
                 &sum_drop_sqr, &new_cell, &surf_stat, fitted_values, parameter, a,
@@ -3488,7 +3501,34 @@ void loess(struct loess_struct *lo) ;
 void loess_setup( double  *x, double *y, long n, long p, struct  loess_struct *lo) ;
 
 
-Apop_settings_copy(apop_loess, )
+static void *loess_dup(void const *in, size_t size){
+    if (!in) return NULL;
+    void *out = malloc(size);
+    memcpy(out, in, size);
+    return out;
+}
+
+//Give the copy its own arrays, so the original and an estimated copy can be fit,
+//predicted from, and freed independently.
+Apop_settings_copy(apop_loess,
+    struct loess_struct *lo = &out->lo_s;
+    struct loess_struct const *lin = &in->lo_s;
+    size_t n = lin->in.n, p = lin->in.p, max_kd = n > 200 ? n : 200;
+    lo->in.y = loess_dup(lin->in.y, n * sizeof(double));
+    lo->in.x = loess_dup(lin->in.x, n * p * sizeof(double));
+    lo->in.weights = loess_dup(lin->in.weights, n * sizeof(double));
+    lo->out.fitted_values = loess_dup(lin->out.fitted_values, n * sizeof(double));
+    lo->out.fitted_residuals = loess_dup(lin->out.fitted_residuals, n * sizeof(double));
+    lo->out.pseudovalues = loess_dup(lin->out.pseudovalues, n * sizeof(double));
+    lo->out.diagonal = loess_dup(lin->out.diagonal, n * sizeof(double));
+    lo->out.robust = loess_dup(lin->out.robust, n * sizeof(double));
+    lo->out.divisor = loess_dup(lin->out.divisor, p * sizeof(double));
+    lo->kd_tree.parameter = loess_dup(lin->kd_tree.parameter, 7 * sizeof(long));
+    lo->kd_tree.a = loess_dup(lin->kd_tree.a, max_kd * sizeof(long));
+    lo->kd_tree.xi = loess_dup(lin->kd_tree.xi, max_kd * sizeof(double));
+    lo->kd_tree.vert = loess_dup(lin->kd_tree.vert, p * 2 * sizeof(double));
+    lo->kd_tree.vval = loess_dup(lin->kd_tree.vval, (p + 1) * max_kd * sizeof(double));
+)
 Apop_settings_free(apop_loess, loess_free_mem(&(in->lo_s));)
 
 void matrix_to_FORTRAN(gsl_matrix *inmatrix, double *outFORTRAN, int start_col){
@@ -3545,6 +3585,7 @@ Apop_settings_init(apop_loess,
         .kd_tree.vval =  malloc((p + 1) * max_kd * sizeof(double)),
     };
     Apop_varad_set(ci_level, 0.95);
+    Apop_varad_set(interpolate_predictions, 'n');
     struct loess_struct *lo = &(out->lo_s);
     if (in.data->weights)
         lo->in.weights = in.data->weights->data;
@@ -3572,9 +3613,10 @@ apop_data * loess_predict (apop_data *in, apop_model *m){
     double *eval_here = malloc(sizeof(double)*in->matrix->size1*(in->matrix->size2-1));
     matrix_to_FORTRAN(in->matrix, eval_here, 1);
     int want_cov = Apop_settings_get(m, apop_loess, want_predict_ci)=='y';
+    int interpolate_only = Apop_settings_get(m, apop_loess, interpolate_predictions)=='y';
     struct pred_struct pred = (struct pred_struct){ };
 
-    predict(eval_here, in->matrix->size1, &(Apop_settings_get(m, apop_loess, lo_s)), &pred, want_cov);
+    predict(eval_here, in->matrix->size1, &(Apop_settings_get(m, apop_loess, lo_s)), &pred, want_cov, interpolate_only);
 
     //Massage FORTRAN's output to Apophenia's formats
     gsl_vector* firstcol = Apop_cv(in, 0);
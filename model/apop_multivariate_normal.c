@@ -12,42 +12,128 @@ matrix a \f$1\times 1\f$ matrix. This differs from the setup for \ref apop_norma
 outputs a single vector with \f$\mu\f$ in element zero and \f$\sigma\f$ in element one.
 
 After estimation, the <tt>\<Covariance\></tt> page gives the covariance matrix of the means.
+
+The log likelihood and the RNG both use the Cholesky decomposition of the covariance
+matrix. It is calculated on first use and stored in an \ref apop_mvn_settings group,
+and is recalculated only when the covariance in the \c parameters changes.
+
+\adoc Settings   \ref apop_mvn_settings
 */
  
 #include "apop_internal.h"
 
-static double x_prime_sigma_x(gsl_vector *x, gsl_matrix *sigma){
-    gsl_vector * sigma_dot_x = gsl_vector_calloc(x->size);
-    double the_result;
-    gsl_blas_dsymv(CblasUpper, 1, sigma, x, 0, sigma_dot_x); //sigma should be symmetric
-    gsl_blas_ddot(x, sigma_dot_x, &the_result);
-    gsl_vector_free(sigma_dot_x);
-    return the_result;
+Apop_settings_init(apop_mvn, )
+
+Apop_settings_copy(apop_mvn,
+    out->cholesky = apop_matrix_copy(in->cholesky);
+    out->sigma = apop_matrix_copy(in->sigma);
+)
+
+Apop_settings_free(apop_mvn,
+    gsl_matrix_free(in->cholesky);
+    gsl_matrix_free(in->sigma);
+)
+
+static int sigma_changed(gsl_matrix const *sigma, gsl_matrix const *cached){
+    if (!cached || cached->size1 != sigma->size1 || cached->size2 != sigma->size2) return 1;
+    for (size_t i=0; i< sigma->size1; i++)
+        if (memcmp(gsl_matrix_const_ptr(sigma, i, 0), gsl_matrix_const_ptr(cached, i, 0), sizeof(double)*sigma->size2))
+            return 1;
+    return 0;
 }
 
-static long double apop_multinormal_ll(apop_data *data, apop_model * m){
-    Nullcheck_mpd(data, m, GSL_NAN);
-    double determinant = 0;
-    gsl_matrix* inverse = NULL;
-    int i, dimensions  = data->matrix->size2;
-    gsl_vector* x_minus_mu= gsl_vector_alloc(data->matrix->size2);
-    double ll = 0;
-    determinant = apop_det_and_inv(m->parameters->matrix, &inverse, 1,1);
-    Apop_stopif(isnan(determinant) || determinant == 0,
-        gsl_vector_free(x_minus_mu); return GSL_NEGINF, //tell maximizers to look elsewhere.
+/* Return the settings group holding the Cholesky factor of the covariance, which is
+   recalculated only if the covariance has changed since the last call. The Wishart
+   also uses this, for the factor of its scale matrix.
+
+   If the hash of the covariance matches the one stored with the factor, return without
+   a lock; prep attaches the group, so looking it up doesn't race with adding it. Else,
+   the full comparison and any rebuild are inside the critical region, and the hash is
+   stored only after the factor is in place, so threads evaluating one model with the
+   same parameters share one factor and never see it half-built. As with any use of
+   m->parameters, changing the covariance while another thread is evaluating the same
+   model is not safe. */
+apop_mvn_settings *mvn_factor(apop_model *m){
+    apop_mvn_settings *ms;
+    gsl_matrix *sigma = m->parameters->matrix;
+    unsigned long long hash = params_hash(&(apop_data){.matrix=sigma});
+    if ((ms = Apop_settings_get_group(m, apop_mvn))){
+        unsigned long long cached = ms->sigma_hash;
+        #pragma omp flush
+        if (cached == hash) return ms;
+    }
+    OMP_critical(mvn_factor)
+    {
+    if (!(ms = Apop_settings_get_group(m, apop_mvn)))
+        ms = Apop_settings_add_group(m, apop_mvn);
+    if (sigma_changed(sigma, ms->sigma)){
+        gsl_matrix *factor = apop_matrix_copy(sigma);
+        gsl_error_handler_t *prior_handler = gsl_set_error_handler_off(); //failure is reported by the callers.
+        int failed = gsl_linalg_cholesky_decomp(factor);
+        gsl_set_error_handler(prior_handler);
+        double log_det = 0;
+        if (failed) {
+            gsl_matrix_free(factor);
+            factor = NULL;
+            log_det = GSL_NAN;
+        } else for (size_t i=0; i< factor->size1; i++)
+            log_det += 2*log(gsl_matrix_get(factor, i, i));
+        gsl_matrix_free(ms->cholesky);
+        ms->cholesky = factor;
+        ms->log_det = log_det;
+        gsl_matrix_free(ms->sigma);
+        ms->sigma = apop_matrix_copy(sigma);
+    }
+    #pragma omp flush
+    ms->sigma_hash = hash;
+    }
+    return ms;
+}
+
+/* The Cholesky decomposition failed. Use the determinant to sort out why, and to
+   match the return values of the pre-Cholesky version of this model. */
+static long double bad_sigma(apop_model *m){
+    double determinant = apop_matrix_determinant(m->parameters->matrix);
+    Apop_stopif(isnan(determinant) || determinant == 0, return GSL_NEGINF, //tell maximizers to look elsewhere.
          1, "the determinant of the given covariance is zero or NaN. Returning GSL_NEGINF."); 
-    Apop_stopif(determinant <= 0, return NAN, 0, "The determinant of the covariance matrix you gave me "
+    Apop_stopif(determinant < 0, return GSL_NAN, 0, "The determinant of the covariance matrix you gave me "
             "is negative, but a covariance matrix must always be positive semidefinite "
             "(and so have nonnegative determinant). Maybe run apop_matrix_to_positive_semidefinite?");
-    for (i=0; i< data->matrix->size1; i++){
-        gsl_vector_memcpy(x_minus_mu, Apop_rv(data, i));
-        gsl_vector_sub(x_minus_mu, m->parameters->vector);
-        ll += - x_prime_sigma_x(x_minus_mu, inverse) / 2;
+    Apop_stopif(determinant > 0, return GSL_NEGINF, 1, "the given covariance matrix is not positive definite. Returning GSL_NEGINF.");
+    return GSL_NEGINF;
+}
+
+#define Mvn_block 1024
+
+/* With Sigma = LL', the quadratic form for one observation is
+   (x-mu)' Sigma^{-1} (x-mu) = |L^{-1}(x-mu)|^2. Stack a block of centered rows into X,
+   and one triangular solve, Z L' = X, gives all of the L^{-1}(x-mu)s for the block
+   at once. */
+static long double apop_multinormal_ll(apop_data *data, apop_model * m){
+    Nullcheck_mpd(data, m, GSL_NAN);
+    apop_mvn_settings *ms = mvn_factor(m);
+    if (!ms->cholesky) return bad_sigma(m);
+    size_t n = data->matrix->size1, dimensions = data->matrix->size2;
+    Apop_stopif(dimensions != ms->cholesky->size1, return GSL_NAN, 0, "The data has %zu columns, "
+            "but the covariance matrix is %zu X %zu.", dimensions, ms->cholesky->size1, ms->cholesky->size1);
+    int block_ct = (n + Mvn_block - 1)/Mvn_block;
+    long double sum_sq = 0;
+    OMP_for_reduce(+:sum_sq, int b=0; b< block_ct; b++){
+        size_t start = b*Mvn_block;
+        size_t len = GSL_MIN(Mvn_block, n - start);
+        gsl_matrix *centered = gsl_matrix_alloc(len, dimensions);
+        gsl_matrix_const_view rows = gsl_matrix_const_submatrix(data->matrix, start, 0, len, dimensions);
+        gsl_matrix_memcpy(centered, &rows.matrix);
+        for (size_t i=0; i< len; i++)
+            gsl_vector_sub(Apop_mrv(centered, i), m->parameters->vector);
+        gsl_blas_dtrsm(CblasRight, CblasLower, CblasTrans, CblasNonUnit, 1, ms->cholesky, centered);
+        for (size_t i=0; i< len; i++){
+            double *row = gsl_matrix_ptr(centered, i, 0);
+            for (size_t j=0; j< dimensions; j++) sum_sq += row[j]*row[j];
+        }
+        gsl_matrix_free(centered);
     }
-    ll -= data->matrix->size1 * (log(2 * M_PI)* dimensions/2. + .5 * log(determinant));
-    gsl_matrix_free(inverse);
-    gsl_vector_free(x_minus_mu);
-    return ll;
+    return - sum_sq/2 - n * (log(2 * M_PI)* dimensions/2. + .5 * ms->log_det);
 }
 
 static double a_mean(gsl_vector * in){ return apop_vector_mean(in); }
@@ -61,28 +147,37 @@ static void multivariate_normal_estimate(apop_data * data, apop_model *p){
     apop_data_add_named_elmt(p->info, "log likelihood", apop_multinormal_ll(data, p));
 }
 
-/* \adoc RNG From <a href="http://cgm.cs.mcgill.ca/~luc/mbookindex.html">Devroye (1986)</a>, p 565.  */
+/* \adoc RNG From <a href="http://cgm.cs.mcgill.ca/~luc/mbookindex.html">Devroye (1986)</a>, p 565.
+The Cholesky factor of the covariance is calculated once and reused for all draws
+until the covariance changes. */
 static int mvnrng(double *out, gsl_rng *r, apop_model *eps){
-    apop_data *params = eps->parameters;
-    gsl_vector *v = gsl_vector_alloc(params->vector->size);
-    gsl_vector *dotted = gsl_vector_calloc(params->vector->size);
-    for (size_t i=0; i< params->vector->size; i++)
-        gsl_vector_set(v, i, gsl_ran_gaussian(r, 1));
-    gsl_matrix *copy  = apop_matrix_copy(params->matrix);
-        gsl_linalg_cholesky_decomp(copy); //returns upper and lower triangle; we want just one.
-    for (size_t i=0; i< copy->size1; i++)
-        for (size_t j=i+1; j< copy->size2; j++)
-            gsl_matrix_set(copy, i, j, 0);
-    gsl_blas_dgemv(CblasNoTrans, 1, copy, v, 0, dotted);
-    for (size_t i=0; i< params->vector->size; i++)
-        out[i]  = gsl_vector_get(dotted, i) + gsl_vector_get(params->vector,i);
-    gsl_vector_free(v);
-    gsl_vector_free(dotted);
-    gsl_matrix_free(copy);
+    apop_mvn_settings *ms = mvn_factor(eps);
+    Apop_stopif(!ms->cholesky, return 1, 0, "The covariance matrix is not positive definite, so I can't make draws.");
+    gsl_vector_view v = gsl_vector_view_array(out, eps->parameters->vector->size);
+    for (size_t i=0; i< v.vector.size; i++)
+        out[i] = gsl_ran_gaussian(r, 1);
+    gsl_blas_dtrmv(CblasLower, CblasNoTrans, CblasNonUnit, ms->cholesky, &v.vector);
+    gsl_vector_add(&v.vector, eps->parameters->vector);
+    return 0;
+}
+
+/* For \ref apop_model_draws: fill the block with standard Normals, then one triangular
+   multiply, X L', transforms every row at once. */
+static int mvn_draw_many(gsl_matrix *out, gsl_rng *r, apop_model *eps){
+    apop_mvn_settings *ms = mvn_factor(eps);
+    Apop_stopif(!ms->cholesky, return 1, 0, "The covariance matrix is not positive definite, so I can't make draws.");
+    Apop_stopif(out->size2 != ms->cholesky->size1, return 1, 0, "The output has %zu columns, "
+            "but the covariance matrix is %zu X %zu.", out->size2, ms->cholesky->size1, ms->cholesky->size1);
+    std_normal_block(out, r);
+    gsl_blas_dtrmm(CblasRight, CblasLower, CblasTrans, CblasNonUnit, 1, ms->cholesky, out);
+    for (size_t i=0; i< out->size1; i++)
+        gsl_vector_add(Apop_mrv(out, i), eps->parameters->vector);
     return 0;
 }
 
 static void mvn_prep(apop_data *d, apop_model *m){
+    apop_draw_many_vtable_add(mvn_draw_many, apop_multivariate_normal);
+    if (!Apop_settings_get_group(m, apop_mvn)) Apop_settings_add_group(m, apop_mvn);
     if (d && d->matrix)    m->dsize = d->matrix->size2; 
     else if (m->vsize > 0) m->dsize = m->vsize;
     apop_model_clear(d, m);
@@ -33,19 +33,32 @@ static long double positive_sigma_constraint(apop_data *data, apop_model *v){
     return apop_linear_constraint(v->parameters->vector, constraint, 1e-5);
 }
 
-//This just takes the sum of (x-mu)^2. Using gsl_ran_gaussian_pdf
-//would be to calculate log(exp((x-mu)^2)) == slow.
-static double apply_me(double x, void *mu){ return x - *(double *)mu; }
+//The log likelihood needs only the sum of (x-mu)^2, which in turn needs only these
+//sufficient statistics: n, the mean, and the sum of squared deviations from the mean
+//(via Welford's method). Using gsl_ran_gaussian_pdf would be to calculate
+//log(exp((x-mu)^2)) == slow.
+static void normal_stats(apop_data *d, double *s){
+    long double n = 0, mean = 0, ssq = 0;
+    Loop_over_elmts(d, x,
+        n++;
+        double delta = x - mean;
+        mean += delta/n;
+        ssq += delta*(x - mean);
+    )
+    s[0] = n; s[1] = mean; s[2] = ssq;
+}
 
-static double apply_me2(double x, void *mu){ return gsl_pow_2(x - *(double *)mu); }
+//Σ(x-μ)² = Σ(x-mean)² + n(mean-μ)²
+#define Sum_sq_about(s, mu) ((s)[2] + (s)[0]*gsl_pow_2((s)[1] - (mu)))
 
 static long double normal_log_likelihood(apop_data *d, apop_model *params){
     Nullcheck_mpd(d, params, GSL_NAN);
-    Get_vmsizes(d)
+    double s[8];
+    suff_stats(d, params, normal_stats, s);
     double mu = gsl_vector_get(params->parameters->vector,0);
     double sd = gsl_vector_get(params->parameters->vector,1);
-    long double ll  = -apop_map_sum(d, .fn_dp = apply_me2, .param = &mu)/(2*gsl_pow_2(sd));
-    ll -= tsize*((M_LNPI+M_LN2)/2+log(sd));
+    long double ll  = -Sum_sq_about(s, mu)/(2*gsl_pow_2(sd));
+    ll -= s[0]*((M_LNPI+M_LN2)/2+log(sd));
 	return ll;
 }
 
@@ -107,14 +120,15 @@ static long double normal_cdf(apop_data *d, apop_model *params){
 
 static void normal_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *params){    
     Nullcheck_mpd(d, params, )
-    Get_vmsizes(d)
+    double s[8];
+    suff_stats(d, params, normal_stats, s);
     double mu = gsl_vector_get(params->parameters->vector,0),
            sd = gsl_vector_get(params->parameters->vector,1),
            dll, sll;
-    dll = apop_map_sum(d, .fn_dp = apply_me, .param=&mu);
-    sll = apop_map_sum(d, .fn_dp = apply_me2, .param=&mu);
+    dll = s[0]*(s[1] - mu);
+    sll = Sum_sq_about(s, mu);
     gsl_vector_set(gradient, 0, dll/gsl_pow_2(sd));
-    gsl_vector_set(gradient, 1, sll/gsl_pow_3(sd)- tsize /sd);
+    gsl_vector_set(gradient, 1, sll/gsl_pow_3(sd)- s[0] /sd);
 }
 
 /* \adoc predict Returns the mean, regardless of the input data you give (including
@@ -138,9 +152,46 @@ static int normal_rng(double *out, gsl_rng *r, apop_model *p){
     return 0;
 }
 
+/* For \ref apop_model_draws: a block of standard Normals via \c std_normal_block, which
+   uses both halves of each Box-Muller pair, then scale and shift. */
+static int normal_draw_many(gsl_matrix *out, gsl_rng *r, apop_model *p){
+    std_normal_block(out, r);
+    gsl_matrix_scale(out, p->parameters->vector->data[1]);
+    gsl_matrix_add_constant(out, p->parameters->vector->data[0]);
+    return 0;
+}
+
+/* For the EM routine in \ref apop_mixture: the log likelihood of each element of a
+   single column of data, and the estimate with each element weighted by its odds of
+   belonging to this component. */
+static void normal_row_lls(gsl_vector const *x, gsl_vector *out, apop_model *m){
+    double mu = m->parameters->vector->data[0], sd = m->parameters->vector->data[1];
+    double base = (M_LNPI+M_LN2)/2 + log(sd);
+    OMP_for (size_t i=0; i< x->size; i++)
+        gsl_vector_set(out, i, -gsl_pow_2(gsl_vector_get(x, i) - mu)/(2*gsl_pow_2(sd)) - base);
+}
+
+static void normal_weighted_estimate(gsl_vector const *x, gsl_vector const *w, apop_model *m){
+    long double sw = 0, sx = 0, ss = 0;
+    for (size_t i=0; i< x->size; i++){
+        sw += gsl_vector_get(w, i);
+        sx += gsl_vector_get(w, i) * gsl_vector_get(x, i);
+    }
+    if (!(sw > 0)) return; //No weight on any element; leave the parameters be.
+    double mean = sx/sw;
+    for (size_t i=0; i< x->size; i++)
+        ss += gsl_vector_get(w, i) * gsl_pow_2(gsl_vector_get(x, i) - mean);
+    m->parameters->vector->data[0] = mean;
+    m->parameters->vector->data[1] = sqrt(ss/sw);
+}
+
 static void normal_prep(apop_data *data, apop_model *params){
     apop_score_vtable_add(normal_dlog_likelihood, apop_normal);
     apop_predict_vtable_add(normal_predict, apop_normal);
+    apop_suff_stats_vtable_add(normal_stats, apop_normal);
+    apop_draw_many_vtable_add(normal_draw_many, apop_normal);
+    apop_row_lls_vtable_add(normal_row_lls, apop_normal);
+    apop_weighted_estimate_vtable_add(normal_weighted_estimate, apop_normal);
     apop_model_clear(data, params);
 }
 
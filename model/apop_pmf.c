@@ -46,6 +46,13 @@ apop_model *my_pmf = apop_estimate(in_data, apop_pmf);
 \li If the \c weights element is \c NULL, then I assume that all rows of the data set are
 equally probable.
 \li If the \c weights are present but sum to a not-finite value, the model's \c error element is set to \c 'w' when the estimation is run, and a warning printed.
+\li The first call to the \c p or \c cdf method builds a hash index of the rows of the data
+set, so each later lookup takes about the same time no matter how many rows the PMF
+has. The index is rebuilt if the model's data set is replaced or changes length (as
+after \ref apop_data_pmf_compress), or if a lookup finds that the rows were rearranged
+(as after \ref apop_data_sort) or modified in place. A lookup that finds nothing checks
+a fingerprint of the data before concluding that the observation isn't there, so that
+lookup costs one pass over the data.
 
 \adoc Input_format   One observation per row, with coordinates in the \c vector, \c matrix, and/or \c text, 
                     and the density at that point in the \c weights. If <tt>weights==NULL</tt>, all observations are equiprobable.
@@ -55,22 +62,58 @@ equally probable.
 */
 
 #include "apop_internal.h"
+#include <stdint.h>
+
+/* A hash table of the rows of the PMF's data, so the p and cdf methods can find an
+   observation in constant time. Slots hold row numbers (or -1 if empty) and each row's
+   full hash, so most non-matching slots are skipped without comparing the rows. */
+struct apop_pmf_index {
+    apop_data *data;      //The data set indexed, and its row count.
+    size_t rows;          //If either changes, I rebuild.
+    uint64_t fingerprint; //A hash of every row, to catch in-place edits.
+    size_t mask;          //The table size is mask+1, a power of two.
+    int *slots;
+    uint64_t *hashes;
+    int refct;            //The settings group holds one reference; each reader holds another.
+};
+
+static void pmf_index_free(struct apop_pmf_index *ix){
+    if (!ix) return;
+    free(ix->slots);
+    free(ix->hashes);
+    free(ix);
+}
+
+//Drop one reference; the last one out frees the index.
+static void pmf_index_release(struct apop_pmf_index *ix){
+    if (!ix) return;
+    int last;
+    OMP_critical(pmf_index)
+    last = !--ix->refct;
+    if (last) pmf_index_free(ix);
+}
 
 Apop_settings_copy(apop_pmf,
     (*out->cmf_refct)++;
+    out->index = NULL;
 )
 
 Apop_settings_free(apop_pmf,
     if (!--*in->cmf_refct) {
         gsl_vector_free(in->cmf);
+        gsl_vector_free(in->alias_prob);
+        free(in->alias);
         free(in->cmf_refct);
     }
+    pmf_index_release(in->index);
 ) 
 
 Apop_settings_init(apop_pmf,
     Apop_varad_set(draw_index, 'n')
+    Apop_varad_set(draw_method, 'c')
     out->cmf_refct = calloc(1, sizeof(int));
     (*out->cmf_refct)++;
+    out->index = NULL;
 )
 
 
@@ -89,23 +132,100 @@ static void estim (apop_data *d, apop_model *out){
     }
 }
 
+/* Prep attaches the settings group, but a model whose data was set by hand may not have
+   one. Adding a group reallocates the model's list of groups, so the search has to be
+   under the same lock as the add. */
+static apop_pmf_settings *get_settings(apop_model *m){
+    apop_pmf_settings *settings;
+    OMP_critical(pmfsetup)
+    {
+        settings = Apop_settings_get_group(m, apop_pmf);
+        if (!settings) settings = Apop_model_add_group(m, apop_pmf);
+    }
+    return settings;
+}
+
+/* Draws check for the CMF or alias table without a lock. So these fill in the table,
+   flush, and only then store the pointer the readers check; a reader that sees the
+   pointer flushes before reading the table (or the alias list). Call these from
+   inside the pmfsetuptwo critical section. */
 static void setup_cmf(apop_model *m){
     //already assumed a weights vector in the data
     apop_pmf_settings *settings = Apop_settings_get_group(m, apop_pmf);
     size_t maxsize = m->data->weights->size;
-    settings->cmf = gsl_vector_alloc(maxsize);
-    Apop_stopif(!settings->cmf, m->error='a'; return,
+    gsl_vector *cdf = gsl_vector_alloc(maxsize);
+    Apop_stopif(!cdf, m->error='a'; return,
             0, "Allocation error setting up the CMF.");
-    gsl_vector *cdf = settings->cmf; //alias.
     cdf->data[0] = m->data->weights->data[0];
     for (int i=1; i< maxsize; i++)
         cdf->data[i] = m->data->weights->data[i] + cdf->data[i-1];
     //Now make sure the last entry is one.
-    Apop_stopif(cdf->data[maxsize-1]==0 || isnan(cdf->data[maxsize-1]), m->error='f'; return,
-            0, "Bad density in the PMF.");
-    gsl_vector_scale(cdf, 1./cdf->data[maxsize-1]);
-    Apop_stopif(!isfinite(cdf->data[maxsize-1]), m->error='f';  return,
-            0, "Bad density in the PMF.");
+    double total = cdf->data[maxsize-1];
+    Apop_stopif(total==0 || isnan(total), m->error='f', 0, "Bad density in the PMF.");
+    if (total!=0 && !isnan(total)){
+        gsl_vector_scale(cdf, 1./total);
+        Apop_stopif(!isfinite(cdf->data[maxsize-1]), m->error='f', 0, "Bad density in the PMF.");
+    }
+    #pragma omp flush
+    settings->cmf = cdf;
+}
+
+/* Vose's version of Walker's alias method. Each row gets a slot of width 1/n. A row
+   with less than average weight fills only part of its slot, and the rest of the slot
+   goes to its alias, a row with more than average weight, whose excess shrinks
+   accordingly. Repeat until every slot is full.
+
+   To draw: one uniform draw u in [0, n) picks slot floor(u); keep that row if the
+   fractional part of u is below prob[slot], else take its alias. Also used by apop_mixture.c.
+   Returns 'f' for bad weights, 'a' for allocation trouble, zero on success. */
+char alias_table(gsl_vector const *w, gsl_vector **prob_out, size_t **alias_out){
+    size_t n = w->size;
+    double total = apop_sum(w);
+    Apop_stopif(!(total > 0) || !isfinite(total), return 'f', 0, "Bad total weight (%g) for the alias table.", total);
+    gsl_vector *prob = gsl_vector_alloc(n);
+    size_t *alias = malloc(sizeof(size_t)*n);
+    size_t *small = malloc(sizeof(size_t)*n), *large = malloc(sizeof(size_t)*n);
+    Apop_stopif(!prob || !alias || !small || !large, gsl_vector_free(prob);
+                free(alias); free(small); free(large); return 'a',
+            0, "Allocation error setting up the alias table.");
+    size_t small_ct = 0, large_ct = 0;
+    for (size_t i=0; i< n; i++){
+        double wi = gsl_vector_get(w, i);
+        Apop_stopif(wi < 0, gsl_vector_free(prob);
+                free(alias); free(small); free(large); return 'f',
+            0, "Negative weight (%g) in row %zu.", wi, i);
+        prob->data[i] = wi * n / total;
+        alias[i] = i;
+        if (prob->data[i] < 1) small[small_ct++] = i;
+        else                   large[large_ct++] = i;
+    }
+    while (small_ct && large_ct){
+        size_t s = small[--small_ct], l = large[large_ct-1];
+        alias[s] = l;
+        prob->data[l] -= 1 - prob->data[s];
+        if (prob->data[l] < 1){
+            large_ct--;
+            small[small_ct++] = l;
+        }
+    }
+    //Anything left over is within round-off of a full slot.
+    while (large_ct) prob->data[large[--large_ct]] = 1;
+    while (small_ct) prob->data[small[--small_ct]] = 1;
+    free(small); free(large);
+    *prob_out = prob;
+    *alias_out = alias;
+    return 0;
+}
+
+static void setup_alias(apop_model *m){
+    apop_pmf_settings *settings = Apop_settings_get_group(m, apop_pmf);
+    gsl_vector *prob;
+    size_t *alias;
+    char err = alias_table(m->data->weights, &prob, &alias);
+    Apop_stopif(err, m->error=err; return, 0, "Couldn't set up the alias table for the PMF.");
+    settings->alias = alias;
+    #pragma omp flush
+    settings->alias_prob = prob;
 }
 
 /* \adoc    RNG  Return the data in a random row of the PMF's data set. If there is a
@@ -123,31 +243,60 @@ from text data.
 
 \li  The first time you draw from a PMF with uneven weights, I will generate a
 vector tallying the cumulative mass. Subsequent draws will have no computational
-overhead. Because the  vector is built using the data on the first call to this or
+overhead beyond a binary search of that vector. Because the  vector is built using the data on the first call to this or
 the \c cdf method, do not rearrange or modify the data after the first call. I.e.,
 if you choose to use \ref apop_data_sort or \ref apop_data_pmf_compress on your data,
 do it before the first draw or CDF calculation.
 
+\li If you set \c draw_method to \c 'a', e.g.,
+
+\code
+Apop_settings_add(your_model, apop_pmf, draw_method, 'a');
+\endcode
+
+then the first draw will instead set up an alias table (Walker's alias method, as
+refined by Vose), taking time proportional to the number of rows. After that, each draw
+takes constant time, no matter how many rows the PMF has. The same caveat applies:
+the table is built from the weights at the first draw, so don't modify them afterward.
+Draws made this way are different from those made via the CMF using the same RNG,
+though both have the same distribution.
+
 \exception m->error='f' There is zero or NaN density in the CMF. I set the model's \c error element to \c 'f' and set <tt>out=NAN</tt>.
 \exception m->error='a' Allocation error. I set the model's \c error element to \c 'a' and set <tt>out=NAN</tt>. Maybe try \ref apop_data_pmf_compress first?
 */
 static int draw (double *out, gsl_rng *r, apop_model *m){
     Nullcheck_m(m, 1) Nullcheck_d(m->data, 1)
-    apop_pmf_settings *settings = Apop_settings_get_group(m, apop_pmf);
-    #pragma omp critical (pmfsetup)
-    if (!settings) settings = Apop_model_add_group(m, apop_pmf);
+    apop_pmf_settings *settings = get_settings(m);
     Get_vmsizes(m->data) //maxsize
     size_t current; 
     if (!m->data->weights) //all rows are equiprobable
         current = gsl_rng_uniform(r)* (maxsize-1);
-    else {
+    else if (settings->draw_method == 'a'){
+        gsl_vector *prob = settings->alias_prob;
+        #pragma omp flush
+        if (!prob){
+            #pragma omp critical (pmfsetuptwo)
+            if (!settings->alias_prob) setup_alias(m);
+            prob = settings->alias_prob;
+        }
+        Apop_stopif(!prob || m->error=='f' || m->error=='a', *out=GSL_NAN; return 1, 0, "Unable to set up the alias table for the PMF.");
+        //One uniform draw picks the slot, and its fractional part picks the row or its alias.
+        double u = gsl_rng_uniform(r) * m->data->weights->size;
+        current = u;
+        if (u - current >= prob->data[current]) current = settings->alias[current];
+    } else {
         size_t size = m->data->weights->size;
-        #pragma omp critical (pmfsetuptwo)
-        if (!settings->cmf) setup_cmf(m);
-        Apop_stopif(m->error=='f', *out=GSL_NAN; return 1, 0, "Zero or NaN density in the PMF.");
+        gsl_vector *cmf = settings->cmf;
+        #pragma omp flush
+        if (!cmf){
+            #pragma omp critical (pmfsetuptwo)
+            if (!settings->cmf) setup_cmf(m);
+            cmf = settings->cmf;
+        }
+        Apop_stopif(!cmf || m->error=='f', *out=GSL_NAN; return 1, 0, "Zero or NaN density in the PMF.");
         double draw = gsl_rng_uniform(r);
         //do a binary search for where draw is in the CDF.
-        double *cdf = settings->cmf->data; //alias.
+        double *cdf = cmf->data; //alias.
         size_t top = size-1, bottom = 0; 
         current = (top+bottom)/2.;
         if (current==0){//array of size one or two
@@ -222,18 +371,125 @@ static int are_equal(apop_data *left, apop_data *right){
     return 1;
 }
 
-static int find_in_data(apop_data *searchme, apop_data *findme){//findme is one row tall.
-    Get_vmsizes(searchme)
-    for(int i=0; i < GSL_MAX(vsize, GSL_MAX(searchme->textsize[0], msize1)); i++)
-        if (are_equal(findme, Apop_r(searchme, i)))
-            return i;
-    return -1;
+static size_t row_count(apop_data *d){
+    Get_vmsizes(d) //maxsize
+    return maxsize;
+}
+
+//The splitmix64 finalizer, so keys that differ only in a few bits land far apart.
+static uint64_t mix(uint64_t x){
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t hash_double(uint64_t h, double x){
+    if (x == 0) x = 0;               //are_equal says -0 == 0 and NaN == NaN,
+    if (gsl_isnan(x)) x = GSL_NAN;   //so they have to hash alike.
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(double));
+    return mix(h ^ bits);
+}
+
+//The hash of the elements that are_equal compares, so equal rows hash equal.
+static uint64_t row_hash(apop_data *row){ //row is one row tall.
+    uint64_t h = 0;
+    if (row->vector) h = hash_double(h, *row->vector->data);
+    if (row->matrix)
+        for (int i=0; i< row->matrix->size2; i++)
+            h = hash_double(h, apop_data_get(row, 0, i));
+    for (int i=0; i< row->textsize[1]; i++){
+        uint64_t str = 14695981039346656037ULL; //FNV-1a
+        for (char *c = row->text[0][i]; *c; c++) str = (str ^ (unsigned char)*c) * 1099511628211ULL;
+        h = mix(h ^ str);
+    }
+    return h;
+}
+
+static struct apop_pmf_index *pmf_index_build(apop_data *data){
+    size_t rows = row_count(data), size = 2;
+    while (size < 2*rows) size *= 2;
+    struct apop_pmf_index *ix = malloc(sizeof(struct apop_pmf_index));
+    *ix = (struct apop_pmf_index){.data=data, .rows=rows, .mask=size-1, .refct=1,
+                    .slots=malloc(sizeof(int)*size), .hashes=malloc(sizeof(uint64_t)*size)};
+    for (size_t i=0; i< size; i++) ix->slots[i] = -1;
+    for (int i=0; i< rows; i++){
+        apop_data *r = Apop_r(data, i);
+        uint64_t h = row_hash(r);
+        ix->fingerprint = mix(ix->fingerprint ^ h);
+        size_t s = h & ix->mask;
+        for ( ; ix->slots[s] != -1; s = (s+1) & ix->mask)
+            if (ix->hashes[s] == h && are_equal(r, Apop_r(data, ix->slots[s]))) break;
+        if (ix->slots[s] == -1){ //else it's a duplicate; keep the first, as a linear search would.
+            ix->slots[s] = i;
+            ix->hashes[s] = h;
+        }
+    }
+    return ix;
+}
+
+/* Returns the row number, or -1 if the observation isn't in the data. Returns -2 if
+   the slot for this observation's hash holds a row that no longer matches, meaning that
+   the data was rearranged after the index was built. */
+static int pmf_index_find(struct apop_pmf_index *ix, apop_data *findme){
+    uint64_t h = row_hash(findme);
+    int stale = 0;
+    for (size_t s = h & ix->mask; ix->slots[s] != -1; s = (s+1) & ix->mask)
+        if (ix->hashes[s] == h){
+            if (are_equal(findme, Apop_r(ix->data, ix->slots[s]))) return ix->slots[s];
+            stale = 1;
+        }
+    return stale ? -2 : -1;
+}
+
+//The fingerprint pmf_index_build would give this data set.
+static uint64_t data_fingerprint(apop_data *data){
+    uint64_t fp = 0;
+    for (size_t i=0, rows=row_count(data); i< rows; i++) fp = mix(fp ^ row_hash(Apop_r(data, i)));
+    return fp;
+}
+
+/* Returns the settings group's index, with a reference the caller gives back via
+   pmf_index_release. Rebuilds the index if it's for another data set, or if it's the
+   stale one the caller just found wanting, unless another thread already replaced it.
+   A replaced index lives until its last reader releases it. */
+static struct apop_pmf_index *pmf_index_get(apop_pmf_settings *settings, apop_data *data,
+                                                struct apop_pmf_index *stale){
+    struct apop_pmf_index *out, *retired = NULL;
+    OMP_critical(pmf_index)
+    {
+    struct apop_pmf_index *ix = settings->index;
+    if (!ix || ix == stale || ix->data != data || ix->rows != row_count(data)){
+        if (ix && !--ix->refct) retired = ix;
+        settings->index = pmf_index_build(data);
+    }
+    out = settings->index;
+    out->refct++;
+    }
+    pmf_index_free(retired);
+    return out;
+}
+
+/* Find the first row of the model's data matching findme, or return -1. The caller
+   holds a reference to *ix, which is swapped for a fresh index if this one turns
+   out to be stale: the slot found holds a row that no longer matches, or there's no
+   match and the data's fingerprint has changed since the index was built. */
+static int find_row(apop_model *m, apop_pmf_settings *settings, struct apop_pmf_index **ix,
+                                                                        apop_data *findme){
+    int out = pmf_index_find(*ix, findme);
+    if (out == -2 || (out == -1 && data_fingerprint(m->data) != (*ix)->fingerprint)){
+        struct apop_pmf_index *stale = *ix;
+        *ix = pmf_index_get(settings, m->data, stale);
+        pmf_index_release(stale);
+        out = pmf_index_find(*ix, findme);
+    }
+    return out < 0 ? -1 : out;
 }
 
 static long double pmf_p(apop_data *d, apop_model *m){
-    apop_pmf_settings *settings = Apop_settings_get_group(m, apop_pmf);
     Nullcheck_d(d, GSL_NAN) 
     Nullcheck_m(m, GSL_NAN) 
+    apop_pmf_settings *settings = get_settings(m);
     int model_pmf_length;
     {
         Get_vmsizes(m->data);//maxsize
@@ -241,13 +497,15 @@ static long double pmf_p(apop_data *d, apop_model *m){
     }
     Get_vmsizes(d)//maxsize
     long double p = 1;
+    struct apop_pmf_index *ix = pmf_index_get(settings, m->data, NULL);
     for (int i=0; i< maxsize; i++){
-        int elmt = find_in_data(m->data, Apop_r(d, i));
-        if (elmt == -1) return 0; //Can't find one observation: prob=0;
+        int elmt = find_row(m, settings, &ix, Apop_r(d, i));
+        if (elmt == -1) {p = 0; break;} //Can't find one observation: prob=0;
         p *= m->data->weights
                  ? m->data->weights->data[elmt] /settings->total_weight 
                  : 1./model_pmf_length; //no weights means any known event is equiprobable
     }
+    pmf_index_release(ix);
     return p;
 }
 
@@ -269,15 +527,22 @@ your data, do it before the first draw or CDF calculation.
  */
 static long double pmf_cmf(apop_data *d, apop_model *m){
     Get_vmsizes(m->data); //maxsize
-    int elmt = find_in_data(m->data, Apop_r(d, 0));
+    apop_pmf_settings *settings = get_settings(m);
+    struct apop_pmf_index *ix = pmf_index_get(settings, m->data, NULL);
+    int elmt = find_row(m, settings, &ix, Apop_r(d, 0));
+    pmf_index_release(ix);
     if (elmt == -1) return 0; //Can't find one observation: prob=0;
     if (!m->data->weights) return (elmt+0.0)/maxsize;
     else {
-        apop_pmf_settings *settings = Apop_settings_get_group(m, apop_pmf);
-        if (!settings) settings = Apop_model_add_group(m, apop_pmf);
-        if (!settings->cmf) setup_cmf(m);
-        Apop_stopif(m->error=='f', return GSL_NAN, 0, "Zero or NaN density in the PMF.");
-        gsl_vector_view v = gsl_vector_subvector(settings->cmf, 0, elmt+1);
+        gsl_vector *cmf = settings->cmf;
+        #pragma omp flush
+        if (!cmf){
+            #pragma omp critical (pmfsetuptwo)
+            if (!settings->cmf) setup_cmf(m);
+            cmf = settings->cmf;
+        }
+        Apop_stopif(!cmf || m->error=='f', return GSL_NAN, 0, "Zero or NaN density in the PMF.");
+        gsl_vector_view v = gsl_vector_subvector(cmf, 0, elmt+1);
         return apop_sum(&v.vector);
     }
 }
@@ -285,6 +550,7 @@ static long double pmf_cmf(apop_data *d, apop_model *m){
 static void pmf_print(apop_model *est, FILE *out){ apop_data_print(est->data, .output_pipe=out); }
 
 static void pmf_prep(apop_data * data, apop_model *model){
+    if (!Apop_settings_get_group(model, apop_pmf)) Apop_model_add_group(model, apop_pmf);
     if (model->data) return; //already prepped, and reprep is a no-op.
     apop_model_print_vtable_add(pmf_print, apop_pmf);
     Get_vmsizes(data) //msize2, firstcol
@@ -346,22 +612,18 @@ apop_data *apop_data_pmf_compress(apop_data *in){
         gsl_vector_set_all(in->weights, 1);
     }
     if (maxsize==1) return in; //optional check.
+    //The index maps each row to the first row equal to it, so one pass merges every
+    //duplicate into its first appearance, in the same order as a pairwise search would.
+    struct apop_pmf_index *ix = pmf_index_build(in);
     int *cutme = calloc(maxsize, sizeof(int));
-    int not_done = 1; //if we do a full j-loop and everything is to be cut, we're done.
-    for (int i=0; i< maxsize && not_done; i++){
-        if (cutme[i]) continue;
-        Apop_row(in, i, subject);
-        not_done = 0;
-        for (int j=i+1; j< maxsize; j++){
-            if (cutme[j]) continue;
-            not_done = 1;
-            Apop_row(in, j, compare_me);
-            if (are_equal(subject, compare_me)){
-                *gsl_vector_ptr(subject->weights, 0) += gsl_vector_get(compare_me->weights, 0);
-                cutme[j]=1;
-            }
+    for (int i=0; i< maxsize; i++){
+        int first = pmf_index_find(ix, Apop_r(in, i));
+        if (first != i){
+            *gsl_vector_ptr(in->weights, first) += gsl_vector_get(in->weights, i);
+            cutme[i]=1;
         }
     }
+    pmf_index_free(ix);
     apop_data_rm_rows(in, cutme);
     free(cutme);
     return in;
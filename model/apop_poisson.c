@@ -11,20 +11,27 @@
 
 #include "apop_internal.h"
 
-static double apply_me(double x, void *in){
-    if (x < 0) return -INFINITY;
-    if ((x - (int)x) > 1e-4) return -INFINITY;
-    double *ln_l = in;
-    return x==0 ? 0 : *ln_l *x - gsl_sf_lngamma(x+1);
+//Sufficient statistics: n, Σx, Σ ln(x!), and the count of values that aren't nonnegative integers.
+static void poisson_stats(apop_data *d, double *s){
+    long double n = 0, sum = 0, sum_ln_fact = 0, bad = 0;
+    Loop_over_elmts(d, x,
+        n++;
+        if (x < 0 || (x - (int)x) > 1e-4) bad++;
+        else if (x) {
+            sum += x;
+            sum_ln_fact += gsl_sf_lngamma(x+1);
+        }
+    )
+    s[0] = n; s[1] = sum; s[2] = sum_ln_fact; s[3] = bad;
 }
 
 static long double poisson_log_likelihood(apop_data *d, apop_model * p){
     Nullcheck_mpd(d, p, GSL_NAN)
-    Get_vmsizes(d) //tsize
+    double s[8];
+    suff_stats(d, p, poisson_stats, s);
+    if (s[3]) return -INFINITY;
     double lambda = apop_data_get(p->parameters);
-    double ln_l = log(lambda);
-    double ll = apop_map_sum(d, .fn_dp = apply_me, .param=&ln_l);
-    return ll - tsize*lambda;
+    return log(lambda)*s[1] - s[2] - s[0]*lambda;
 }
 
 static double data_mean(apop_data *d){
@@ -64,11 +71,11 @@ static long double positive_beta_constraint(apop_data *returned_beta, apop_model
 }
 
 static void poisson_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *p){
-    Get_vmsizes(d) //tsize
     Nullcheck_mpd(d, p, )
+    double s[8];
+    suff_stats(d, p, poisson_stats, s);
     double     lambda = apop_data_get(p->parameters);
-    gsl_matrix *data = d->matrix;
-    double     d_a = apop_matrix_sum(data)/lambda - tsize;
+    double     d_a = s[1]/lambda - s[0];
     gsl_vector_set(gradient,0, d_a);
 }
 
@@ -78,8 +85,69 @@ static int poisson_rng(double *out, gsl_rng* r, apop_model *p){
     return 0;
 }
 
+#define Poisson_table_max 30
+#define Poisson_table_len 128
+
+/* For \ref apop_model_draws. For small lambda, build the CDF once for the block and draw by
+   inversion, extending the PMF recursion past the table for the rare draw in the far
+   tail. For large lambda, the GSL's rejection method is faster than the walk up the CDF. */
+static int poisson_draw_many(gsl_matrix *out, gsl_rng *r, apop_model *p){
+    double lambda = *p->parameters->vector->data;
+    Apop_stopif(!(lambda >= 0), return 1, 0, "lambda=%g, but it needs to be nonnegative.", lambda);
+    if (lambda > Poisson_table_max){
+        for (size_t i=0; i< out->size1; i++)
+            gsl_matrix_set(out, i, 0, gsl_ran_poisson(r, lambda));
+        return 0;
+    }
+    double pmf[Poisson_table_len], cdf[Poisson_table_len];
+    pmf[0] = cdf[0] = exp(-lambda);
+    int len = 1;
+    for ( ; len < Poisson_table_len && cdf[len-1] < 1; len++){
+        pmf[len] = pmf[len-1]*lambda/len;
+        cdf[len] = cdf[len-1] + pmf[len];
+    }
+    for (size_t i=0; i< out->size1; i++){
+        double u = gsl_rng_uniform(r);
+        int k = 0;
+        while (k < len && u > cdf[k]) k++;
+        if (k == len){ //off the table
+            double pk = pmf[len-1], ck = cdf[len-1];
+            for (k = len-1; u > ck && pk > 0; ){
+                k++;
+                pk *= lambda/k;
+                ck += pk;
+            }
+        }
+        gsl_matrix_set(out, i, 0, k);
+    }
+    return 0;
+}
+
+//For the EM routine in \ref apop_mixture: per-element log likelihoods and the weighted estimate of one column.
+static void poisson_row_lls(gsl_vector const *x, gsl_vector *out, apop_model *m){
+    double lambda = *m->parameters->vector->data, ln_l = log(lambda);
+    OMP_for (size_t i=0; i< x->size; i++){
+        double xi = gsl_vector_get(x, i);
+        gsl_vector_set(out, i, (xi < 0 || (xi - (int)xi) > 1e-4) ? -INFINITY
+                                   : xi*ln_l - lambda - gsl_sf_lngamma(xi+1));
+    }
+}
+
+static void poisson_weighted_estimate(gsl_vector const *x, gsl_vector const *w, apop_model *m){
+    long double sw = 0, sx = 0;
+    for (size_t i=0; i< x->size; i++){
+        sw += gsl_vector_get(w, i);
+        sx += gsl_vector_get(w, i) * gsl_vector_get(x, i);
+    }
+    if (sw > 0) *m->parameters->vector->data = sx/sw;
+}
+
 static void poisson_prep(apop_data *data, apop_model *params){
     apop_score_vtable_add(poisson_dlog_likelihood, apop_poisson);
+    apop_suff_stats_vtable_add(poisson_stats, apop_poisson);
+    apop_draw_many_vtable_add(poisson_draw_many, apop_poisson);
+    apop_row_lls_vtable_add(poisson_row_lls, apop_poisson);
+    apop_weighted_estimate_vtable_add(poisson_weighted_estimate, apop_poisson);
     apop_model_clear(data, params);
 }
 
@@ -14,89 +14,78 @@ typedef struct{
     int len;
 } wishartstruct_t;
 
+/* Both matrices are symmetric, so tr(V^{-1}W) is the sum of their elementwise
+   product, and |W| comes from the diagonal of W's Cholesky factor. */
 static double one_wishart_row(gsl_vector *in, void *ws_in){
     wishartstruct_t *ws = ws_in;
-    gsl_matrix *invparams_dot_data = gsl_matrix_alloc(ws->len, ws->len);
     apop_data *square= apop_data_alloc(ws->len, ws->len);
     apop_data_unpack(in, square);
-    double datadet = apop_matrix_determinant(square->matrix);
-    assert(datadet);
-
-    gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1, ws->paraminv, square->matrix, 0, invparams_dot_data);   
-    gsl_vector_view diag = gsl_matrix_diagonal(invparams_dot_data);
-    double trace = apop_sum(&diag.vector);
-    gsl_matrix_free(invparams_dot_data);
+    double trace = 0;
+    for (int i=0; i< ws->len; i++)
+        for (int j=0; j< ws->len; j++)
+            trace += gsl_matrix_get(ws->paraminv, i, j) * gsl_matrix_get(square->matrix, i, j);
+
+    gsl_error_handler_t *prior_handler = gsl_set_error_handler_off();
+    int failed = gsl_linalg_cholesky_decomp(square->matrix);
+    gsl_set_error_handler(prior_handler);
+    double log_datadet = 0;
+    for (int i=0; !failed && i< ws->len; i++)
+        log_datadet += 2*log(gsl_matrix_get(square->matrix, i, i));
     apop_data_free(square);
-    double out= log(datadet) * (ws->df - ws->len -1.)/2. - trace*ws->df/2.;
+    Apop_stopif(failed, return GSL_NEGINF, 1, "An observation is not positive definite.");
+    double out= log_datadet * (ws->df - ws->len -1.)/2. - trace*ws->df/2.;
     assert(isfinite(out));
     return out;
 }
 
+/* The factor of the parameter matrix comes from the cache that \ref apop_multivariate_normal
+   uses, so its log determinant is free, and the inverse is one triangular inversion. */
 static long double wishart_ll(apop_data *in, apop_model *m){
     Nullcheck_mpd(in, m, GSL_NAN);
+    apop_mvn_settings *ms = mvn_factor(m);
+    if (!ms->cholesky || ms->log_det < log(1e-3)) return GSL_NEGINF;
     wishartstruct_t ws = {
-            .paraminv = apop_matrix_inverse(m->parameters->matrix),
+            .paraminv = apop_matrix_copy(ms->cholesky),
             .len = sqrt(in->matrix->size2),
             .df = m->parameters->vector->data[0]
         };
-    double paramdet = apop_matrix_determinant(m->parameters->matrix);
-    if (paramdet < 1e-3) return GSL_NEGINF;
+    gsl_linalg_cholesky_invert(ws.paraminv);
     double ll =  apop_map_sum(in, .fn_vp = one_wishart_row, .param=&ws, .part='r');
     double k = log(ws.df)*ws.df/2.;
     k -= M_LN2 * ws.len* ws.df/2.;
-    k -= log(paramdet) * ws.df/2.;
+    k -= ms->log_det * ws.df/2.;
     k -= apop_multivariate_lngamma(ws.df/2., ws.len);
+    gsl_matrix_free(ws.paraminv);
     return ll + k*in->matrix->size1;
 }
 
+/* Via the Bartlett decomposition: with V=LL', let A be lower triangular, with
+   A_{ii}^2 ~ Chi^2(n-i) and A_{ij} ~ N(0,1) below the diagonal. Then (LA)(LA)' ~
+   Wishart(n, V). That takes d(d+1)/2 random numbers per draw, and L is cached until
+   the parameters change. See also AS 53 (Applied Statistics, 1972). */
 static int apop_wishart_draw(double *out, gsl_rng *r, apop_model *m){
-    /*
-Translated from the Fortran by BK. Fortran comments:
-
-C          SUBROUTINE DWSHRT(D, N, NP, NNP, SB, SA)
-C
-C       ALGORITHM AS 53  APPL. STATIST. (1972) VOL.21, NO.3
-C
-C     Wishart variate generator.  On output, SA is an upper-triangular
-C     matrix of size NP * NP [...]
-C     whose elements have a Wishart(N, SIGMA) distribution.
-*/
-    Nullcheck_mp(m, );
+    Nullcheck_mp(m, 1);
     int np = m->parameters->matrix->size1;
-    int n = m->parameters->vector->data[0];
-    if (!m->more) { 
-        gsl_matrix *ccc = apop_matrix_copy(m->parameters->matrix);
-        gsl_linalg_cholesky_decomp(ccc);
-        for (int i=0; i < ccc->size1; i++) //zero out the upper diagonal
-            for (int j=i+1; j < ccc->size2; j++)
-                gsl_matrix_set(ccc, i, j, 0);
-        m->more = apop_matrix_to_data(ccc);
-        m->more_size = sizeof(apop_data);
-    }
-    apop_data *Chol = m->more;
-    apop_data *rmatrix = apop_data_calloc(np, np);
-    Staticdef(apop_model *, std_normal, apop_model_set_parameters(apop_normal, 0, 1));
+    double n = m->parameters->vector->data[0];
+    Apop_stopif(!(n > np-1), return 1, 0, "Degrees of freedom (%g) must be greater than "
+            "the dimension minus one (%i).", n, np-1);
+    apop_mvn_settings *ms = mvn_factor(m);
+    Apop_stopif(!ms->cholesky, return 1, 0, "The parameter matrix is not positive definite, so I can't make draws.");
 
-//C     Load diagonal elements with square root of chi-square variates
+    gsl_matrix *LA = gsl_matrix_calloc(np, np);
     for(int i = 0; i< np; i++){
-        int DF = n - i;
-        apop_data_set(rmatrix, i, i, sqrt(gsl_ran_chisq(r, DF)));
+        gsl_matrix_set(LA, i, i, sqrt(gsl_ran_chisq(r, n - i)));
+        for(int j = 0; j< i; j++)
+            gsl_matrix_set(LA, i, j, gsl_ran_gaussian(r, 1));
     }
-    
-    for(int i = 1; i< np; i++) //off-diagonal triangles: Normals.
-          for(int j = 0; j< i; j++){
-            double ndraw;
-            apop_draw(&ndraw, r, std_normal);
-            assert (!gsl_isnan(ndraw));
-            apop_data_set(rmatrix, i, j, ndraw);
-          }
-    //Now find C * rand * rand' * C'
-    apop_data *cr = apop_dot(Chol, rmatrix);
-    apop_data *crr = apop_dot(cr, rmatrix, .form2='t');
-    apop_data *crrc = apop_dot(crr, Chol, .form2='t');
-    memmove(out, crrc->matrix->data, sizeof(double)*np*np);
-    apop_data_free(rmatrix); apop_data_free(cr);
-    apop_data_free(crrc);    apop_data_free(crr);
+    gsl_blas_dtrmm(CblasLeft, CblasLower, CblasNoTrans, CblasNonUnit, 1, ms->cholesky, LA);
+
+    gsl_matrix_view W = gsl_matrix_view_array(out, np, np);
+    gsl_blas_dsyrk(CblasLower, CblasNoTrans, 1, LA, 0, &W.matrix);
+    for(int i = 0; i< np; i++)
+        for(int j = i+1; j< np; j++)
+            gsl_matrix_set(&W.matrix, i, j, gsl_matrix_get(&W.matrix, j, i));
+    gsl_matrix_free(LA);
     return 0;
 }
 
@@ -111,6 +100,7 @@ static long double wishart_constraint(apop_data *d, apop_model *m){
 }
 
 static void wishart_prep(apop_data *d, apop_model *m){
+    if (!Apop_settings_get_group(m, apop_mvn)) Apop_settings_add_group(m, apop_mvn);
     if (m->parameters) return;//already prepped
      m->parameters = apop_data_alloc(1,sqrt(d->matrix->size2),sqrt(d->matrix->size2));
 }
@@ -124,6 +124,317 @@ void test_percentiles(){
     assert(pcts_avg[50] == (pcts_down[50] + pcts_up[50])/2);
 }
 
+/* Selection should give the same answers as indexing into a sorted copy, including
+on data with many ties and on already-sorted data. */
+void test_quantiles(gsl_rng *r){
+    double q[] = {0, .01, .25, .29, .5, .5, .731, .99, 1};
+    gsl_vector *qv = apop_array_to_vector(q, 9);
+    for (int type=0; type< 3; type++)
+        for (size_t n=1; n< 3000; n = n*3+1){
+            gsl_vector *v = gsl_vector_alloc(n);
+            for (size_t i=0; i< n; i++)
+                gsl_vector_set(v, i, type==0 ? gsl_rng_uniform(r)
+                                   : type==1 ? gsl_rng_uniform_int(r, 5)
+                                   : i);
+            gsl_vector *sorted = apop_vector_copy(v);
+            gsl_sort_vector(sorted);
+            for (int rnd=0; rnd< 3; rnd++){
+                char rounding = "uda"[rnd];
+                double *quants = apop_vector_quantiles(v, qv, rounding);
+                for (int i=0; i< 9; i++){
+                    double pos = q[i]*(n-1);
+                    size_t lo = pos + 1e-9;
+                    double expected = gsl_vector_get(sorted, lo);
+                    if (pos - lo > 1e-9){
+                        if (rounding=='u') expected = gsl_vector_get(sorted, lo+1);
+                        if (rounding=='a') expected = (expected + gsl_vector_get(sorted, lo+1))/2.;
+                    }
+                    assert(quants[i] == expected);
+                }
+                free(quants);
+            }
+            double *median = apop_vector_quantiles(v, .inplace='y');
+            assert(*median == gsl_vector_get(sorted, (n-1)/2));
+            gsl_sort_vector(v);
+            for (size_t i=0; i< n; i++) assert(gsl_vector_get(v, i) == gsl_vector_get(sorted, i));
+            free(median);
+            gsl_vector_free(sorted);
+            gsl_vector_free(v);
+        }
+    gsl_vector_free(qv);
+}
+
+/* Sketch several pieces of a skewed data set, merge them, send the result through
+serialization, and check that each estimate's rank in the full data is near the target.
+Then do the same via the SQLite aggregates. */
+void test_quantile_sketch(gsl_rng *r){
+    int n = 2e5;
+    gsl_vector *v = gsl_vector_alloc(n);
+    apop_quantile_sketch *pieces[4];
+    for (int i=0; i< 4; i++) pieces[i] = apop_quantile_sketch_alloc();
+    for (int i=0; i< n; i++){
+        gsl_vector_set(v, i, gsl_ran_lognormal(r, 0, 1));
+        apop_quantile_sketch_add(pieces[i%4], gsl_vector_get(v, i), 1);
+    }
+    for (int i=1; i< 4; i++){
+        apop_quantile_sketch_merge(pieces[0], pieces[i]);
+        apop_quantile_sketch_free(pieces[i]);
+    }
+    size_t byte_ct;
+    void *bytes = apop_quantile_sketch_serialize(pieces[0], &byte_ct);
+    apop_quantile_sketch *s = apop_quantile_sketch_deserialize(bytes, byte_ct);
+    free(bytes);
+    gsl_sort_vector(v);
+    assert(apop_quantile_sketch_query(s, 0) == gsl_vector_get(v, 0));
+    assert(apop_quantile_sketch_query(s, 1) == gsl_vector_get(v, n-1));
+    double q[] = {.001, .01, .1, .25, .5, .75, .9, .99, .999};
+    for (int i=0; i< 9; i++){
+        double est = apop_quantile_sketch_query(s, q[i]);
+        assert(est == apop_quantile_sketch_query(pieces[0], q[i]));
+        size_t below = 0;
+        while (below < n && gsl_vector_get(v, below) < est) below++;
+        Diff(below/(double)n, q[i], 5e-3);
+    }
+
+    //Merging a sketch with itself doubles every weight, which leaves the quantiles alone.
+    double total = s->total_weight;
+    apop_quantile_sketch_merge(s, s);
+    Diff(s->total_weight, 2*total, 1e-6);
+    for (int i=0; i< 9; i++)
+        assert(apop_quantile_sketch_query(s, q[i]) == apop_quantile_sketch_query(pieces[0], q[i]));
+
+    //Corrupt blocks: centroids with no weight, and weights that don't sum to the total.
+    bytes = apop_quantile_sketch_serialize(s, &byte_ct);
+    double *vals = bytes;
+    size_t centroid_ct = vals[4];
+    vals[5+centroid_ct] += 1;
+    assert(!apop_quantile_sketch_deserialize(bytes, byte_ct));
+    free(bytes);
+    double empty_but_weighted[] = {100, 1, 0, 0, 0};
+    assert(!apop_quantile_sketch_deserialize(empty_but_weighted, sizeof(empty_but_weighted)));
+    double huge_compression[] = {1e300, 0, INFINITY, -INFINITY, 0};
+    assert(!apop_quantile_sketch_deserialize(huge_compression, sizeof(huge_compression)));
+    double inverted[] = {100, 1, 3, 2, 1, 2.5, 1};
+    assert(!apop_quantile_sketch_deserialize(inverted, sizeof(inverted)));
+    inverted[2] = GSL_NAN;
+    assert(!apop_quantile_sketch_deserialize(inverted, sizeof(inverted)));
+    apop_quantile_sketch_free(s);
+    apop_quantile_sketch_free(pieces[0]);
+
+    if (apop_opts.db_engine=='s'){
+        apop_table_exists(.remove='d', .name="sk");
+        apop_query("create table sk(grp, x)");
+        apop_query("begin");
+        for (int i=0; i< 2e4; i++) apop_query("insert into sk values(%i, %i)", i%2, i);
+        apop_query("commit");
+        Diff(apop_query_to_float("select approx_median(x) from sk"), 1e4, 50.);
+        Diff(apop_query_to_float("select approx_quantile(x, .9) from sk"), 1.8e4, 50.);
+        Diff(apop_query_to_float("select sketch_quantile(quantile_sketch_merge(s), .5) from "
+                                 "(select quantile_sketch(x) as s from sk group by grp)"), 1e4, 50.);
+        apop_table_exists("sk", 'd');
+    }
+    gsl_vector_free(v);
+}
+
+//The Euler-Maclaurin shortcut for large N should match brute force.
+void test_harmonic(){
+    double s[] = {-2, -1, 0, .5, 1-1e-9, 1, 1+1e-9, 1.3, 2, 4.5};
+    int N[] = {1, 7, 100, 1000, 123456};
+    for (int i=0; i< sizeof(s)/sizeof(double); i++)
+        for (int j=0; j< 5; j++){
+            long double brute = 0;
+            for (int n=N[j]; n>= 1; n--) brute += powl(n, -s[i]);
+            long double h = apop_generalized_harmonic(N[j], s[i]);
+            Diff(h/brute, 1, 1e-12);
+            assert(apop_generalized_harmonic(N[j], s[i]) == h);
+        }
+    assert(apop_generalized_harmonic(12, -1) == 78);
+}
+
+//Every entry of the batched distance matrix should match the one-pair-at-a-time version.
+void test_distance_matrix(gsl_rng *r){
+    apop_data *a = apop_data_alloc(300, 5), *b = apop_data_alloc(70, 5);
+    for (int i=0; i< 300; i++)
+        for (int j=0; j< 5; j++){
+            apop_data_set(a, i, j, gsl_rng_uniform_int(r, 4) + 10);
+            if (i < 70) apop_data_set(b, i, j, gsl_ran_gaussian(r, 3));
+        }
+    char *metrics = "emdsl";
+    for (int k=0; k< 5; k++){
+        apop_data *within = apop_data_distance_matrix(a, .metric=metrics[k], .norm=3);
+        apop_data *condensed = apop_data_distance_matrix(a, .metric=metrics[k], .norm=3, .condensed='y');
+        apop_data *between = apop_data_distance_matrix(a, b, .metric=metrics[k], .norm=3);
+        assert(condensed->vector->size == 300*299/2);
+        for (int i=0, c=0; i< 300; i++){
+            for (int j=0; j< 300; j++){
+                double d = apop_vector_distance(Apop_rv(a, i), Apop_rv(a, j), .metric=metrics[k], .norm=3);
+                Diff(apop_data_get(within, i, j), d, 1e-6);
+                if (j > i) Diff(apop_data_get(condensed, c++, -1), d, 1e-6);
+            }
+            assert(apop_data_get(within, i, i) == 0);
+            for (int j=0; j< 70; j++)
+                Diff(apop_data_get(between, i, j),
+                     apop_vector_distance(Apop_rv(a, i), Apop_rv(b, j), .metric=metrics[k], .norm=3), 1e-6);
+        }
+        apop_data_free(within);
+        apop_data_free(condensed);
+        apop_data_free(between);
+    }
+    apop_data_free(a);
+    apop_data_free(b);
+}
+
+/* On data with a few strong factors plus noise, the randomized PCA's components
+should match the exact ones up to sign, and its weights should match too. */
+void test_pca_randomized(gsl_rng *r){
+    int n = 400, p = 60;
+    apop_data *d = apop_data_calloc(n, p);
+    for (int f=0; f< 3; f++){
+        double loadings[p];
+        for (int j=0; j< p; j++) loadings[j] = gsl_ran_gaussian(r, 1);
+        for (int i=0; i< n; i++){
+            double score = gsl_ran_gaussian(r, 10-3*f);
+            for (int j=0; j< p; j++) *apop_data_ptr(d, i, j) += score*loadings[j];
+        }
+    }
+    for (int i=0; i< n; i++)
+        for (int j=0; j< p; j++) *apop_data_ptr(d, i, j) += gsl_ran_gaussian(r, .01);
+    apop_data *d2 = apop_data_copy(d);
+    apop_data *exact = apop_matrix_pca(d->matrix, 3);
+    apop_data *fast = apop_matrix_pca(d2->matrix, 3, .method='r');
+    assert(!fast->error);
+    for (int i=0; i< 3; i++){
+        Diff(apop_data_get(fast, i, -1), apop_data_get(exact, i, -1), 1e-6);
+        double dot;
+        gsl_blas_ddot(Apop_cv(fast, i), Apop_cv(exact, i), &dot);
+        Diff(fabs(dot), 1, 1e-6);
+    }
+    apop_data_free(d); apop_data_free(d2);
+    apop_data_free(exact); apop_data_free(fast);
+}
+
+static double above_half(apop_data *d, apop_model *m){ return apop_data_get(d) > 0.5; }
+
+/* The share of a standard Normal above 0.5 via pseudorandom and quasi-random draws. Each
+block of draws has its own RNG, so the result is the same with threads or without, and
+with any thread count. */
+void test_dconstrain_scaling(){
+    double truth = 1 - gsl_cdf_gaussian_P(0.5, 1);
+    apop_model *trunc = apop_model_dconstrain(.base_model=apop_model_set_parameters(apop_normal, 0, 1),
+                                              .constraint=above_half, .draw_ct=2e5);
+    apop_dconstrain_settings *cs = Apop_settings_get_group(trunc, apop_dconstrain);
+    for (int quasi=0; quasi< 2; quasi++){
+        cs->quasi_random = quasi ? 'y' : 'n';
+        cs->parallel_draws = 'n';
+        gsl_rng_set(cs->rng, 12);
+        double serial = cs->scaling(trunc);
+        Diff(serial, truth, 5e-3);
+
+        cs->parallel_draws = 'y';
+        gsl_rng_set(cs->rng, 12);
+        assert(cs->scaling(trunc) == serial);
+#ifdef _OPENMP
+        int threads = omp_get_max_threads();
+        omp_set_num_threads(threads > 2 ? threads-1 : 3);
+        gsl_rng_set(cs->rng, 12);
+        assert(cs->scaling(trunc) == serial);
+        omp_set_num_threads(threads);
+#endif
+    }
+    apop_model_free(trunc);
+}
+
+//y at x=1, ..., 20, with the dependent variable in the vector.
+apop_data *loess_test_data(){
+    double y[] = {2.31, 3.95, 5.12, 5.86, 6.70, 6.02, 5.41, 4.96, 3.12, 2.58,
+                  1.07, 0.33, -0.68, -0.41, -1.92, -1.15, -1.63, -0.47, -0.92, 0.64};
+    apop_data *d = apop_data_alloc(20, 1);
+    for (int i=0; i< 20; i++){
+        apop_data_set(d, i, -1, y[i]);
+        apop_data_set(d, i, 0, i+1);
+    }
+    return d;
+}
+
+/* With the direct surface, each fitted value is a local quadratic regression on the
+15 nearest points under tricube weights; the reference values were calculated that way
+independently. Fits running at once in separate threads mustn't interfere. */
+void test_loess(){
+    double fitted[] = {2.657203903, 3.990873376, 4.966399688, 5.593373168, 5.881495298,
+                       5.835764423, 5.4352792, 4.608844143, 3.514806825, 2.382972295,
+                       1.310547037, 0.3514006834, -0.4330421724, -0.9658412772, -1.281280747,
+                       -1.381367885, -1.267280308, -0.9385235996, -0.3936869035, 0.3680882483};
+    apop_data *d = loess_test_data();
+    apop_model *direct = apop_model_copy(apop_loess);
+    Apop_model_add_group(direct, apop_loess, .data=d, .lo_s.control.surface="direct");
+    apop_model *fits[4];
+    #pragma omp parallel for
+    for (int i=0; i< 4; i++)
+        fits[i] = apop_estimate(d, i%2 ? apop_loess : direct);
+    for (int i=0; i< 20; i++){
+        for (int j=0; j< 4; j+=2)
+            Diff(apop_data_get(fits[j]->info, i, 1, .page="<Predicted>"), fitted[i], 1e-7);
+        assert(apop_data_get(fits[1]->info, i, 1, .page="<Predicted>")
+                == apop_data_get(fits[3]->info, i, 1, .page="<Predicted>"));
+    }
+    for (int i=0; i< 4; i++) apop_model_free(fits[i]);
+    apop_model_free(direct);
+    apop_data_free(d);
+}
+
+//Prediction points go in column one; apop_predict fills in column zero.
+static apop_data *loess_predict_points(int n, double lo, double hi){
+    apop_data *out = apop_data_alloc(n, 2);
+    for (int i=0; i< n; i++) apop_data_set(out, i, 1, lo + (hi-lo)*i/(n-1.));
+    return out;
+}
+
+/* Direct predictions match the reference local regressions. Interpolating from a
+direct fit (interpolate_predictions='y') builds the same kd tree and vertex values as
+an interpolated-surface fit, so the two agree. Predictions split across threads match
+a one-thread run. */
+void test_loess_predict(){
+    double at[] = {2.5, 7.25, 11, 15.5, 18.75};
+    double direct_ref[] = {4.522828959, 5.269996769, 1.310547037, -1.358076362, -0.5501850294};
+    apop_data *d = loess_test_data();
+    apop_model *direct_base = apop_model_copy(apop_loess);
+    Apop_model_add_group(direct_base, apop_loess, .data=d, .lo_s.control.surface="direct");
+    apop_model *direct = apop_estimate(d, direct_base);
+    apop_model *interp = apop_estimate(d, apop_loess);
+
+    apop_data *p = apop_data_alloc(5, 2);
+    for (int i=0; i< 5; i++) apop_data_set(p, i, 1, at[i]);
+    apop_predict(p, direct);
+    for (int i=0; i< 5; i++) Diff(apop_data_get(p, i, 0), direct_ref[i], 1e-7);
+    apop_data_free(p);
+
+    Apop_settings_set(direct, apop_loess, interpolate_predictions, 'y');
+    apop_data *from_direct = apop_predict(loess_predict_points(200, 1, 20), direct);
+    apop_data *from_interp = apop_predict(loess_predict_points(200, 1, 20), interp);
+    for (int i=0; i< 200; i++)
+        Diff(apop_data_get(from_direct, i, 0), apop_data_get(from_interp, i, 0), 1e-6);
+
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    apop_data *serial = apop_predict(loess_predict_points(200, 1, 20), interp);
+    apop_data *serial_direct = apop_predict(loess_predict_points(200, 1, 20), direct);
+    omp_set_num_threads(threads);
+    for (int i=0; i< 200; i++){
+        assert(apop_data_get(serial, i, 0) == apop_data_get(from_interp, i, 0));
+        assert(apop_data_get(serial_direct, i, 0) == apop_data_get(from_direct, i, 0));
+    }
+    apop_data_free(serial);
+    apop_data_free(serial_direct);
+#endif
+    apop_data_free(from_direct);
+    apop_data_free(from_interp);
+    apop_model_free(direct);
+    apop_model_free(direct_base);
+    apop_model_free(interp);
+    apop_data_free(d);
+}
+
 void test_score(){
     int len = 1e5;
     gsl_rng *r = apop_rng_alloc(123);
@@ -292,6 +603,11 @@ void test_weigted_moments(){
     gsl_vector *w2 = gsl_vector_alloc(5);
     apop_vector_fill(w2, 4, 3, 2, 1, 0);
     wmt(v, v2, w2, av, av2, 1);
+
+    //The weighted variance keeps its precision when the mean dwarfs the spread.
+    gsl_vector *offset = apop_vector_fill(gsl_vector_alloc(3), 1e9+1, 1e9+2, 1e9+3);
+    Diff(apop_vector_var(offset, w), 1, 1e-6);
+    gsl_vector_free(offset);
 }
 
 void test_split_and_stack(gsl_rng *r){
@@ -521,7 +837,24 @@ void test_summarize(){
     t = gsl_matrix_get(s->matrix, 2, 1);
     double v = sqrt((2*2 +3*3 +3*3 +4.*4.)/3.);
     assert (t == v);
+    assert (apop_data_get(s, 2, .colname="min") == 1);
+    assert (apop_data_get(s, 2, .colname="median") == 1);
+    assert (apop_data_get(s, 2, .colname="max") == 8);
     apop_data_free(s);
+
+    //Weights of two act like repeated rows.
+    m = apop_query_to_data("select * from td");
+    m->weights = apop_vector_fill(gsl_vector_alloc(4), 2, 2, 2, 2);
+    apop_data *doubled = apop_query_to_data("select * from td union all select * from td");
+    s = apop_data_summarize(m);
+    apop_data *s2 = apop_data_summarize(doubled);
+    for (int i=0; i< 4; i++)
+        for (int j=0; j< 6; j++)
+            Diff(gsl_matrix_get(s->matrix, i, j), gsl_matrix_get(s2->matrix, i, j), 1e-10);
+    apop_data_free(m);
+    apop_data_free(doubled);
+    apop_data_free(s);
+    apop_data_free(s2);
 }
 
 void test_dot(){
@@ -748,6 +1081,28 @@ assert ((fabs(apop_data_get(out, 0,0) - gsl_pow_2(pv[1])/len)) < tol2
     apop_model_free(m);
 }
 
+//Check the log likelihood against the textbook form, via the explicit inverse and determinant.
+static void check_mvn_ll(apop_data *d, apop_model *m){
+    gsl_matrix *inv = apop_matrix_inverse(m->parameters->matrix);
+    double det = apop_matrix_determinant(m->parameters->matrix);
+    int dims = d->matrix->size2;
+    gsl_vector *x = gsl_vector_alloc(dims);
+    gsl_vector *sx = gsl_vector_alloc(dims);
+    long double ll = 0;
+    for (int i=0; i< d->matrix->size1; i++){
+        double xsx;
+        gsl_vector_memcpy(x, Apop_rv(d, i));
+        gsl_vector_sub(x, m->parameters->vector);
+        gsl_blas_dgemv(CblasNoTrans, 1, inv, x, 0, sx);
+        gsl_blas_ddot(x, sx, &xsx);
+        ll += -xsx/2 - log(2*M_PI)*dims/2. - log(det)/2;
+    }
+    Diff(apop_log_likelihood(d, m), ll, 1e-6*fabs(ll));
+    gsl_matrix_free(inv);
+    gsl_vector_free(x);
+    gsl_vector_free(sx);
+}
+
 void test_multivariate_normal(){
     int len = 5e5;
     double params[] = {1, 3, 0,
@@ -767,6 +1122,13 @@ void test_multivariate_normal(){
                   +fabs(est->parameters->matrix->data[2] - p->matrix->data[2])
                   +fabs(est->parameters->matrix->data[3] - p->matrix->data[3]);
     Diff(error, 0, 4e-2); //yes, unimpressive, but we don't wanna be here all day.
+
+    //The Cholesky factor is cached; modifying the covariance in place has to invalidate it.
+    apop_data *few = Apop_rs(rdraws, 0, 3000);
+    check_mvn_ll(few, est);
+    gsl_matrix_set(est->parameters->matrix, 0, 1, 0.5);
+    gsl_matrix_set(est->parameters->matrix, 1, 0, 0.5);
+    check_mvn_ll(few, est);
     apop_model_free(est);
     apop_data_free(rdraws);
 }
@@ -1062,6 +1424,17 @@ void test_pmf(){
     }
     apop_vector_normalize(d->weights);
     apop_vector_normalize(v);
+    for (size_t i=0; i < v->size; i ++)
+        Diff(d->weights->data[i], v->data[i], 1e-2);
+
+    Apop_settings_set(m, apop_pmf, draw_method, 'a');
+    gsl_vector_set_zero(v);
+    for (size_t i=0; i< 1e5; i++){
+        double out;
+        apop_draw(&out, r, m);
+        (*gsl_vector_ptr(v, out))++;
+    }
+    apop_vector_normalize(v);
     for (size_t i=0; i < v->size; i ++)
         Diff(d->weights->data[i], v->data[i], 1e-2);
     apop_model_free(m);
@@ -1069,6 +1442,337 @@ void test_pmf(){
     gsl_vector_free(v);
 }
 
+void test_suff_stats(gsl_rng *r){
+    apop_data *d = apop_data_alloc(1000);
+    for (int i=0; i< 1000; i++) apop_data_set(d, i, -1, gsl_ran_gamma(r, 2, 3));
+    apop_model *models[] = {apop_model_set_parameters(apop_gamma, 1.5, 2),
+                            apop_model_set_parameters(apop_normal, 5, 3),
+                            apop_model_set_parameters(apop_exponential, 4)};
+    for (int i=0; i< 3; i++){
+        apop_model *m = models[i];
+        double ll = apop_log_likelihood(d, m);
+        Apop_model_add_group(m, apop_suff_stats);
+        Diff(apop_log_likelihood(d, m), ll, 1e-8*fabs(ll)); //fills the cache
+        Diff(apop_log_likelihood(d, m), ll, 1e-8*fabs(ll)); //uses the cache
+
+        gsl_vector_scale(d->vector, 2);
+        apop_suff_stats_settings *ss = Apop_settings_get_group(m, apop_suff_stats);
+        ss->version++;
+        double cached_ll = apop_log_likelihood(d, m);
+        Apop_settings_rm_group(m, apop_suff_stats);
+        Diff(cached_ll, apop_log_likelihood(d, m), 1e-8*fabs(cached_ll));
+        gsl_vector_scale(d->vector, .5);
+        apop_model_free(m);
+    }
+    apop_data_free(d);
+}
+
+/* Models with a draw_many function fill blocks of rows at once; check the moments
+   of what comes out, including a partial final block. */
+void test_draw_many(){
+    int n = 5e4+7;
+    apop_model *models[] = {apop_model_set_parameters(apop_normal, 1, 2),
+                            apop_model_set_parameters(apop_poisson, 3),
+                            apop_model_set_parameters(apop_poisson, 50),
+                            apop_model_set_parameters(apop_gamma, .5, 2),
+                            apop_model_set_parameters(apop_gamma, 4, 1.5)};
+    double means[] = {1, 3, 50, 1, 6}, vars[] = {4, 3, 50, 2, 9};
+    for (int i=0; i< 5; i++){
+        assert(apop_draw_many_vtable_get(models[i]));
+        apop_data *draws = apop_model_draws(models[i], n);
+        assert(!draws->error);
+        double mean, var;
+        apop_matrix_mean_and_var(draws->matrix, &mean, &var);
+        Diff(mean, means[i], .03*means[i]);
+        Diff(var, vars[i], .05*vars[i]);
+        apop_data_free(draws);
+        apop_model_free(models[i]);
+    }
+
+    apop_model *mvn_base = apop_model_copy(apop_multivariate_normal);
+    mvn_base->vsize = mvn_base->msize1 = mvn_base->msize2 = 2;
+    apop_model *mvn = apop_model_set_parameters(mvn_base, 1, 2, .5,
+                                                         -1, .5, 1);
+    apop_data *params = mvn->parameters;
+    apop_data *draws = apop_model_draws(mvn, n);
+    assert(!draws->error);
+    apop_data *cov = apop_data_covariance(draws);
+    for (int i=0; i< 2; i++){
+        Diff(apop_vector_mean(Apop_cv(draws, i)), apop_data_get(params, i, -1), .03);
+        for (int j=0; j< 2; j++)
+            Diff(apop_data_get(cov, i, j), apop_data_get(params, i, j), .05);
+    }
+    apop_data_free(cov);
+    apop_data_free(draws);
+    apop_model_free(mvn);
+    apop_model_free(mvn_base);
+}
+
+/* Draws from a cross product come from the components' draw_many functions, and with
+   a splitpage set, the log likelihood splits a matrix of draws by columns. */
+void test_cross_columns(){
+    apop_model *n = apop_model_set_parameters(apop_normal, 0, 1);
+    apop_model *p = apop_model_set_parameters(apop_poisson, 4);
+    apop_model *np = apop_model_cross(n, p);
+    apop_data *draws = apop_model_draws(np, 2e4);
+    assert(!draws->error);
+    Diff(apop_vector_mean(Apop_cv(draws, 0)), 0, 3e-2);
+    Diff(apop_vector_mean(Apop_cv(draws, 1)), 4, 5e-2);
+
+    Apop_settings_set(np, apop_cross, splitpage, "unused");
+    double ll = apop_log_likelihood(draws, np);
+    double ll_parts = apop_log_likelihood(Apop_cs(draws, 0, 1), n)
+                    + apop_log_likelihood(Apop_cs(draws, 1, 1), p);
+    Diff(ll, ll_parts, 1e-6*fabs(ll));
+    apop_data_free(draws);
+    apop_model_free(np);
+}
+
+/* The fixed-parameter model scatters its free values into the base model, and gathers
+   the base model's closed-form score at the free positions. */
+void test_fix_params_score(gsl_rng *r){
+    apop_data *d = apop_data_alloc(2000);
+    for (int i=0; i< 2000; i++) apop_data_set(d, i, -1, gsl_ran_gaussian(r, 2) + 1);
+    apop_model *fixed = apop_model_fix_params(apop_model_set_parameters(apop_normal, NAN, 2));
+    apop_prep(d, fixed);
+    apop_data_set(fixed->parameters, 0, -1, 1.3);
+
+    apop_model *full = apop_model_set_parameters(apop_normal, 1.3, 2);
+    double ll = apop_log_likelihood(d, full);
+    Diff(apop_log_likelihood(d, fixed), ll, 1e-8*fabs(ll));
+
+    gsl_vector *g = gsl_vector_alloc(1);
+    apop_score(d, g, fixed);
+    gsl_vector *numeric = apop_numerical_gradient(d, fixed);
+    Diff(gsl_vector_get(g, 0), gsl_vector_get(numeric, 0), 1e-3*fabs(gsl_vector_get(g, 0)));
+
+    apop_model *est = apop_estimate(d, fixed);
+    Diff(apop_data_get(est->parameters, 0, -1), apop_vector_mean(d->vector), 2e-2);
+    gsl_vector_free(g); gsl_vector_free(numeric);
+    apop_model_free(est);
+    apop_model_free(fixed);
+    apop_model_free(full);
+    apop_data_free(d);
+}
+
+/* The blocked covariance should match the pairwise apop_vector_cov, with and without
+   weights, including weights that sum to less than 1.1. */
+void test_covariance_blocks(gsl_rng *r){
+    apop_data *d = apop_data_alloc(0, 5000, 4);
+    for (int i=0; i< 5000; i++)
+        for (int j=0; j< 4; j++)
+            apop_data_set(d, i, j, gsl_ran_gaussian(r, 1) + j*apop_data_get(d, i, 0));
+    for (int weighted=0; weighted< 3; weighted++){
+        if (weighted){
+            d->weights = gsl_vector_alloc(5000);
+            for (int i=0; i< 5000; i++) gsl_vector_set(d->weights, i, gsl_rng_uniform(r) * (weighted==1 ? 2 : 1e-4));
+        }
+        apop_data *cov = apop_data_covariance(d);
+        apop_data *cor = apop_data_correlation(d);
+        for (int i=0; i< 4; i++)
+            for (int j=0; j< 4; j++){
+                double pairwise = apop_vector_cov(Apop_cv(d, i), Apop_cv(d, j), d->weights);
+                Diff(apop_data_get(cov, i, j), pairwise, 1e-8*(1+fabs(pairwise)));
+                Diff(apop_data_get(cor, i, j), apop_vector_correlation(Apop_cv(d, i), Apop_cv(d, j), d->weights), 1e-8);
+            }
+        apop_data_free(cov);
+        apop_data_free(cor);
+        if (d->weights) gsl_vector_free(d->weights);
+        d->weights = NULL;
+    }
+    apop_data_free(d);
+}
+
+/* The one-pass tally should match a two-pass calculation even with a large offset;
+merging the tallies of two halves should match the tally of the whole; integer weights
+should act like replicated observations. */
+void test_moments(gsl_rng *r){
+    int n = 10000;
+    gsl_vector *v = gsl_vector_alloc(n);
+    for (int i=0; i< n; i++) gsl_vector_set(v, i, 1e6 + gsl_ran_gaussian(r, 2) + gsl_rng_uniform(r));
+    long double mu = 0, m2 = 0, m3 = 0, m4 = 0;
+    for (int i=0; i< n; i++) mu += gsl_vector_get(v, i);
+    mu /= n;
+    for (int i=0; i< n; i++){
+        long double d = gsl_vector_get(v, i) - mu;
+        m2 += d*d; m3 += d*d*d; m4 += d*d*d*d;
+    }
+    apop_moments all = apop_vector_moments(v);
+    assert(all.count == n);
+    assert(all.min == gsl_vector_min(v) && all.max == gsl_vector_max(v));
+    Diff(all.mean, mu, 1e-9);
+    Diff(apop_moments_var(&all), m2/(n-1), 1e-8);
+    Diff(apop_moments_skew_pop(&all), m3/n, 1e-7);
+    Diff(apop_moments_kurtosis_pop(&all), m4/n, 1e-6);
+    Diff(apop_vector_skew_pop(v), m3/n, 1e-7);
+    Diff(apop_vector_kurtosis_pop(v), m4/n, 1e-6);
+
+    apop_moments head = apop_vector_moments(Apop_subvector(v, 0, 3000)),
+                 tail = apop_vector_moments(Apop_subvector(v, 3000, n-3000)),
+                 merged = apop_moments_merge(head, tail);
+    assert(merged.count == n && merged.min == all.min && merged.max == all.max);
+    Diff(merged.mean, all.mean, 1e-9);
+    Diff(merged.m2, all.m2, 1e-8*(double)all.m2);
+    Diff(merged.m3, all.m3, 1e-6*(double)all.m2);
+    Diff(merged.m4, all.m4, 1e-8*(double)all.m4);
+
+    //weights of 1, 2, 3 vs. the same data with repeated entries
+    gsl_vector *w = gsl_vector_alloc(300);
+    gsl_vector *rep = gsl_vector_alloc(600);
+    for (int i=0, k=0; i< 300; i++){
+        gsl_vector_set(w, i, i%3 + 1);
+        for (int j=0; j <= i%3; j++) gsl_vector_set(rep, k++, gsl_vector_get(v, i));
+    }
+    apop_moments wm = apop_vector_moments(Apop_subvector(v, 0, 300), w),
+                 rm = apop_vector_moments(rep);
+    Diff(wm.mean, rm.mean, 1e-9);
+    Diff(apop_moments_var(&wm), apop_moments_var(&rm), 1e-8);
+    Diff(apop_moments_kurtosis_pop(&wm), apop_moments_kurtosis_pop(&rm), 1e-6);
+    Diff(apop_moments_var(&wm), apop_vector_var(Apop_subvector(v, 0, 300), w), 1e-8);
+
+    apop_data *d = apop_data_alloc(n, 3);
+    for (int i=0; i< n; i++)
+        for (int j=0; j< 3; j++) apop_data_set(d, i, j, gsl_vector_get(v, (i+j*17)%n) * (j+1));
+    apop_moments *cols = apop_matrix_moments(d->matrix, NULL);
+    for (int j=0; j< 3; j++){
+        apop_moments c = apop_vector_moments(Apop_cv(d, j));
+        Diff(cols[j].mean, c.mean, 1e-9);
+        Diff(apop_moments_var(cols+j), apop_vector_var(Apop_cv(d, j)), 1e-7);
+    }
+    free(cols);
+    apop_data_free(d);
+    gsl_vector_free(w);
+    gsl_vector_free(rep);
+    gsl_vector_free(v);
+}
+
+void test_mixture_em(){
+    apop_model *truth = apop_model_mixture(apop_model_set_parameters(apop_normal, 0, 1),
+                                           apop_model_set_parameters(apop_normal, 8, 1.5));
+    Apop_settings_set(truth, apop_mixture, weights, apop_array_to_vector((double[]){.3, .7}, 2));
+    apop_prep(NULL, truth);
+    apop_data *draws = apop_model_draws(truth, 2e4);
+
+    apop_model *mf = apop_model_mixture(apop_model_copy(apop_normal), apop_model_copy(apop_normal));
+    Apop_settings_set(mf, apop_mixture, find_weights, 'y');
+    apop_model *est = apop_estimate(draws, mf);
+    apop_mixture_settings *ms = Apop_settings_get_group(est, apop_mixture);
+    Diff(gsl_vector_get(ms->weights, 0), .3, 2e-2);
+    Diff(apop_data_get(ms->model_list[0]->parameters, 0, -1), 0, 5e-2);
+    Diff(apop_data_get(ms->model_list[0]->parameters, 1, -1), 1, 5e-2);
+    Diff(apop_data_get(ms->model_list[1]->parameters, 0, -1), 8, 5e-2);
+    Diff(apop_data_get(ms->model_list[1]->parameters, 1, -1), 1.5, 5e-2);
+    Diff(apop_data_get(est->parameters, 1, -1), gsl_vector_get(ms->weights, 1), 1e-6);
+
+    //The log likelihood method gives what EM reported: Σ log(Σ λ_j p_j(x)).
+    double reported = apop_data_get(est->info, .rowname="log likelihood");
+    Diff(apop_log_likelihood(draws, est), reported, 1e-8*fabs(reported));
+    long double by_hand = 0;
+    for (int i=0; i< draws->matrix->size1; i++){
+        double x = apop_data_get(draws, i, 0), p = 0;
+        for (int j=0; j< 2; j++)
+            p += gsl_vector_get(ms->weights, j)/apop_sum(ms->weights)
+                    * gsl_ran_gaussian_pdf(x - apop_data_get(ms->model_list[j]->parameters, 0, -1),
+                                               apop_data_get(ms->model_list[j]->parameters, 1, -1));
+        by_hand += log(p);
+    }
+    Diff(reported, by_hand, 1e-6*fabs(reported));
+    apop_data_free(draws);
+    for (int j=0; j< 2; j++){
+        apop_model_free(ms->model_list[j]);
+        apop_model_free(Apop_settings_get(truth, apop_mixture, model_list)[j]);
+    }
+    apop_model_free(est);
+    apop_model_free(mf);
+    apop_model_free(truth);
+}
+
+/* The Gamma has no closed-form weighted estimate, so this goes via the MLE search,
+starting from the given components. An EM step that estimated each component from the
+full data set would make both components the same. */
+void test_mixture_gamma(){
+    apop_model *truth = apop_model_mixture(apop_model_set_parameters(apop_gamma, 2, 1),
+                                           apop_model_set_parameters(apop_gamma, 30, .5));
+    Apop_settings_set(truth, apop_mixture, weights, apop_array_to_vector((double[]){.4, .6}, 2));
+    apop_prep(NULL, truth);
+    apop_data *draws = apop_model_draws(truth, 2000);
+
+    apop_model *mf = apop_model_mixture(apop_model_set_parameters(apop_gamma, 1, 3),
+                                        apop_model_set_parameters(apop_gamma, 10, 2));
+    Apop_settings_set(mf, apop_mixture, find_weights, 'y');
+    apop_model *est = apop_estimate(draws, mf);
+    apop_mixture_settings *ms = Apop_settings_get_group(est, apop_mixture);
+    double means[2];
+    for (int j=0; j< 2; j++)
+        means[j] = apop_data_get(ms->model_list[j]->parameters, 0, -1)
+                  *apop_data_get(ms->model_list[j]->parameters, 1, -1);
+    Diff(means[0], 2, .5);
+    Diff(means[1], 15, 1.5);
+    Diff(gsl_vector_get(ms->weights, 0), .4, .05);
+
+    apop_data_free(draws);
+    for (int j=0; j< 2; j++){
+        apop_model_free(ms->model_list[j]);
+        apop_model_free(Apop_settings_get(truth, apop_mixture, model_list)[j]);
+    }
+    apop_model_free(est);
+    apop_model_free(mf);
+    apop_model_free(truth);
+}
+
+void test_pmf_lookup(){
+    double vals[] = {1, 2, 2, -0., GSL_NAN, 3};
+    char *txt[] = {"a", "b", "c", "d", "e", "a"};
+    apop_data *d = apop_text_alloc(apop_data_alloc(6), 6, 1);
+    d->weights = apop_array_to_vector((double[]){1, 2, 3, 4, 5, 6}, 6);
+    for (int i=0; i< 6; i++){
+        apop_data_set(d, i, -1, vals[i]);
+        apop_text_set(d, i, 0, txt[i]);
+    }
+    apop_model *m = apop_estimate(d, apop_pmf);
+    apop_data *q = apop_text_alloc(apop_data_alloc(1), 1, 1);
+    apop_data_set(q, 0, -1, 2);
+    apop_text_set(q, 0, 0, "c");
+    Diff(apop_p(q, m), 3/21., 1e-6);
+    apop_data_set(q, 0, -1, 0); //matches the -0 row.
+    apop_text_set(q, 0, 0, "d");
+    Diff(apop_p(q, m), 4/21., 1e-6);
+    apop_data_set(q, 0, -1, GSL_NAN);
+    apop_text_set(q, 0, 0, "e");
+    Diff(apop_p(q, m), 5/21., 1e-6);
+    apop_text_set(q, 0, 0, "x");
+    assert(apop_p(q, m) == 0);
+
+    //Swap rows 1 and 2 in place; the index has to notice.
+    apop_text_set(d, 1, 0, "c");
+    apop_text_set(d, 2, 0, "b");
+    gsl_vector_swap_elements(d->weights, 1, 2);
+    apop_data_set(q, 0, -1, 2);
+    apop_text_set(q, 0, 0, "c");
+    Diff(apop_p(q, m), 3/21., 1e-6);
+    apop_text_set(q, 0, 0, "b");
+    Diff(apop_p(q, m), 2/21., 1e-6);
+
+    //Change a value in place; the new value lands on an empty slot of the old index.
+    apop_data_set(d, 5, -1, 7);
+    apop_data_set(q, 0, -1, 7);
+    apop_text_set(q, 0, 0, "a");
+    Diff(apop_p(q, m), 6/21., 1e-6);
+    Diff(apop_cdf(q, m), 1, 1e-6);
+
+    //Swapping in new data sets over and over shouldn't pile up indices.
+    for (int i=0; i< 100; i++){
+        apop_data *dd = apop_data_copy(d);
+        m->data = dd;
+        Diff(apop_p(q, m), 6/21., 1e-6);
+        m->data = d;
+        apop_data_free(dd);
+    }
+    apop_model_free(m);
+    apop_data_free(d);
+    apop_data_free(q);
+}
+
 void test_arms(gsl_rng *r){
     gsl_vector *o = gsl_vector_alloc(3e5);
     apop_model *ncut = apop_model_set_parameters(apop_normal, 1.1, 1.23);
@@ -1080,6 +1784,16 @@ void test_arms(gsl_rng *r){
     Diff(back_out->parameters->vector->data[0] , 1.1, 1e-2)
     Diff(back_out->parameters->vector->data[1] , 1.23, 1e-2)
 
+    //New parameters mean a new envelope; draws here are spread over threads.
+    apop_data_set(ncut->parameters, 0, -1, -2);
+    apop_data_set(ncut->parameters, 1, -1, .5);
+    apop_data *pdraws = apop_model_draws(ncut, 1e5);
+    apop_model *back_out2 = apop_estimate(pdraws, apop_normal);
+    Diff(back_out2->parameters->vector->data[0] , -2, 1e-2)
+    Diff(back_out2->parameters->vector->data[1] , .5, 1e-2)
+    apop_data_free(pdraws);
+    apop_model_free(back_out2);
+
     apop_opts.verbose ++;
     apop_model *bcut = apop_model_set_parameters(apop_beta, 0.4, 0.43); //bimodal
     Apop_model_add_group(bcut, apop_arms, .model=bcut, .xl=1e-5, .xr=1-1e-5);
@@ -1244,6 +1958,23 @@ int main(int argc, char **argv){
     do_test("default RNG", test_default_rng(r));
     do_test("test row set and remove", row_manipulations());
     do_test("test PMF", test_pmf());
+    do_test("test PMF lookups", test_pmf_lookup());
+    do_test("mixture EM", test_mixture_em());
+    do_test("mixture of Gammas", test_mixture_gamma());
+    do_test("sufficient statistics cache", test_suff_stats(r));
+    do_test("batched draws", test_draw_many());
+    do_test("cross product split by columns", test_cross_columns());
+    do_test("fixed-parameter score", test_fix_params_score(r));
+    do_test("blocked covariance", test_covariance_blocks(r));
+    do_test("moment tallies", test_moments(r));
+    do_test("quantiles by selection", test_quantiles(r));
+    do_test("quantile sketch", test_quantile_sketch(r));
+    do_test("generalized harmonic", test_harmonic());
+    do_test("distance matrix", test_distance_matrix(r));
+    do_test("randomized PCA", test_pca_randomized(r));
+    do_test("loess fits", test_loess());
+    do_test("loess predictions", test_loess_predict());
+    do_test("data-constrained scaling", test_dconstrain_scaling());
     do_test("apop_pack/unpack test", apop_pack_test(r));
     do_test("test adaptive rejection sampling", test_arms(r));
     //do_test("test fix params", test_model_fix_parameters(r));
@@ -26,6 +26,51 @@ void go(apop_data *d1, apop_data *d2){
     apop_model_free(test_copying);
 }
 
+static void set_row_as_mean(apop_data *in, apop_model *m){
+    gsl_vector_memcpy(m->parameters->vector, Apop_rv(in, 0));
+}
+
+/* The binned and tree approximations should stay close to the exact sum. The tree's
+error bound is relative, so its log likelihood is off by at most about the tolerance
+per observation. */
+void approximations(){
+    apop_data *base = apop_model_draws(apop_model_set_parameters(apop_normal, 1, 2), 3000);
+    apop_data *targets = apop_data_falloc((6), -4, 0, 1, 2.5, 6, 30);
+    apop_model *kernel = apop_model_set_parameters(apop_normal, 0, .4);
+    apop_model *exact = apop_model_set_settings(apop_kernel_density, .base_data=base, .kernel=kernel);
+    apop_model *binned = apop_model_set_settings(apop_kernel_density, .base_data=base, .kernel=kernel,
+                                                                        .approximation='b');
+    apop_model *tree = apop_model_set_settings(apop_kernel_density, .base_data=base, .kernel=kernel,
+                                                                        .approximation='t');
+    for (int i=0; i< targets->vector->size; i++){
+        apop_data *t = Apop_r(targets, i);
+        double ll = apop_log_likelihood(t, exact);
+        assert(fabs(apop_log_likelihood(t, binned) - ll) < 1e-2);
+        assert(fabs(apop_log_likelihood(t, tree) - ll) < 2e-3);
+        assert(fabs(apop_cdf(t, binned) - apop_cdf(t, exact)) < 1e-4);
+    }
+    assert(fabs(apop_log_likelihood(targets, tree) - apop_log_likelihood(targets, exact)) < 1.2e-2);
+
+    gsl_rng *r = apop_rng_alloc(3);
+    apop_data *base2 = apop_data_alloc(2000, 2);
+    for (int i=0; i< 2000; i++){
+        double x = gsl_ran_gaussian(r, 1);
+        apop_data_set(base2, i, 0, x);
+        apop_data_set(base2, i, 1, x/2 + gsl_ran_gaussian(r, 1));
+    }
+    apop_model *mvn = apop_model_copy(apop_multivariate_normal);
+    mvn->parameters = apop_data_falloc((2, 2, 2), 0, .2, .05,
+                                                  0, .05, .1);
+    apop_model *exact2 = apop_model_set_settings(apop_kernel_density, .base_data=base2,
+                                        .kernel=mvn, .set_fn=set_row_as_mean);
+    apop_model *tree2 = apop_model_set_settings(apop_kernel_density, .base_data=base2,
+                                        .kernel=mvn, .set_fn=set_row_as_mean, .approximation='t');
+    apop_data *targets2 = apop_data_falloc((0, 3, 2), 0, 0,
+                                                      1, 1,
+                                                     -2, 3);
+    assert(fabs(apop_log_likelihood(targets2, tree2) - apop_log_likelihood(targets2, exact2)) < 6e-3);
+}
+
 int main(){
     apop_data *d1= apop_data_falloc((4), 2,4,6,8);
     go(d1, apop_data_falloc((4), 1,3,5,7));
@@ -33,4 +78,6 @@ int main(){
 
     apop_data *d2= apop_data_falloc((4, 4, 1), 2,1.1, 4,2.2, 6,3.1, 8,0);
     go(d2, apop_data_falloc((4, 4, 1), 1, 0, 3,0, 5, 0, 7, 0));
+
+    approximations();
 }
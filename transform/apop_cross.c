@@ -8,8 +8,16 @@ For the case when you need to bundle two uncorrelated models into one larger mod
 \adoc    Input_format     There are two means of handling the input format. If the settings group attached to the data set has a non-\c NULL \c splitpage element, then 
 append the second data set as an additional page to the first data set, and name the second set with the name you listed in \c splitpage; see the example.  
 
+If \c splitpage is non-<tt>NULL</tt> and the data set's matrix has more columns than
+the first model's \c dsize, then I take each row to be a draw from this model, as
+produced by \ref apop_draw: the first model gets the first \c dsize columns and the
+second model gets the rest.
+
 If \c splitpage is \c NULL, then I will send the same data set to both models.
 
+The two models' log likelihoods (or probabilities) are evaluated in parallel, and \ref
+apop_model_draws fills blocks of rows in parallel, with each model filling its own columns.
+
 \adoc    Settings   \ref apop_cross_settings
 
 \adoc    Parameter_format  
@@ -31,11 +39,14 @@ Apop_settings_free(apop_cross, )
     ->more pointer in the input data set to split it into two parts
   --call the submodels using our two data sets 
   --restore that ->more pointer, if needed.
+
+  If the data is a matrix of draws, the split is a pair of column views, which cost
+  nothing to set up and so aren't stored between calls.
    */
 
 typedef struct {
     apop_data *d1, *d2, *dangly_bit;
-    _Bool need_to_free;
+    _Bool need_to_free, by_columns;
 } twop_s;
 
 
@@ -52,7 +63,7 @@ twop_s unpack_a_draw(apop_data *d, apop_cross_settings *s){
     int len1 = s->model1->vsize + s->model1->msize1 * s->model1->msize2;
     for (int i=0; i< d->matrix->size1; i++){
         apop_data_unpack(Apop_subvector(Apop_rv(d, i), 0, len1), Apop_r(out.d1, i));
-        apop_data_unpack(Apop_subvector(Apop_rv(d, i), len1, d->matrix->size1), Apop_r(out.d2, i));
+        apop_data_unpack(Apop_subvector(Apop_rv(d, i), len1, d->matrix->size2 - len1), Apop_r(out.d2, i));
       }
     return out;
 }
@@ -60,6 +71,8 @@ twop_s unpack_a_draw(apop_data *d, apop_cross_settings *s){
 static twop_s get_second(apop_data *d, char *splitpage, apop_cross_settings *s){
     twop_s out = {.d1=d, .d2=d};
     if (splitpage) {
+        if (d->matrix && s->model1->dsize > 0 && d->matrix->size2 > s->model1->dsize)
+            return (twop_s){.by_columns=1}; //the caller makes the views; see Preliminaries.
         if (d->matrix && (d->matrix->size2 > s->model1->msize2))
             return unpack_a_draw(d, s);
         apop_data *ctr = d;
@@ -95,10 +108,17 @@ void cross_print(apop_model *m, FILE *out){
     apop_model_print(m2, out);
 }
     
+/* Each row of a matrix of draws is a draw from the first model followed by a draw from
+   the second (as in cross_draw), so the split is two column views. They are built here
+   so they last as long as the calling function. */
 #define Preliminaries(ret)          \
     apop_cross_settings *s = Apop_settings_get_group(m, apop_cross);    \
     check_settings(ret);        \
-    twop_s datas = get_second(d, s->splitpage, s);
+    twop_s datas = get_second(d, s->splitpage, s);                       \
+    if (datas.by_columns){                                               \
+        datas.d1 = Apop_cs(d, 0, s->model1->dsize);                      \
+        datas.d2 = Apop_cs(d, s->model1->dsize, d->matrix->size2 - s->model1->dsize); \
+    }
 
 static void cross_est(apop_data *d, apop_model *m){
     Preliminaries();
@@ -109,21 +129,29 @@ static void cross_est(apop_data *d, apop_model *m){
     repaste(datas);
 }
 
+//The two components are independent, so evaluate them at the same time.
 static long double cross_ll(apop_data *d, apop_model *m){
     Preliminaries(GSL_NAN);
 
-    double out =  apop_log_likelihood(datas.d1, s->model1)
-                 +apop_log_likelihood(datas.d2, s->model2);
+    apop_data *ds[] = {datas.d1, datas.d2};
+    apop_model *ms[] = {s->model1, s->model2};
+    double lls[2];
+    OMP_for (int i=0; i< 2; i++)
+        lls[i] = apop_log_likelihood(ds[i], ms[i]);
     repaste(datas);
-    return out;
+    return lls[0] + lls[1];
 }
 
 static long double cross_p(apop_data *d, apop_model *m){
     Preliminaries(GSL_NAN)
 
-    double out =  apop_p(datas.d1, s->model1) *apop_p(datas.d2, s->model2);
+    apop_data *ds[] = {datas.d1, datas.d2};
+    apop_model *ms[] = {s->model1, s->model2};
+    double ps[2];
+    OMP_for (int i=0; i< 2; i++)
+        ps[i] = apop_p(ds[i], ms[i]);
     repaste(datas);
-    return out;
+    return ps[0] * ps[1];
 }
 
 static int cross_draw(double *d, gsl_rng *r, apop_model *m){
@@ -135,12 +163,37 @@ static int cross_draw(double *d, gsl_rng *r, apop_model *m){
     return 0;
 }
 
+//Fill a block of rows, via the model's own draw_many if it has one.
+static int draw_block(gsl_matrix *out, gsl_rng *r, apop_model *m){
+    apop_draw_many_type draw_many = apop_draw_many_vtable_get(m);
+    if (draw_many) return draw_many(out, r, m);
+    for (size_t i=0; i< out->size1; i++)
+        if (apop_draw(gsl_matrix_ptr(out, i, 0), r, m)) return 1;
+    return 0;
+}
+
+/* For apop_model_draws, which calls this for blocks of rows in parallel. Each component
+   fills its own columns of the block, using the thread's RNG. */
+static int cross_draw_many(gsl_matrix *out, gsl_rng *r, apop_model *m){
+    apop_cross_settings *s = Apop_settings_get_group(m, apop_cross);
+    check_settings(1);
+    int dsize1 = s->model1->dsize;
+    Apop_stopif(dsize1 <= 0 || out->size2 <= dsize1, return 1, 0, "The first model has dsize=%i, "
+            "so I can't split a %zu-column block of draws.", dsize1, out->size2);
+    Apop_stopif(draw_block(Apop_subm(out, 0, 0, out->size1, dsize1), r, s->model1),
+            return 1, 0, "draw from first model failed.");
+    Apop_stopif(draw_block(Apop_subm(out, 0, dsize1, out->size1, out->size2 - dsize1), r, s->model2),
+            return 1, 0, "draw from second model failed.");
+    return 0;
+}
+
 apop_model *apop_cross = &(apop_model){"Cross product of models", .p=cross_p, .log_likelihood=cross_ll, 
     .estimate=cross_est, .draw=cross_draw
 };
 
 apop_model *apop_model_cross_base(apop_model *mlist[]){
     apop_model_print_vtable_add(cross_print, apop_cross);
+    apop_draw_many_vtable_add(cross_draw_many, apop_cross);
     Apop_stopif(!mlist[0], apop_model *oute = apop_model_copy(apop_cross); oute->error='i', 
                             0, "No inputs. Returning blank model with outmodel->error=='n'.");
     Apop_stopif(!mlist[1], return apop_model_copy(mlist[1]), 2, "Only one model input; returning a copy of that model.");
@@ -1,5 +1,6 @@
 #include "apop_internal.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 /* \amodel apop_dconstrain A model that constrains the base model to within some
 data constraint. E.g., truncate \f$P(d)\f$ to zero for all \f$d\f$ outside of a given
@@ -19,9 +20,20 @@ Apop_settings_set(your_model, apop_dconstrain, scale, 0);
 \endcode
 If \c scale is zero, because that is the default or because you set it as above, then
 I recalculate the scale.  If the value of the \c parameters changed since \c scale
-was last calculated, I recalculate. If you made other relevant changes to the scale,
+was last calculated, I recalculate. Changes are spotted by comparing a hash of the
+parameters to that of the last calculation. If you made other relevant changes to the scale,
 then you may need to manually zero out \c scale so it can be recalculated.
 
+The draws for the default calculation are made in blocks, each with its own RNG seeded
+from the settings group's \c rng. Set <tt>.parallel_draws='y'</tt> to split the blocks
+across threads (via OpenMP); the base model's \c draw method and your \c constraint are
+then called concurrently, so they must be thread-safe. Because each block has its own
+RNG, the scaling is the same with or without threads. Set <tt>.quasi_random='y'</tt>
+to feed the base model's draw method a randomly shifted Halton sequence in place of
+pseudorandom numbers. When each draw uses a fixed, small number of uniform draws (e.g.,
+inverse-CDF methods), the estimate typically converges much faster than with
+pseudorandom draws, so you may be able to reduce \c draw_ct.
+
 Here is an example that makes a few draws and estimations from data-constrained
 models. Note the use of \ref apop_model_set_settings to prepare the constrained models.
 
@@ -38,16 +50,80 @@ models. Note the use of \ref apop_model_set_settings to prepare the constrained
     Apop_stopif(!cs, return outval, 0, "At this point, I expect your model to" \
             "have an apop_dconstrain_settings group.");
 
+/* A gsl_rng whose successive uniform draws are the coordinates of one point of a
+Halton sequence, randomly shifted (mod one) so the estimate is unbiased. Seeding it
+with i jumps to the ith point. A draw from the base model that uses more uniforms
+than there are dimensions here gets the rest from a pseudorandom generator. */
+#define halton_dims 32
+
+typedef struct {
+    unsigned long index;
+    int dim;
+    double shift[halton_dims];
+    gsl_rng *overflow;
+} halton_state;
+
+static int const halton_primes[halton_dims] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41,
+        43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131};
+
+static double radical_inverse(unsigned long i, int base){
+    double out = 0, digit_value = 1./base;
+    for ( ; i; i /= base, digit_value /= base) out += digit_value * (i % base);
+    return out;
+}
+
+static double halton_get_double(void *vstate){
+    halton_state *s = vstate;
+    if (s->dim >= halton_dims) return gsl_rng_uniform(s->overflow);
+    double u = radical_inverse(s->index, halton_primes[s->dim]) + s->shift[s->dim];
+    s->dim++;
+    return u >= 1 ? u - 1 : u;
+}
+
+static unsigned long halton_get(void *vstate){ return halton_get_double(vstate) * 4294967295.; }
+
+static void halton_set(void *vstate, unsigned long index){
+    halton_state *s = vstate;
+    s->index = index;
+    s->dim = 0;
+}
+
+static const gsl_rng_type halton_type = {"randomized Halton", 4294967295UL, 0, sizeof(halton_state),
+                                         halton_set, halton_get, halton_get_double};
+
+//Draws are made in blocks of this size, each with its own RNG, so the result doesn't depend on thread count.
+#define scaling_block 1024
+
 //what percent of the model density is inside the constraint?
 static double get_scaling(apop_model *m){
     Get_set(m, GSL_NAN)
-    apop_data *d = apop_data_alloc(1, cs->base_model->dsize);
-    int tally = 0;
-    for (int i=0; i< cs->draw_ct; i++){
-        apop_draw(d->matrix->data, cs->rng, cs->base_model);
-        tally += !!cs->constraint(d, cs->base_model);
+    int quasi = cs->quasi_random == 'y' || cs->quasi_random == 'Y';
+    int block_ct = (cs->draw_ct + scaling_block - 1)/scaling_block;
+    unsigned long seed = gsl_rng_get(cs->rng);
+    double shift[halton_dims];
+    if (quasi) for (int j=0; j< halton_dims; j++) shift[j] = gsl_rng_uniform(cs->rng);
+
+    long int tally = 0;
+    #pragma omp parallel for reduction(+:tally) if(cs->parallel_draws == 'y' || cs->parallel_draws == 'Y')
+    for (int b=0; b< block_ct; b++){
+        gsl_rng *pseudo = apop_rng_alloc(seed + b), *r = pseudo;
+        if (quasi){
+            r = gsl_rng_alloc(&halton_type);
+            halton_state *hs = r->state;
+            memcpy(hs->shift, shift, sizeof(shift));
+            hs->overflow = pseudo;
+        }
+        apop_data *d = apop_data_alloc(1, cs->base_model->dsize);
+        int end = GSL_MIN((b+1)*scaling_block, cs->draw_ct);
+        for (int i=b*scaling_block; i< end; i++){
+            if (quasi) gsl_rng_set(r, i+1); //point zero is all zeros.
+            apop_draw(d->matrix->data, r, cs->base_model);
+            tally += !!cs->constraint(d, cs->base_model);
+        }
+        apop_data_free(d);
+        if (quasi) gsl_rng_free(r);
+        gsl_rng_free(pseudo);
     }
-    apop_data_free(d);
     return (tally+0.0)/cs->draw_ct;
 }
 
@@ -59,10 +135,8 @@ Apop_settings_init(apop_dconstrain,
     if (!in.scaling) out->scaling = get_scaling;
 )
 
-Apop_settings_copy(apop_dconstrain, in->refct++;)
-Apop_settings_free(apop_dconstrain, in->refct--;
-        if(!in->refct) gsl_vector_free(in->last_params);
-)
+Apop_settings_copy(apop_dconstrain, )
+Apop_settings_free(apop_dconstrain, )
 
 static void dc_prep(apop_data *d, apop_model *m){
     apop_dconstrain_settings *cs = Apop_settings_get_group(m, apop_dconstrain); 
@@ -94,25 +168,9 @@ static double constr(apop_data *d, void *csin){
 }
 
 static bool is_stale(apop_dconstrain_settings *cs, apop_model *m){ //do I need to recalculate the scale?
-    bool stale = false;
-    if (!cs->last_params && !m->parameters)
-        stale=false;
-    else {
-        gsl_vector *params = apop_data_pack(m->parameters);
-        if (!cs->last_params){
-            cs->last_params = apop_vector_copy(params);
-            stale = true;
-        } else if (cs->last_params->size != params->size){
-            apop_vector_realloc(cs->last_params, params->size);
-            gsl_vector_memcpy(cs->last_params, params);
-            stale = true;
-        } else if (apop_vector_distance(cs->last_params, params)){
-            gsl_vector_memcpy(cs->last_params, params);
-            stale=true;
-        }
-        gsl_vector_free(params);
-    }
-    if (!cs->scale) stale = true; //but at this point, last_params is prepped.
+    uint64_t h = m->parameters ? params_hash(m->parameters) : 0;
+    bool stale = !cs->scale || h != cs->params_hash;
+    cs->params_hash = h;
     return stale;
 }
 
@@ -53,74 +53,72 @@ static apop_data *apop_predict_table_prep(apop_data *in){
     return out;
 }
 
-/* Take a \c predict table and set the entries in the data set to the given predicted
-  value. Functions for prediction and imputation use this internally, and append to your
-  data a \c predict table of the right form.  For example, \c apop_ml_impute uses
-  this internally.
-  
-  I assume that the ordering of elements in the \c predict table include everything on the
-  first page, then everything on the second, et cetera. 
-
-\param data The data set to be filled in. 
-\param predict The set of fillins.
-*/
-static void apop_data_predict_fill(apop_data *data, apop_data *predict){
-    if (!predict) return;
-    int this_page_ct = 0;
-    apop_data *this_page = data;
-    for (int i=0; i < predict->matrix->size1; i++){
-        int p = apop_data_get(predict, .row=i, .colname="page");
-        while (p != this_page_ct){//entries are in sequential order, but may skip pages.
-            this_page_ct++;
-            this_page = this_page->more;
-        }
-        apop_data_set(this_page, .row= apop_data_get(predict, .row=i, .colname="row"),
-                                 .col= apop_data_get(predict, .row=i, .colname="col"),
-                                 .val= apop_data_get(predict, .row=i, .colname="value"));
-    }
-}
-
 /////////End predict table machinery.
 
 /** \cond doxy_ignore  Not in the apop.m4.h header --> not public. */
+typedef struct {
+    int page, row, col; //col==-1 for the vector.
+} fix_slot;
+
 typedef struct {
     apop_model *base_model;
     apop_data *predict;
     int ct;
+    fix_slot *slots; //the free positions, in the order of the fixed model's parameter vector.
 } apop_fix_params_settings;
 /** \endcond */ //End of Doxygen ignore.
 
+/* The predict table is read once, into an array of (page, row, col) slots sorted by page.
+   Moving values between the fixed model's vector and the base model's parameters is
+   then a walk through that array, touching only the free positions. */
+static fix_slot *slots_from_predict(apop_data *predict){
+    int ct = predict->matrix->size1;
+    fix_slot *out = malloc(ct*sizeof(fix_slot));
+    for (int i=0; i< ct; i++)
+        out[i] = (fix_slot){.page = apop_data_get(predict, .row=i, .colname="page"),
+                            .row = apop_data_get(predict, .row=i, .colname="row"),
+                            .col = apop_data_get(predict, .row=i, .colname="col")};
+    return out;
+}
+
 static void unpack(apop_data *out, apop_model *m){
-    //predict table --> real param set 
-   apop_fix_params_settings *mset = Apop_settings_get_group(m, apop_fix_params);
-   Apop_col_tv(mset->predict, "value", p_in_tab);
-   gsl_vector_memcpy(p_in_tab, m->parameters->vector);
-   apop_data_predict_fill(out, mset->predict);
+    //free param vector --> real param set
+    apop_fix_params_settings *mset = Apop_settings_get_group(m, apop_fix_params);
+    apop_data *page = out;
+    for (int i=0, p=0; i< mset->ct; i++){
+        fix_slot s = mset->slots[i];
+        for ( ; p < s.page; p++) page = page->more;
+        double val = gsl_vector_get(m->parameters->vector, i);
+        if (s.col == -1) gsl_vector_set(page->vector, s.row, val);
+        else             gsl_matrix_set(page->matrix, s.row, s.col, val);
+    }
 }
 
-static void pack(apop_data *in, apop_model *m){
-    //real param set --> predict table 
-   apop_fix_params_settings *mset = Apop_settings_get_group(m, apop_fix_params);
-   apop_data *predict = mset->predict;
-    for(int i =0; i< predict->matrix->size1; i++){
-        apop_data_set(predict, .row =i, .colname="value", .val=apop_data_get(in, 
-                                                        apop_data_get(predict, .row=i, .colname="row"),
-                                                        apop_data_get(predict, .row=i, .colname="col")));
-        if (i< mset->ct-1 && apop_data_get(predict, .row= i+1, .colname="page") 
-                                != apop_data_get(predict, .row= i, .colname="page"))
-            in = in->more;
+static void pack(apop_data const *in, gsl_vector *out, apop_fix_params_settings *mset){
+    //real param set --> free param vector
+    for (int i=0, p=0; i< mset->ct; i++){
+        fix_slot s = mset->slots[i];
+        for ( ; p < s.page; p++) in = in->more;
+        gsl_vector_set(out, i, s.col == -1 ? gsl_vector_get(in->vector, s.row)
+                                           : gsl_matrix_get(in->matrix, s.row, s.col));
     }
-   Apop_col_tv(mset->predict, "value", p_in_tab);
-   if (m->parameters) //empty only during set_starting_point
-       gsl_vector_memcpy(m->parameters->vector, p_in_tab);
 }
 
 //The macros generating the fixed_param_settings group's init/copy/free functions:
 Apop_settings_init(apop_fix_params, 
     Apop_assert(in.base_model, "I can't fix a NULL model's parameters.");
 )
-Apop_settings_copy(apop_fix_params, )
-Apop_settings_free(apop_fix_params, )
+Apop_settings_copy(apop_fix_params,
+    out->predict = apop_data_copy(in->predict);
+    if (in->slots){
+        out->slots = malloc(in->ct*sizeof(fix_slot));
+        memcpy(out->slots, in->slots, in->ct*sizeof(fix_slot));
+    }
+)
+Apop_settings_free(apop_fix_params,
+    apop_data_free(in->predict);
+    free(in->slots);
+)
 
 static long double fix_params_ll(apop_data *d, apop_model *fixed_model){
     apop_model *base_model = Apop_settings_get(fixed_model, apop_fix_params, base_model);
@@ -138,10 +136,39 @@ static long double fix_params_constraint(apop_data *data, apop_model *fixed_mode
     apop_model *base_model = Apop_settings_get(fixed_model, apop_fix_params, base_model);
     unpack(base_model->parameters, fixed_model);
     long double out = base_model->constraint(data, base_model);
-    if (out) pack(base_model->parameters, fixed_model);
+    if (out) pack(base_model->parameters, fixed_model->parameters->vector,
+                    Apop_settings_get_group(fixed_model, apop_fix_params));
     return out;
 }
 
+/* The base model's score is over its whole first page of parameters; gather the
+   elements at the free positions. If the base model has no closed-form score, or some
+   free parameters are on later pages, the numerical gradient over only the free
+   parameters is the cheaper option. */
+static void fix_params_score(apop_data *d, gsl_vector *gradient, apop_model *fixed_model){
+    static threadlocal gsl_vector *full = NULL;
+    apop_fix_params_settings *mset = Apop_settings_get_group(fixed_model, apop_fix_params);
+    apop_model *base_model = mset->base_model;
+    apop_score_type base_score = apop_score_vtable_get(base_model);
+    if (!base_score || mset->slots[mset->ct-1].page > 0){
+        gsl_vector *numeric = apop_numerical_gradient(d, fixed_model);
+        gsl_vector_memcpy(gradient, numeric);
+        gsl_vector_free(numeric);
+        return;
+    }
+    unpack(base_model->parameters, fixed_model);
+    Get_vmsizes(base_model->parameters); //vsize, msize2, tsize
+    if (!full || full->size != tsize){
+        if (full) gsl_vector_free(full);
+        full = gsl_vector_alloc(tsize);
+    }
+    base_score(d, full, base_model);
+    for (int i=0; i< mset->ct; i++){
+        fix_slot s = mset->slots[i];
+        gsl_vector_set(gradient, i, gsl_vector_get(full, s.col == -1 ? s.row : vsize + s.row*msize2 + s.col));
+    }
+}
+
 static int fix_params_draw(double *out, gsl_rng* r, apop_model *eps){
     apop_model *base_model = Apop_settings_get(eps, apop_fix_params, base_model);
     unpack(base_model->parameters, eps);
@@ -157,6 +184,10 @@ static void fixed_est(apop_data * data, apop_model *params){
 
 static void fixed_param_show(apop_model *m, FILE *out){
     apop_fix_params_settings *mset = Apop_settings_get_group(m, apop_fix_params);
+    if (m->parameters){
+        Apop_col_tv(mset->predict, "value", p_in_tab);
+        gsl_vector_memcpy(p_in_tab, m->parameters->vector);
+    }
     fprintf(out, "The fill-in table:\n");
     apop_data_print(mset->predict, .output_pipe=out);
     if (!m->parameters) printf("This copy of the model has not yet been estimated.\n");
@@ -169,6 +200,7 @@ static void fixed_param_show(apop_model *m, FILE *out){
 
 static void fixed_param_prep(apop_data *data, apop_model *params){
     apop_model_print_vtable_add(fixed_param_show, fixed_param_model);
+    apop_score_vtable_add(fix_params_score, fixed_param_model);
     apop_model_clear(data, params);
     //apop_model *base_model = Apop_settings_get(params, apop_fix_params, base_model);
     //apop_prep(data, base_model);
@@ -186,11 +218,11 @@ void set_starting_point(apop_data * in_params, apop_model * model_out, double *s
     gsl_vector_view v = gsl_vector_view_array(start, tsize);
     apop_data_unpack(&(v.vector), param_cp);
 
-    pack(param_cp, model_out); //write to the fill tab.
+    apop_fix_params_settings *mset = Apop_settings_get_group(model_out, apop_fix_params);
+    double *new_start = malloc(mset->ct * sizeof(double)); //leak!!
+    gsl_vector_view start_v = gsl_vector_view_array(new_start, mset->ct);
+    pack(param_cp, &start_v.vector, mset);
     apop_data_free(param_cp);
-    Apop_col_tv(predict_tab, "value", ptv);
-    double *new_start = malloc(ptv->size * sizeof(double)); //leak!!
-    memcpy(new_start, ptv->data, ptv->size* sizeof(double));
     Apop_settings_add(model_out, apop_mle, starting_pt, new_start);
 }
 
@@ -244,6 +276,8 @@ apop_model * apop_model_fix_params(apop_model *model_in){
                 "Returning a copy of the input model."
     );
     apop_settings_set(model_out, apop_fix_params, predict, predict_tab);
+    apop_settings_set(model_out, apop_fix_params, ct, predict_tab->matrix->size1);
+    apop_settings_set(model_out, apop_fix_params, slots, slots_from_predict(predict_tab));
     model_out->vsize = predict_tab->matrix->size1;
     model_out->dsize = model_in->dsize;
 
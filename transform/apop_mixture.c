@@ -37,16 +37,41 @@ model parameters using their subsets. The standard algorithm, see e.g. <a
 href="http://www.jstatsoft.org/v32/i06/paper">this PDF</a>, repeats until it arrives
 at an optimum.
 
-Thus, the log likelihood method for this model includes a step that allocates each data
-point to its most likely model, and calculates the log likelihood of each observation
-using its most likely model. [It would be a valuable extension to extend this to
-not-conditionally IID models. Commit \c 1ac0dd44 in the repository had some notes on
-this, now removed.]  As a side-effect, it calculates the odds of drawing from each model
-(the vector λ). Following the above-linked paper, the probability for a given
-observation under the mixture model is its probability under the most likely model
-weighted by the previously calculated \f$\lambda\f$ for the given model.
-
-Apophenia implements the EM algorithm as a constrained optimization(!). The constraint
+The log likelihood of an observation under the mixture is the log of the sum over
+components of \f$\lambda_j\f$ times its likelihood under component \f$j\f$, where
+\f$\lambda\f$ is the vector of weights, calculated in log space to prevent underflow.
+This is the value the EM routine below reports. [It would be a valuable extension to
+extend this to not-conditionally IID models. Commit \c 1ac0dd44 in the repository had
+some notes on this, now removed.]  As a side-effect, the log likelihood method calculates
+the odds that each observation was drawn from each model, and from those the next round's
+\f$\lambda\f$.
+
+By default, \ref apop_estimate runs a dedicated EM routine. The Expectation step
+finds an \f$n\times k\f$ grid of responsibilities, the odds that each observation came
+from each of the \f$k\f$ components, normalized in log space to prevent underflow. The
+Maximization step re-estimates each component with each observation weighted by its
+responsibility for that component, and, if <tt>find_weights='y'</tt>, sets each weight to
+the component's mean responsibility. The loop stops when the log likelihood changes by
+less than the \c tolerance element of the \ref apop_mixture_settings group (as a fraction of
+the log likelihood), or after \c max_iterations iterations.
+
+\li The EM routine needs each observation to be a single number, and each component
+to have a weighted estimate in closed form: currently, the Normal, Poisson, and
+Exponential. Those models also calculate their log likelihoods in one pass down the
+data; log likelihoods for other models are calculated one row at a time. With OpenMP,
+rows and components are split across threads.
+
+\li Otherwise (e.g., a mixture of Gamma distributions), \ref apop_estimate runs the MLE
+search described below. If the component models were given with parameters, the search
+starts from those parameters.
+
+\li If the component models were given without parameters, the start point comes from
+sorting the observations by their first element and giving one contiguous block
+to each component.
+
+If you attach an \ref apop_mle_settings group to the mixture, then \ref apop_estimate
+instead runs the older search, which implements the EM algorithm as a constrained
+optimization(!). The constraint
 check repositions the vector of weights to that calculated at the last step, then the
 log likelihood calculates the likelihood as above, including the expected value of
 the weights vector for the next step. Thus, Apophenia casts the Expectation step as
@@ -71,6 +96,8 @@ comes from, its likelihood can be calculated independently of all other observat
 
 \adoc    Settings   \ref apop_mixture_settings 
 
+\adoc    Estimate_results  Parameters for the weights and each component are found via the EM routine above, or an MLE search if the model has an \ref apop_mle_settings group or the EM routine can't handle the components.
+
 \adoc    Parameter_format The parameters are broken out in a readable form in the
     settings group, so your best bet is to use those. See the sample code for usage.<br>
     The <tt>parameter</tt> element is a single vector piling up all elements, beginning
@@ -81,6 +108,10 @@ comes from, its likelihood can be calculated independently of all other observat
     this vector into its component parts for you.
 
 \adoc RNG Uses the weights to select a component model, then makes a draw from that component.
+The component is selected in constant time via an alias table built from the weights when the
+model is prepped or estimated, so draws need no locks and can run in parallel (e.g., via \ref
+apop_model_draws), as long as the component models' draws are thread-safe. If you change
+the weights after that, call \ref apop_prep again.
 The model's \c dsize (draw size) element is set when you set up the model in the
 model's \c prep method (automatically called by \ref apop_estimate, or call it directly)
 iff all component models have the same \c dsize.
@@ -99,21 +130,31 @@ This example begins with a fixed mixture distribution, and makes assertions abou
 Apop_settings_copy(apop_mixture,
     (*out->cmf_refct)++;
     out->next_weights = apop_vector_copy(in->next_weights);
+    out->param_sizes = malloc(sizeof(int)*in->model_count);
+    memcpy(out->param_sizes, in->param_sizes, sizeof(int)*in->model_count);
+    out->alias_prob = apop_vector_copy(in->alias_prob);
+    if (in->alias){
+        out->alias = malloc(sizeof(size_t)*in->alias_prob->size);
+        memcpy(out->alias, in->alias, sizeof(size_t)*in->alias_prob->size);
+    }
 )
 
 Apop_settings_free(apop_mixture,
-    if (!(--in->cmf_refct)) {
-        apop_model_free(in->cmf);
+    if (!(--*in->cmf_refct)) {
         free(in->cmf_refct);
         free(in->model_list);
     }
     free(in->param_sizes);
     gsl_vector_free(in->next_weights);
+    gsl_vector_free(in->alias_prob);
+    free(in->alias);
 ) 
 
 Apop_settings_init(apop_mixture, 
     out->cmf_refct = calloc(1, sizeof(int));
     (*out->cmf_refct)++;
+    Apop_varad_set(tolerance, 1e-8);
+    Apop_varad_set(max_iterations, 1000);
 )
 
 //see apop_model_mixture in types.h
@@ -152,15 +193,28 @@ void mixture_show(apop_model *m, FILE *out){
 }
 
 
+/* Build the table for selecting a component in mixture_draw from the current weights.
+   Done at prep and after estimation, so draws never have to build it themselves. */
+static void setup_selection(apop_mixture_settings *ms){
+    gsl_vector_free(ms->alias_prob);
+    free(ms->alias);
+    ms->alias_prob = NULL;
+    ms->alias = NULL;
+    if (ms->weights) alias_table(ms->weights, &ms->alias_prob, &ms->alias);
+}
+
 static void mixture_prep(apop_data * data, apop_model *model){
     apop_model_print_vtable_add(mixture_show, apop_mixture);
-    if (model->parameters) return;
     apop_mixture_settings *ms = Apop_settings_get_group(model, apop_mixture);
+    if (ms) setup_selection(ms);
+    if (model->parameters) return;
     model->parameters = apop_data_alloc();
     model->parameters->vector = apop_vector_stack(model->parameters->vector, ms->weights, .inplace='y');
 
     int i=0;
+    ms->unparameterized = 0;
     for (apop_model **m = ms->model_list; *m; m++){
+        if (!(*m)->parameters) ms->unparameterized = 1;
         if (!(*m)->parameters) apop_prep(data, *m);
         gsl_vector *v = apop_data_pack((*m)->parameters);
         ms->param_sizes[i++] = v ? v->size : 0;
@@ -194,37 +248,75 @@ void unpack(apop_model *min){
     for (apop_model **m = ms->model_list; *m; m++)                           \
         total += fn(d, *m) * gsl_vector_get(ms->weights, i++)/total_weight;
 
+static gsl_vector *single_column(apop_data *d){
+    Get_vmsizes(d); //vsize, msize2
+    if (vsize && !msize2) return d->vector;
+    if (!vsize && msize2 == 1) return Apop_cv(d, 0);
+    return NULL;
+}
+
+/* Fill one column of the grid of log likelihoods, with one pass down the data for
+models with an apop_row_lls vtable entry, else one call per row. Rows are split across threads. */
+static void component_lls(apop_data *d, gsl_vector *x, apop_model *m, gsl_vector *out){
+    apop_row_lls_type row_lls = (x && m->parameters && m->parameters->vector)
+                                    ? apop_row_lls_vtable_get(m) : NULL;
+    if (row_lls) row_lls(x, out, m);
+    else
+        OMP_for (size_t i=0; i< out->size; i++){
+            Apop_row(d, i, onepoint);
+            gsl_vector_set(out, i, apop_log_likelihood(onepoint, m));
+        }
+}
+
 //The output is a grid of log likelihoods.
 apop_data* get_lls(apop_data *d, apop_model *m){
     apop_mixture_settings *ms = Apop_settings_get_group(m, apop_mixture);
     Get_vmsizes(d); //maxsize
     apop_data *out = apop_data_alloc(maxsize, ms->model_count);
-
-    for (int i=0; i< maxsize; i++){
-        Apop_row(d, i, onepoint);
-        for (int j=0; j< ms->model_count; j++){
-            double this_val = apop_log_likelihood(onepoint, ms->model_list[j]);
-            apop_data_set(out, i, j, this_val);
-        }
-    }
+    gsl_vector *x = single_column(d);
+    for (int j=0; j< ms->model_count; j++)
+        component_lls(d, x, ms->model_list[j], Apop_cv(out, j));
     return out;
 }
 
 /* The trick to summing exponents: subtract the max:
 
 let ll_M be the max LL. then
-Σexp(ll) = exp(llM)*(exp(ll₁-llM)+exp(ll₂-llM)+exp(ll₃-llM))
+log Σexp(ll) = llM + log(exp(ll₁-llM)+exp(ll₂-llM)+exp(ll₃-llM))
 
 One of the terms in the sum is exp(0)=1. The others are all less than one, and so we
 are guaranteed no overflow. If any of them underflow, then that term must not have
-been very important for the sum.
+been very important for the sum. Staying in logs means that a row where every
+likelihood underflows still gets a finite total.
 */
-static long double sum_exp_vector(gsl_vector const *onerow){
+static long double log_sum_exp_vector(gsl_vector const *onerow){
     long double rowtotal = 0;
     double best = gsl_vector_max(onerow);
+    if (!isfinite(best)) return best;
     for (int j=0; j<onerow->size; j++) rowtotal += exp(gsl_vector_get(onerow, j)-best);
-    rowtotal *= exp(best);
-    return rowtotal;
+    return best + logl(rowtotal);
+}
+
+/* E step: convert the grid of component log likelihoods to responsibilities, in place.
+Row i, column j becomes the odds that observation i came from component j, given
+the current weights and parameters. Returns the log likelihood of the data under
+the mixture (weighted by the data's weights, if any). */
+static long double responsibilities(apop_data *lls, gsl_vector const *weights, gsl_vector const *data_wts){
+    size_t k = lls->matrix->size2;
+    double log_wt[k];
+    double total_wt = apop_sum(weights);
+    for (size_t j=0; j< k; j++) log_wt[j] = log(gsl_vector_get(weights, j)/total_wt);
+
+    long double ll = 0;
+    OMP_for_reduce(+:ll, size_t i=0; i< lls->matrix->size1; i++){
+        Apop_row_v(lls, i, onerow);
+        for (size_t j=0; j< k; j++) *gsl_vector_ptr(onerow, j) += log_wt[j];
+        long double lse = log_sum_exp_vector(onerow);
+        for (size_t j=0; j< k; j++)
+            gsl_vector_set(onerow, j, isfinite(lse) ? exp(gsl_vector_get(onerow, j) - lse) : 1./k);
+        ll += lse * (data_wts ? gsl_vector_get(data_wts, i) : 1);
+    }
+    return ll;
 }
 
 static long double mixture_log_likelihood(apop_data *d, apop_model *model_in){
@@ -233,61 +325,150 @@ static long double mixture_log_likelihood(apop_data *d, apop_model *model_in){
                                               "Did you set this up with apop_model_mixture()?");
     if (model_in->parameters) unpack(model_in);
     apop_data *lls = get_lls(d, model_in);
+    long double total_ll = responsibilities(lls, ms->weights, d->weights);
 
-    //reweight by last round's lambda 
+    //For the MLE search: the constraint moves the weights to the mean responsibilities.
+    if (!ms->next_weights) ms->next_weights = gsl_vector_alloc(ms->weights->size);
     for (int i=0; i< lls->matrix->size2; i++){
         Apop_col_v(lls, i, onecol);
-        gsl_vector_add_constant(onecol, gsl_vector_get(ms->weights, i));
+        gsl_vector_set(ms->next_weights, i, apop_sum(onecol)/lls->matrix->size1);
     }
+    apop_data_free(lls);
+    return total_ll;
+}
 
-//OK, now we need the λs, and then the max ll for each observation
+/* EM is only valid if every component can be re-estimated with weighted observations,
+which needs single-column data and an apop_weighted_estimate vtable entry. Estimate
+methods in general ignore the data's weights, so there's no falling back to them. */
+static int em_ok(apop_data *d, apop_mixture_settings *ms){
+    if (!single_column(d)) return 0;
+    for (apop_model **m = ms->model_list; *m; m++)
+        if (!(*m)->parameters || !(*m)->parameters->vector || !apop_weighted_estimate_vtable_get(*m))
+            return 0;
+    return 1;
+}
 
-/*
-Draw probabilities are p₁/Σp p₂/Σp p₃/Σp (see equation (2) of the above pdf.)
-But I have logs, and want to stay in log-format for as long as possible, to prevent undeflows and loss of precision.
-*/
-    long double total_ll=0;
-    gsl_vector *ps = gsl_vector_alloc(lls->matrix->size2);
-    gsl_vector *cp = gsl_vector_alloc(lls->matrix->size2);
-    for (int i=0; i< lls->matrix->size1; i++){
-        Apop_row_v(lls, i, onerow);
-        total_ll += gsl_vector_max(onerow);
-        for (int j=0; j < onerow->size; j++){
-            gsl_vector_memcpy(cp, onerow);
-            gsl_vector_add_constant(cp, -gsl_vector_get(onerow, j));
-            gsl_vector_set(ps, j, 1./sum_exp_vector(cp));
-        }
-        gsl_vector_memcpy(onerow, ps);
+/* M step: re-estimate the weights (if requested) and each component, with each row
+weighted by its responsibility. The responsibilities are multiplied by the data's
+weights in place. Assumes em_ok. */
+static void m_step(apop_data *d, apop_data *resp, apop_mixture_settings *ms){
+    size_t k = ms->model_count;
+    if (d->weights)
+        for (size_t j=0; j< k; j++)
+            gsl_vector_mul(Apop_cv(resp, j), d->weights);
+
+    if (ms->find_weights && ms->find_weights!='n' && ms->find_weights!='N'){
+        double total = d->weights ? apop_sum(d->weights) : resp->matrix->size1;
+        for (size_t j=0; j< k; j++)
+            gsl_vector_set(ms->weights, j, apop_sum(Apop_cv(resp, j))/total);
+    }
+
+    gsl_vector *x = single_column(d);
+    apop_weighted_estimate_type est[k];
+    for (size_t j=0; j< k; j++) est[j] = apop_weighted_estimate_vtable_get(ms->model_list[j]);
+    OMP_for (size_t j=0; j< k; j++)
+        est[j](x, Apop_cv(resp, j), ms->model_list[j]);
+}
 
-        Apop_stopif(fabs(apop_sum(onerow) - 1) > 1e-3, /*Warn user, but continue.*/, 0,
-                "One of the probability calculations is off: the total for the odds of drawing "
-                "from the %i mixtures is %g but should be 1.", 
-                ms->model_count, fabs(apop_sum(onerow) - 1));
+static int compare_keys(void const *a, void const *b){
+    double const *da = a, *db = b;
+    return (*da > *db) - (*da < *db);
+}
+
+/* Starting point for components without parameters: sort the rows by their first
+element, split into as many contiguous blocks as components, and estimate each
+component from its block. */
+static void em_start(apop_data *d, apop_data *resp){
+    size_t n = resp->matrix->size1, k = resp->matrix->size2;
+    double (*keys)[2] = malloc(sizeof(double[2])*n);
+    for (size_t i=0; i< n; i++){
+        keys[i][0] = apop_data_get(d, i, d->vector ? -1 : 0);
+        keys[i][1] = i;
     }
-    gsl_vector_free(cp);
-    gsl_vector_free(ps);
+    qsort(keys, n, sizeof(double[2]), compare_keys);
+    gsl_matrix_set_zero(resp->matrix);
+    for (size_t i=0; i< n; i++)
+        gsl_matrix_set(resp->matrix, keys[i][1], i*k/n, 1);
+    free(keys);
+}
 
-    if (!ms->next_weights) ms->next_weights = gsl_vector_alloc(ms->weights->size);
-    for (int i=0; i< lls->matrix->size2; i++){
-        Apop_col_v(lls, i, onecol);
-        gsl_vector_set(ms->next_weights, i, apop_sum(onecol)/lls->matrix->size1);
+/* \adoc estimated_info Reports the log likelihood and the number of EM iterations.*/
+static void mixture_estimate(apop_data *d, apop_model *m){
+    apop_mixture_settings *ms = Apop_settings_get_group(m, apop_mixture);
+    Apop_stopif(!ms, m->error='p'; return, 0, "No apop_mixture_settings group. "
+                                              "Did you set this up with apop_model_mixture()?");
+    apop_mle_settings *mp = Apop_settings_get_group(m, apop_mle);
+    if (mp || !em_ok(d, ms)){ //The user wants the MLE search, or EM can't handle these components.
+        if (!mp && !ms->unparameterized){ //Start from the parameters the user gave.
+            mp = Apop_model_add_group(m, apop_mle, .starting_pt=m->parameters->vector->data);
+            apop_maximum_likelihood(d, m);
+            mp->starting_pt = NULL; //pointed into the parameters, which the search has overwritten.
+        } else apop_maximum_likelihood(d, m);
+        unpack(m);
+        setup_selection(ms);
+        return;
     }
-    return total_ll;
+    Get_vmsizes(d); //maxsize
+    apop_data *resp;
+    if (ms->unparameterized){
+        resp = apop_data_alloc(maxsize, ms->model_count);
+        em_start(d, resp);
+        m_step(d, resp, ms);
+        apop_data_free(resp);
+    }
+    long double ll = -INFINITY, prior_ll;
+    int iteration = 0;
+    for ( ; iteration < ms->max_iterations; iteration++){
+        prior_ll = ll;
+        resp = get_lls(d, m);
+        ll = responsibilities(resp, ms->weights, d->weights);
+        Apop_stopif(!isfinite(ll), m->error='n'; apop_data_free(resp); break, 0,
+                "The log likelihood of the mixture is %Lg at EM iteration %i; stopping.", ll, iteration);
+        if (fabsl(ll - prior_ll) <= ms->tolerance * fabsl(ll)){
+            apop_data_free(resp);
+            break;
+        }
+        m_step(d, resp, ms);
+        apop_data_free(resp);
+    }
+    Apop_stopif(iteration == ms->max_iterations, , 1, "EM reached the maximum of %i iterations "
+                "without converging.", ms->max_iterations);
+    if (iteration == ms->max_iterations){ //The last M step moved the parameters; report their LL.
+        resp = get_lls(d, m);
+        ll = responsibilities(resp, ms->weights, d->weights);
+        apop_data_free(resp);
+    }
+
+    //Write the results back to the parameter vector, in the order mixture_prep set out.
+    int posn = ms->model_count;
+    gsl_vector_memcpy(Apop_rs(m->parameters, 0, posn)->vector, ms->weights);
+    for (int i=0; i< ms->model_count; i++){
+        if (!ms->param_sizes[i]) continue;
+        gsl_vector v = gsl_vector_subvector(m->parameters->vector, posn, ms->param_sizes[i]).vector;
+        apop_data_pack(ms->model_list[i]->parameters, &v);
+        posn += ms->param_sizes[i];
+    }
+    setup_selection(ms);
+    m->data = d;
+    apop_data_add_named_elmt(m->info, "log likelihood", ll);
+    apop_data_add_named_elmt(m->info, "EM iterations", iteration);
 }
 
 static int mixture_draw (double *out, gsl_rng *r, apop_model *m){
     apop_mixture_settings *ms = Apop_settings_get_group(m, apop_mixture);
-    OMP_critical (mixdraw)
-    if (!ms->cmf){
-        ms->cmf = apop_model_copy(apop_pmf);
-        ms->cmf->data = apop_data_alloc();
-        ms->cmf->data->weights = apop_vector_copy(ms->weights);
-        Apop_model_add_group(ms->cmf, apop_pmf, .draw_index='y');
+    Apop_stopif(!ms, return 1, 0, "No apop_mixture_settings group. "
+                                  "Did you set this up with apop_model_mixture()?");
+    size_t index;
+    if (ms->alias){ //One uniform draw picks the slot, and its fractional part picks the component or its alias.
+        double u = gsl_rng_uniform(r) * ms->alias_prob->size;
+        index = u;
+        if (u - index >= gsl_vector_get(ms->alias_prob, index)) index = ms->alias[index];
+    } else { //Not prepped; walk the weights.
+        double u = gsl_rng_uniform(r) * apop_sum(ms->weights);
+        for (index=0; index < ms->weights->size-1; index++)
+            if ((u -= gsl_vector_get(ms->weights, index)) < 0) break;
     }
-    double index; 
-    Apop_stopif(apop_draw(&index, r, ms->cmf), return 1, 
-            0, "Couldn't select a mixture element using the internal PMF over mixture elements.");
-    return apop_draw(out, r, ms->model_list[(int)index]);
+    return apop_draw(out, r, ms->model_list[index]);
 }
 
 static long double mixture_cdf(apop_data *d, apop_model *model_in){
@@ -329,5 +510,5 @@ static long double mixture_constraint(apop_data *data, apop_model *model_in){
 }
 
 apop_model *apop_mixture=&(apop_model){"Mixture of models", .prep=mixture_prep,
-    .constraint=mixture_constraint, .log_likelihood=mixture_log_likelihood,
+    .estimate=mixture_estimate, .constraint=mixture_constraint, .log_likelihood=mixture_log_likelihood,
     .cdf=mixture_cdf, .draw=mixture_draw };